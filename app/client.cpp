@@ -0,0 +1,41 @@
+// Drop-in replacement for `cli_app -c COMMANDS` and `cli_app SCRIPT` that
+// hands the script to a server started with `cli_app --serve SOCKET`,
+// found through the CLI_SOCKET variable. Without a server it runs the
+// script itself.
+
+#include "cli/command_line_interpreter.hpp"
+#include "cli/command_server.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+int main(int argc, char **argv) {
+  const bool inline_script = argc == 3 && std::strcmp(argv[1], "-c") == 0;
+  if (!inline_script && !(argc == 2 && argv[1][0] != '-')) {
+    std::cerr << "usage: " << argv[0] << " [-c COMMANDS | SCRIPT]\n";
+    return 2;
+  }
+  const std::string script = argv[argc - 1];
+#ifndef _WIN32
+  if (const char *socket = std::getenv("CLI_SOCKET")) {
+    const int code = cli::CommandServer::call(socket, !inline_script, script,
+                                              environ, 0, 1, 2);
+    if (code >= 0)
+      return code;
+    if (code != -1) {
+      // The script may have run in part; running it again is not safe.
+      std::cerr << "cli: no answer from the server at '" << socket << "'\n";
+      return 1;
+    }
+  }
+#endif
+  cli::CommandLineInterpreter interpreter;
+  return inline_script
+             ? interpreter.run_script(script, std::cin, std::cout, std::cerr)
+             : interpreter.run_file(script, std::cin, std::cout, std::cerr);
+}
@@ -1,6 +1,30 @@
 #include "cli/command_line_interpreter.hpp"
+#include "cli/command_server.hpp"
+#include <cstring>
+#include <iostream>
 
-int main() {
-  cli::CommandLineInterpreter interpreter;
-  return interpreter.run(std::cin, std::cout, std::cerr);
+int main(int argc, char **argv) {
+  if (argc == 1) {
+    cli::CommandLineInterpreter interpreter;
+    return interpreter.run(std::cin, std::cout, std::cerr);
+  }
+  if (argc == 3 && std::strcmp(argv[1], "-c") == 0) {
+    cli::CommandLineInterpreter interpreter;
+    return interpreter.run_script(argv[2], std::cin, std::cout, std::cerr);
+  }
+  if (argc == 3 && std::strcmp(argv[1], "--serve") == 0) {
+    std::unique_ptr<cli::CommandServer> server =
+        cli::CommandServer::listen(argv[2], std::cerr);
+    if (!server)
+      return 1;
+    cli::CommandLineInterpreter interpreter;
+    return server->serve(interpreter);
+  }
+  if (argc == 2 && argv[1][0] != '-') {
+    cli::CommandLineInterpreter interpreter;
+    return interpreter.run_file(argv[1], std::cin, std::cout, std::cerr);
+  }
+  std::cerr << "usage: " << argv[0]
+            << " [-c COMMANDS | SCRIPT | --serve SOCKET]\n";
+  return 2;
 }
@@ -0,0 +1,67 @@
+// Throughput of the built-in cat, wc and grep over a log file, run through
+// Command::execute() with in-memory streams as in a sequential pipeline:
+// the file given as an argument, and the same bytes as stdin. The output
+// goes to a std::ostringstream, so cat cannot hand it to the kernel.
+//
+// Usage: bench_byte_stream [size_mib]   (default 64)
+
+#include "cli/commands/cat_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void measure(cli::Command &cmd, std::vector<std::string> args,
+             const std::string &path, const std::string &text, double mib) {
+  std::string label;
+  for (const std::string &arg : args)
+    label += arg + " ";
+  cli::Environment env;
+  for (bool from_file : {true, false}) {
+    std::vector<std::string> run_args = args;
+    if (from_file)
+      run_args.push_back(path);
+    std::istringstream in(from_file ? std::string() : text);
+    std::ostringstream out, err;
+    auto t0 = Clock::now();
+    cmd.execute(run_args, in, out, err, env);
+    double wall = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::printf("%-16s %-6s %8.1f MiB/s\n", label.c_str(),
+                from_file ? "file" : "stdin", mib / wall);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long size_mib = argc > 1 ? std::atol(argv[1]) : 64;
+  const std::string path = "bench_byte_stream.log";
+  std::string text;
+  const std::size_t target = static_cast<std::size_t>(size_mib) << 20;
+  for (long i = 0; text.size() < target; ++i) {
+    text += (i % 10 == 0 ? "ERROR disk " : "info request ") +
+            std::to_string(i) + " done\n";
+  }
+  std::ofstream(path, std::ios::binary) << text;
+  const double mib = static_cast<double>(text.size()) / (1 << 20);
+
+  cli::CatCommand cat;
+  cli::WcCommand wc;
+  cli::GrepCommand grep;
+  measure(cat, {"cat"}, path, text, mib);
+  measure(wc, {"wc"}, path, text, mib);
+  measure(grep, {"grep", "ERROR"}, path, text, mib);
+  measure(grep, {"grep", "request"}, path, text, mib);
+  measure(grep, {"grep", "E.*k"}, path, text, mib);
+  std::remove(path.c_str());
+  return 0;
+}
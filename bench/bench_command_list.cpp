@@ -0,0 +1,123 @@
+// A maintenance script of N steps (assignments, built-ins and `&&`/`||`
+// checks) run three ways: as one command list in one interpreter, with a
+// fresh CommandLineInterpreter for every step, and, given the path of the
+// interpreter binary, as one interpreter process per step -- which is what
+// running the steps from /bin/sh costs.
+//
+// Usage: bench_command_list [steps] [interpreter]   (default 1000, none)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *label, std::size_t steps, double wall) {
+  std::printf("%-32s %9.3f s %9.1f us/step\n", label, wall,
+              wall * 1e6 / static_cast<double>(steps));
+}
+
+std::vector<std::string> make_steps(std::size_t count) {
+  std::vector<std::string> steps;
+  for (std::size_t i = 0; steps.size() < count; ++i) {
+    const std::string n = std::to_string(i);
+    switch (i % 4) {
+    case 0:
+      steps.push_back("STEP=" + n);
+      break;
+    case 1:
+      steps.push_back("echo step $STEP | wc -c");
+      break;
+    case 2:
+      steps.push_back("cat /nonexistent/" + n + " || echo missing " + n);
+      break;
+    default:
+      steps.push_back("pwd && echo done " + n);
+      break;
+    }
+  }
+  return steps;
+}
+
+#ifndef _WIN32
+/** Run `interpreter` with `line` on stdin and its output discarded. */
+void run_process(const char *interpreter, const std::string &line) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return;
+  const pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[0], 0);
+    const int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    dup2(null, 2);
+    close(fds[0]);
+    close(fds[1]);
+    execl(interpreter, interpreter, static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  close(fds[0]);
+  const std::string input = line + "\n";
+  if (write(fds[1], input.data(), input.size()) < 0)
+    std::perror("write");
+  close(fds[1]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::size_t count =
+      argc > 1 ? static_cast<std::size_t>(std::atol(argv[1])) : 1000;
+  const char *interpreter = argc > 2 ? argv[2] : nullptr;
+  const std::vector<std::string> steps = make_steps(count);
+
+  {
+    std::string list;
+    for (const std::string &step : steps)
+      list += (list.empty() ? "" : "; ") + step;
+    cli::CommandLineInterpreter cli;
+    std::istringstream in(list + "\n");
+    std::ostringstream out, err;
+    auto t0 = Clock::now();
+    cli.run(in, out, err);
+    report("one command list", count, seconds_since(t0));
+  }
+  {
+    auto t0 = Clock::now();
+    for (const std::string &step : steps) {
+      cli::CommandLineInterpreter cli;
+      std::istringstream in(step + "\n");
+      std::ostringstream out, err;
+      cli.run(in, out, err);
+    }
+    report("new interpreter per step", count, seconds_since(t0));
+  }
+#ifndef _WIN32
+  if (interpreter) {
+    auto t0 = Clock::now();
+    for (const std::string &step : steps)
+      run_process(interpreter, step);
+    report("new process per step", count, seconds_since(t0));
+  }
+#endif
+  return 0;
+}
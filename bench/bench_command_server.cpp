@@ -0,0 +1,150 @@
+// Per-script cost of a short script run many times through a warm server
+// (`cli_app --serve`) against one interpreter process per script: calls
+// to an in-process server thread straight from this benchmark and, given
+// the paths of `cli_app` and `cli_client`, `cli_app -c` per script next to
+// `cli_client -c` talking to a `cli_app --serve` process.
+//
+// Usage: bench_command_server [runs] [cli_app cli_client]   (default 200)
+
+#include "cli/command_line_interpreter.hpp"
+#include "cli/command_server.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *const kScript = "NAME=report\n"
+                            "echo start $NAME | wc -c\n"
+                            "pwd && echo ok || echo failed\n"
+                            "true\n"
+                            "echo done; X=1\n";
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *label, int runs, double wall) {
+  std::printf("%-28s %9.1f us/script\n", label, wall * 1e6 / runs);
+}
+
+#ifdef __linux__
+/** Start `argv` with stdout and stderr on /dev/null; returns its pid. */
+pid_t spawn(const std::vector<const char *> &argv,
+            const char *socket = nullptr) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    const int null = open("/dev/null", O_RDWR);
+    dup2(null, 0);
+    dup2(null, 1);
+    dup2(null, 2);
+    if (socket)
+      setenv("CLI_SOCKET", socket, 1);
+    else
+      unsetenv("CLI_SOCKET");
+    std::vector<char *> args;
+    for (const char *arg : argv)
+      args.push_back(const_cast<char *>(arg));
+    args.push_back(nullptr);
+    execv(args[0], args.data());
+    _exit(127);
+  }
+  return pid;
+}
+
+void run_process(const std::vector<const char *> &argv,
+                 const char *socket = nullptr) {
+  int status = 0;
+  waitpid(spawn(argv, socket), &status, 0);
+}
+
+/** Wait until a server accepts requests at `path`. */
+bool wait_for_server(const std::string &path) {
+  const int null = open("/dev/null", O_RDWR);
+  bool up = false;
+  for (int i = 0; i < 200 && !up; ++i) {
+    up = cli::CommandServer::call(path, false, "exit 0", environ, null, null,
+                                  null) == 0;
+    if (!up)
+      usleep(10000);
+  }
+  close(null);
+  return up;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int runs = argc > 1 ? std::atoi(argv[1]) : 200;
+  const char *app = argc > 3 ? argv[2] : nullptr;
+  const char *client = argc > 3 ? argv[3] : nullptr;
+  {
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i) {
+      cli::CommandLineInterpreter cli;
+      std::istringstream in;
+      std::ostringstream out, err;
+      cli.run_script(kScript, in, out, err);
+    }
+    report("in process, new interpreter", runs, seconds_since(t0));
+  }
+#ifdef __linux__
+  const std::string path =
+      "/tmp/bench_command_server_" + std::to_string(getpid()) + ".sock";
+  {
+    std::ostringstream listen_err;
+    std::unique_ptr<cli::CommandServer> server =
+        cli::CommandServer::listen(path, listen_err);
+    if (!server) {
+      std::fputs(listen_err.str().c_str(), stderr);
+      return 1;
+    }
+    cli::CommandLineInterpreter interpreter;
+    std::thread serving([&] { server->serve(interpreter); });
+    const int null = open("/dev/null", O_RDWR);
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i)
+      cli::CommandServer::call(path, false, kScript, environ, null, null,
+                               null);
+    report("in-process server, call()", runs, seconds_since(t0));
+    close(null);
+    server->stop();
+    serving.join();
+  }
+  if (app && client) {
+    {
+      auto t0 = Clock::now();
+      for (int i = 0; i < runs; ++i)
+        run_process({app, "-c", kScript});
+      report("process, cli_app -c", runs, seconds_since(t0));
+    }
+    const pid_t server = spawn({app, "--serve", path.c_str()});
+    if (wait_for_server(path)) {
+      auto t0 = Clock::now();
+      for (int i = 0; i < runs; ++i)
+        run_process({client, "-c", kScript}, path.c_str());
+      report("process, cli_client -c", runs, seconds_since(t0));
+    }
+    kill(server, SIGTERM);
+    int status = 0;
+    waitpid(server, &status, 0);
+    unlink(path.c_str());
+  }
+#endif
+  return 0;
+}
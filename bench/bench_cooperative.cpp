@@ -0,0 +1,130 @@
+// Cost of running built-in pipeline stages as coroutines on one thread
+// (CLI_PIPELINE=cooperative) compared with the sequential stringstream /
+// SpillBuffer hand-off and with one thread per stage (streaming):
+//   - raw coroutine switch cost through a ChunkPipe;
+//   - per-pipeline overhead for a tiny input (echo x | cat | wc);
+//   - throughput for a large input (cat | grep | cat | wc).
+//
+// Usage: bench_cooperative [size_mib]   (default 64)
+
+#include "cli/command_registry.hpp"
+#include "cli/commands/cat_command.hpp"
+#include "cli/commands/echo_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include "cli/coroutine_scheduler.hpp"
+#include "cli/executor.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+cli::StageTask ping(cli::ChunkPipe &pipe, long count) {
+  for (long i = 0; i < count; ++i)
+    co_await pipe.push("x");
+  pipe.close_write();
+}
+
+cli::StageTask pong(cli::ChunkPipe &pipe) {
+  for (;;) {
+    std::optional<std::string> chunk = co_await pipe.pop();
+    if (!chunk)
+      break;
+  }
+}
+
+void measure_switch(long count) {
+  cli::CoroutineScheduler scheduler;
+  cli::ChunkPipe pipe(scheduler, 1);
+  scheduler.spawn(ping(pipe, count));
+  scheduler.spawn(pong(pipe));
+  auto t0 = Clock::now();
+  scheduler.run();
+  double wall = seconds_since(t0);
+  std::printf("%-36s %8.1f ns/switch (%zu switches)\n",
+              "coroutine switch via ChunkPipe", wall * 1e9 / scheduler.switches(),
+              scheduler.switches());
+}
+
+cli::Pipeline make_pipeline(
+    const std::vector<std::vector<std::string>> &stages) {
+  cli::Pipeline pl;
+  for (const auto &s : stages) {
+    cli::CommandNode node;
+    node.name = s[0];
+    node.args.assign(s.begin() + 1, s.end());
+    pl.push_back(node);
+  }
+  return pl;
+}
+
+/// Runs `pl` `iterations` times in `mode` and prints the time per run.
+void measure_mode(cli::Executor &exec, const char *what, const char *mode,
+                  const cli::Pipeline &pl, const std::string &input,
+                  int iterations, double mib) {
+  cli::Environment env;
+  env.set("CLI_PIPELINE", mode);
+  std::string result;
+  auto t0 = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    std::istringstream in(input);
+    std::ostringstream out, err;
+    exec.execute(pl, in, out, err, env);
+    result = out.str();
+  }
+  double wall = seconds_since(t0);
+  if (mib > 0)
+    std::printf("%-20s %-12s %8.3f s  %8.1f MiB/s  -> %s", what, mode, wall,
+                mib / wall, result.c_str());
+  else
+    std::printf("%-20s %-12s %8.2f us/pipeline\n", what, mode,
+                wall * 1e6 / iterations);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long mib = argc > 1 ? std::atol(argv[1]) : 64;
+
+  cli::CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<cli::CatCommand>());
+  registry.register_command("echo", std::make_unique<cli::EchoCommand>());
+  registry.register_command("grep", std::make_unique<cli::GrepCommand>());
+  registry.register_command("wc", std::make_unique<cli::WcCommand>());
+  cli::Executor exec(registry);
+
+  measure_switch(10'000'000);
+
+  const char *modes[] = {"sequential", "cooperative", "streaming"};
+  cli::Pipeline tiny = make_pipeline({{"echo", "x"}, {"cat"}, {"wc"}});
+  for (const char *mode : modes)
+    measure_mode(exec, "echo x | cat | wc", mode, tiny, "", 20000, 0);
+
+  std::string line(63, 'a');
+  line += '\n';
+  std::string input;
+  input.reserve(static_cast<std::size_t>(mib) << 20);
+  for (long i = 0; i < (mib << 20) / 64; ++i) {
+    input += line;
+    if (i % 7 == 0)
+      input[input.size() - 2] = 'Z';
+  }
+  cli::Pipeline big = make_pipeline(
+      {{"cat"}, {"grep", "Z"}, {"cat"}, {"wc"}});
+  std::printf("payload: %ld MiB\n", mib);
+  for (const char *mode : modes)
+    measure_mode(exec, "cat|grep|cat|wc", mode, big, input, 1,
+                 static_cast<double>(mib));
+  return 0;
+}
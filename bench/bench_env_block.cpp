@@ -0,0 +1,63 @@
+// Environment work per external launch with a large environment: building
+// "key=value" strings and an envp array from scratch (to_env_vector plus
+// packing, as before) versus taking the block Environment maintains
+// (Environment::envp), and the cost of set() keeping that block current.
+//
+// Usage: bench_env_block [variables] [iterations]   (default 500, 20000)
+
+#include "cli/environment.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int variables = argc > 1 ? std::atoi(argv[1]) : 500;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 20000;
+  cli::Environment env;
+  for (int i = 0; i < variables; ++i)
+    env.set("SERVICE_VARIABLE_" + std::to_string(i),
+            "/opt/service/config/value/" + std::to_string(i));
+
+  std::size_t sink = 0;
+  auto t0 = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    std::vector<std::string> strings = env.to_env_vector();
+    std::vector<char *> envp;
+    envp.reserve(strings.size() + 1);
+    for (std::string &s : strings)
+      envp.push_back(s.data());
+    envp.push_back(nullptr);
+    sink += envp.size();
+  }
+  const double rebuilt = seconds_since(t0) * 1e6 / iterations;
+
+  t0 = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    char *const *envp = env.envp();
+    sink += envp[0] != nullptr;
+  }
+  const double maintained = seconds_since(t0) * 1e6 / iterations;
+
+  t0 = Clock::now();
+  for (int i = 0; i < iterations; ++i)
+    env.set("SERVICE_VARIABLE_" + std::to_string(i % variables),
+            std::to_string(i));
+  const double set_cost = seconds_since(t0) * 1e6 / iterations;
+
+  std::printf("%d variables: rebuild per launch %8.3f us   envp() %8.4f us   "
+              "set() %6.3f us%s\n",
+              variables, rebuilt, maintained, set_cost, sink ? "" : " ");
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Throughput of common built-in pipeline shapes over a log file, run as
+// one fused single-pass operator versus stage by stage (CLI_FUSION=0):
+//   - cat FILE | wc
+//   - grep X FILE | wc
+//   - cat FILE | grep X | wc
+//
+// Usage: bench_fusion [size_mib]   (default 64)
+
+#include "cli/command_registry.hpp"
+#include "cli/commands/cat_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include "cli/execution_plan.hpp"
+#include "cli/executor.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void measure(cli::Executor &exec, const std::string &line, double mib) {
+  cli::ExecutionPlan plan = cli::ExecutionPlan::compile(line);
+  for (const char *fusion : {"1", "0"}) {
+    cli::Environment env;
+    env.set("CLI_FUSION", fusion);
+    std::istringstream in;
+    std::ostringstream out, err;
+    auto t0 = Clock::now();
+    exec.execute(plan, in, out, err, env);
+    double wall = seconds_since(t0);
+    std::printf("%-40s %-8s %8.1f MiB/s  %s", line.c_str(),
+                fusion[0] == '1' ? "fused" : "unfused", mib / wall,
+                out.str().c_str());
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long size_mib = argc > 1 ? std::atol(argv[1]) : 64;
+  const std::string path = "bench_fusion.log";
+  {
+    std::ofstream f(path, std::ios::binary);
+    const long target = size_mib * 1024 * 1024;
+    for (long i = 0, written = 0; written < target; ++i) {
+      std::string line = (i % 10 == 0 ? "ERROR disk " : "info request ") +
+                         std::to_string(i) + " done\n";
+      f << line;
+      written += static_cast<long>(line.size());
+    }
+  }
+
+  cli::CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<cli::CatCommand>());
+  registry.register_command("grep", std::make_unique<cli::GrepCommand>());
+  registry.register_command("wc", std::make_unique<cli::WcCommand>());
+  cli::Executor exec(registry);
+
+  const double mib = static_cast<double>(size_mib);
+  measure(exec, "cat " + path + " | wc", mib);
+  measure(exec, "grep ERROR " + path + " | wc", mib);
+  measure(exec, "cat " + path + " | grep ERROR | wc", mib);
+  std::remove(path.c_str());
+  return 0;
+}
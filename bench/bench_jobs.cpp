@@ -0,0 +1,70 @@
+// Wall time of several independent log scans (`grep ERROR LOG | wc`, run
+// by the built-ins) started one after another versus as background jobs
+// (`... &` on every line, then `wait`), through the interpreter loop.
+//
+// Usage: bench_jobs [jobs] [MiB per log]   (default 8 and 32)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+double run_script(const std::string &script) {
+  cli::CommandLineInterpreter interpreter;
+  std::istringstream in(script);
+  std::ostringstream out, err;
+  auto t0 = Clock::now();
+  interpreter.run(in, out, err);
+  double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  if (!err.str().empty())
+    std::fprintf(stderr, "%s", err.str().c_str());
+  return seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int jobs = argc > 1 ? std::atoi(argv[1]) : 8;
+  const long mib = argc > 2 ? std::atol(argv[2]) : 32;
+  const fs::path root = fs::temp_directory_path() /
+                        ("cli_bench_jobs_" + std::to_string(getpid()));
+  fs::create_directories(root);
+
+  std::string sequential, background;
+  for (int i = 0; i < jobs; ++i) {
+    const fs::path log = root / ("log" + std::to_string(i));
+    std::ofstream file(log);
+    const std::string info = "2024-01-01 12:00:00 INFO request served\n";
+    const std::string error = "2024-01-01 12:00:01 ERROR request failed\n";
+    for (long size = 0; size < mib * 1024 * 1024;) {
+      const std::string &line = size % 7 ? info : error;
+      file << line;
+      size += static_cast<long>(line.size());
+    }
+    const std::string scan = "grep ERROR " + log.string() + " | wc";
+    sequential += scan + "\n";
+    background += scan + " &\n";
+  }
+  background += "wait\n";
+
+  const double one_by_one = run_script(sequential);
+  const double overlapped = run_script(background);
+  std::printf("%d scans of %ld MiB on %u hardware threads\n", jobs, mib,
+              std::thread::hardware_concurrency());
+  std::printf("one after another  %7.3f s\n", one_by_one);
+  std::printf("background jobs    %7.3f s  (%.1fx)\n", overlapped,
+              one_by_one / overlapped);
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Launch latency of a short external command (/bin/true) started by the
+// interpreter with fork/exec, with posix_spawn, and through the Zygote,
+// while the interpreter holds a growing amount of touched heap memory.
+// fork() copies page tables, so it slows down with RSS; posix_spawn (a
+// vfork-style clone on glibc) and the zygote should stay flat.
+//
+// Usage: bench_launch [commands] [rss_mib...]
+//        (default 500, 0 256 1024 2048)
+
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/zygote.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double launch_us(cli::Zygote *zygote, const char *launcher, int count) {
+  cli::ExternalCommand cmd;
+  cmd.set_zygote(zygote);
+  cli::Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  env.set("CLI_LAUNCHER", launcher);
+  auto t0 = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    std::istringstream in;
+    std::ostringstream out, err;
+    cmd.execute({"true"}, in, out, err, env);
+  }
+  return seconds_since(t0) * 1e6 / count;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int commands = argc > 1 ? std::atoi(argv[1]) : 500;
+  std::vector<long> sizes;
+  for (int i = 2; i < argc; ++i)
+    sizes.push_back(std::atol(argv[i]));
+  if (sizes.empty())
+    sizes = {0, 256, 1024, 2048};
+
+  // Started first, like the interpreter does, while the process is small.
+  std::unique_ptr<cli::Zygote> zygote = cli::Zygote::start();
+  if (!zygote) {
+    std::printf("zygote not supported on this platform\n");
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<char[]>> ballast;
+  long held = 0;
+  for (long mib : sizes) {
+    for (; held < mib; ++held) {
+      ballast.emplace_back(new char[1024 * 1024]);
+      std::memset(ballast.back().get(), 1, 1024 * 1024);
+    }
+    std::printf("RSS +%5ld MiB   fork %8.1f   posix_spawn %8.1f   zygote "
+                "%8.1f us/command\n",
+                mib, launch_us(nullptr, "fork", commands),
+                launch_us(nullptr, "spawn", commands),
+                launch_us(zygote.get(), "spawn", commands));
+  }
+  return 0;
+}
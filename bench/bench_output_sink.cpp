@@ -0,0 +1,114 @@
+// Output of a built-in `grep` that matches every line of a 10M-line file,
+// written to a file through the interpreter's stdout:
+//   - sink, block   OutputSink as chosen for a file (the default)
+//   - sink, line    OutputSink flushing every line, as for a terminal
+//                   (CLI_OUTPUT_BUFFER=line)
+//   - std::cout     no sink, std::cout synced with stdio
+//                   (CLI_OUTPUT_BUFFER=0)
+// Each variant runs in a child process with stdout redirected to the file;
+// the write(2) calls are the child's `syscw` from /proc/self/io (Linux).
+//
+// Usage: bench_output_sink [lines]   (default 10000000)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+  double seconds;
+  long long write_calls;
+};
+
+/** write(2) calls made by this process so far, or -1 if unknown. */
+long long write_calls() {
+  std::ifstream io("/proc/self/io");
+  std::string key;
+  long long value = 0;
+  while (io >> key >> value) {
+    if (key == "syscw:")
+      return value;
+  }
+  return -1;
+}
+
+/** Runs `script` in a child interpreter with stdout going to `out_path`. */
+Sample run_child(const char *mode, const std::string &script,
+                 const std::string &out_path) {
+  int result[2];
+  if (pipe(result) != 0)
+    std::exit(1);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(result[0]);
+    setenv("CLI_OUTPUT_BUFFER", mode, 1);
+    const int fd = open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+    Sample sample{0, 0};
+    {
+      cli::CommandLineInterpreter interpreter;
+      std::istringstream in(script);
+      const long long before = write_calls();
+      auto t0 = Clock::now();
+      interpreter.run(in, std::cout, std::cerr);
+      std::cout.flush();
+      std::fflush(stdout);
+      sample.seconds =
+          std::chrono::duration<double>(Clock::now() - t0).count();
+      const long long after = write_calls();
+      sample.write_calls = before < 0 ? -1 : after - before;
+    }
+    [[maybe_unused]] ssize_t n = write(result[1], &sample, sizeof(sample));
+    _exit(0);
+  }
+  close(result[1]);
+  Sample sample{0, -1};
+  if (read(result[0], &sample, sizeof(sample)) != sizeof(sample))
+    std::fprintf(stderr, "child failed\n");
+  close(result[0]);
+  waitpid(pid, nullptr, 0);
+  return sample;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long lines = argc > 1 ? std::atol(argv[1]) : 10000000;
+  const std::string in_path = "bench_output_sink.log";
+  const std::string out_path = "bench_output_sink.out";
+  {
+    std::ofstream f(in_path, std::ios::binary);
+    for (long i = 0; i < lines; ++i)
+      f << "request " << i << " done\n";
+  }
+  std::ifstream probe(in_path, std::ios::binary | std::ios::ate);
+  const double mib = static_cast<double>(probe.tellg()) / (1024 * 1024);
+
+  const std::string script = "grep request " + in_path + "\n";
+  const struct {
+    const char *mode;
+    const char *label;
+  } variants[] = {
+      {"block", "sink, block"}, {"line", "sink, line"}, {"0", "std::cout"}};
+  for (const auto &variant : variants) {
+    Sample s = run_child(variant.mode, script, out_path);
+    std::printf("%-12s %8.3f s %8.1f MiB/s %10lld write calls\n",
+                variant.label, s.seconds, mib / s.seconds, s.write_calls);
+  }
+  std::remove(in_path.c_str());
+  std::remove(out_path.c_str());
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Wall time of the `parallel` built-in with -j 1 and with one command per
+// pool worker, for CPU-bound built-ins (`grep ERROR` over 32 MiB logs) and
+// for external programs that mostly wait (`sleep 0.05`).
+//
+// Usage: bench_parallel [items] [MiB per log]   (default 8 and 32)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+double run_line(const std::string &line) {
+  cli::CommandLineInterpreter interpreter;
+  std::istringstream in(line + "\n");
+  std::ostringstream out, err;
+  auto t0 = Clock::now();
+  interpreter.run(in, out, err);
+  double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  if (!err.str().empty())
+    std::fprintf(stderr, "%s", err.str().c_str());
+  return seconds;
+}
+
+void report(const char *name, const std::string &one, const std::string &all) {
+  const double serial = run_line(one);
+  const double parallel = run_line(all);
+  std::printf("%-8s -j 1 %7.3f s   -j N %7.3f s  (%.1fx)\n", name, serial,
+              parallel, serial / parallel);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int items = argc > 1 ? std::atoi(argv[1]) : 8;
+  const long mib = argc > 2 ? std::atol(argv[2]) : 32;
+  const fs::path root = fs::temp_directory_path() /
+                        ("cli_bench_parallel_" + std::to_string(getpid()));
+  fs::create_directories(root);
+
+  std::string logs, sleeps;
+  for (int i = 0; i < items; ++i) {
+    const fs::path log = root / ("log" + std::to_string(i));
+    std::ofstream file(log);
+    const std::string info = "2024-01-01 12:00:00 INFO request served\n";
+    const std::string error = "2024-01-01 12:00:01 ERROR request failed\n";
+    for (long size = 0; size < mib * 1024 * 1024;) {
+      const std::string &line = size % 7 ? info : error;
+      file << line;
+      size += static_cast<long>(line.size());
+    }
+    logs += " " + log.string();
+    sleeps += " 0.05";
+  }
+
+  std::printf("%d items on %u hardware threads\n", items,
+              std::thread::hardware_concurrency());
+  report("grep", "parallel -j 1 grep ERROR :::" + logs,
+         "parallel grep ERROR :::" + logs);
+  report("sleep", "parallel -j 1 sleep :::" + sleeps,
+         "parallel -j " + std::to_string(items) + " sleep :::" + sleeps);
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Cost of looking up command names in a PATH of 20 directories: a full
+// search (ExternalCommand::resolve, one stat() per directory until a match)
+// versus the PathCache, for a program in the last directory and for a name
+// that is not found anywhere.
+//
+// Usage: bench_path_cache [lookups]   (default 100000)
+
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/path_cache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kDirs = 20;
+
+double us_per_lookup(int lookups,
+                     const std::function<std::string()> &lookup) {
+  auto t0 = Clock::now();
+  std::size_t sink = 0;
+  for (int i = 0; i < lookups; ++i)
+    sink += lookup().size();
+  double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  if (sink == 0)
+    std::printf("?");
+  return seconds * 1e6 / lookups;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int lookups = argc > 1 ? std::atoi(argv[1]) : 100000;
+  const fs::path root = fs::temp_directory_path() /
+                        ("cli_bench_path_cache_" + std::to_string(getpid()));
+  std::string path_value;
+  for (int i = 0; i < kDirs; ++i) {
+    fs::path dir = root / std::to_string(i);
+    fs::create_directories(dir);
+    path_value += (i ? ":" : "") + dir.string();
+  }
+  const fs::path program = root / std::to_string(kDirs - 1) / "tool";
+  std::ofstream(program) << "#!/bin/sh\n";
+  fs::permissions(program, fs::perms::owner_all);
+
+  cli::Environment env;
+  env.set("PATH", path_value);
+  cli::PathCache cache;
+  for (const char *name : {"tool", "missing"}) {
+    std::printf("%-8s search %7.3f us/lookup   PathCache %7.3f us/lookup\n",
+                name,
+                us_per_lookup(lookups,
+                              [&] {
+                                return cli::ExternalCommand::resolve(env,
+                                                                     name);
+                              }),
+                us_per_lookup(lookups,
+                              [&] { return cache.resolve(env, name); }));
+  }
+  fs::remove_all(root);
+  return 0;
+}
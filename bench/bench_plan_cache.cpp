@@ -0,0 +1,69 @@
+// Front-end cost of a script that repeats the same few lines: every line
+// compiled from scratch (PlanCache of capacity 0) versus compiled once and
+// reused from the PlanCache. Each iteration also binds the plan and runs it
+// through the Executor with built-in commands, as the interpreter does.
+//
+// Usage: bench_plan_cache [iterations]   (default 200000)
+
+#include "cli/command_registry.hpp"
+#include "cli/commands/echo_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include "cli/execution_plan.hpp"
+#include "cli/executor.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+const char *const kScript[] = {
+    "N=$I echo iteration $N of the loop",
+    "echo \"quoted $N\" 'literal $N' | wc -w",
+    "echo ${N}x${N}",
+};
+
+void measure(const char *name, std::size_t capacity, int iterations) {
+  cli::CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<cli::EchoCommand>());
+  registry.register_command("wc", std::make_unique<cli::WcCommand>());
+  cli::Executor exec(registry);
+  cli::Environment env;
+  env.set("I", "1");
+  cli::PlanCache cache(capacity);
+  std::istringstream in;
+  std::ostringstream out, err;
+
+  double front_end = 0;
+  auto t0 = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (const char *line : kScript) {
+      auto c0 = Clock::now();
+      const cli::ExecutionPlan &plan = cache.get(line);
+      front_end += seconds_since(c0);
+      plan.apply_assignments(env);
+      exec.execute(plan, in, out, err, env);
+      out.str({});
+    }
+  }
+  const double lines = static_cast<double>(iterations) * std::size(kScript);
+  std::printf("%-22s %8.3f us/line total, %8.3f us/line compile\n", name,
+              seconds_since(t0) * 1e6 / lines, front_end * 1e6 / lines);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+  measure("compile every line", 0, iterations);
+  measure("plan cache", cli::PlanCache::kDefaultCapacity, iterations);
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Per-script overhead of a short script (a few assignments, built-ins and
+// one external program) run many times: in process, with a fresh
+// CommandLineInterpreter fed through run() as the REPL reads stdin and
+// through run_script(); and, given the path of the interpreter binary, as
+// one process per script reading the script from stdin, from `-c` and
+// from a file.
+//
+// Usage: bench_script_mode [runs] [interpreter]   (default 200, none)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *const kScript = "#!/usr/bin/env cli\n"
+                            "NAME=report\n"
+                            "echo start $NAME | wc -c\n"
+                            "pwd && echo ok || echo failed\n"
+                            "true\n"
+                            "echo done; X=1\n";
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *label, int runs, double wall) {
+  std::printf("%-28s %9.1f us/script\n", label, wall * 1e6 / runs);
+}
+
+#ifndef _WIN32
+/** Run `argv` with `input` on stdin and its output discarded. */
+void run_process(const std::vector<const char *> &argv,
+                 const std::string &input) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return;
+  const pid_t pid = fork();
+  if (pid == 0) {
+    dup2(fds[0], 0);
+    const int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    dup2(null, 2);
+    close(fds[0]);
+    close(fds[1]);
+    std::vector<char *> args;
+    for (const char *arg : argv)
+      args.push_back(const_cast<char *>(arg));
+    args.push_back(nullptr);
+    execv(args[0], args.data());
+    _exit(127);
+  }
+  close(fds[0]);
+  if (!input.empty() && write(fds[1], input.data(), input.size()) < 0)
+    std::perror("write");
+  close(fds[1]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int runs = argc > 1 ? std::atoi(argv[1]) : 200;
+  const char *interpreter = argc > 2 ? argv[2] : nullptr;
+  // The REPL has no shebang handling; the line would fail as a command.
+  const std::string repl_script = std::string(kScript).substr(
+      std::string(kScript).find('\n') + 1);
+
+  {
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i) {
+      cli::CommandLineInterpreter cli;
+      std::istringstream in(repl_script);
+      std::ostringstream out, err;
+      cli.run(in, out, err);
+    }
+    report("in process, run()", runs, seconds_since(t0));
+  }
+  {
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i) {
+      cli::CommandLineInterpreter cli;
+      std::istringstream in;
+      std::ostringstream out, err;
+      cli.run_script(kScript, in, out, err);
+    }
+    report("in process, run_script()", runs, seconds_since(t0));
+  }
+#ifndef _WIN32
+  if (interpreter) {
+    const std::string path = "bench_script_mode.cli";
+    std::ofstream(path) << kScript;
+    const struct {
+      const char *label;
+      std::vector<const char *> argv;
+      std::string input;
+    } modes[] = {
+        {"process, script on stdin", {interpreter}, repl_script},
+        {"process, -c", {interpreter, "-c", kScript}, ""},
+        {"process, script file", {interpreter, path.c_str()}, ""},
+    };
+    for (const auto &mode : modes) {
+      auto t0 = Clock::now();
+      for (int i = 0; i < runs; ++i)
+        run_process(mode.argv, mode.input);
+      report(mode.label, runs, seconds_since(t0));
+    }
+    std::remove(path.c_str());
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Startup cost of the interpreter: constructing and destroying a
+// CommandLineInterpreter in process (with and without running `true`) and,
+// given the path of `cli_app`, the time from exec to the first prompt of
+// the interactive mode and to the exit of `cli_app -c true`, next to
+// `/bin/true` as the cost of starting any process.
+//
+// Usage: bench_startup [runs] [cli_app]   (default 200, none)
+
+#include "cli/command_line_interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *label, int runs, double wall) {
+  std::printf("%-28s %9.1f us\n", label, wall * 1e6 / runs);
+}
+
+#ifndef _WIN32
+/** Start `argv` with stdin and stdout on the given descriptors (-1 for
+ * /dev/null) and stderr on /dev/null; returns its pid. */
+pid_t spawn(const std::vector<const char *> &argv, int in_fd, int out_fd) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    const int null = open("/dev/null", O_RDWR);
+    dup2(in_fd >= 0 ? in_fd : null, 0);
+    dup2(out_fd >= 0 ? out_fd : null, 1);
+    dup2(null, 2);
+    std::vector<char *> args;
+    for (const char *arg : argv)
+      args.push_back(const_cast<char *>(arg));
+    args.push_back(nullptr);
+    execv(args[0], args.data());
+    _exit(127);
+  }
+  return pid;
+}
+
+/** Run `argv` to completion; false if it did not exit with 0. */
+bool run_process(const std::vector<const char *> &argv) {
+  int status = 0;
+  waitpid(spawn(argv, -1, -1), &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/** pipe(2) with both ends closed on exec, so the interpreter sees EOF once
+ * the benchmark closes its end. */
+bool make_pipe(int fds[2]) {
+  if (pipe(fds) != 0)
+    return false;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return true;
+}
+
+/** Start the interactive interpreter, wait for its first prompt, then
+ * close its stdin. Returns the time to the prompt, or a negative value if
+ * no prompt came. */
+double time_to_prompt(const char *app) {
+  int in[2], out[2];
+  if (!make_pipe(in) || !make_pipe(out))
+    return -1;
+  const auto t0 = Clock::now();
+  const pid_t pid = spawn({app}, in[0], out[1]);
+  close(in[0]);
+  close(out[1]);
+  std::string seen;
+  char buf[256];
+  ssize_t n;
+  while (seen.find("> ") == std::string::npos &&
+         (n = read(out[0], buf, sizeof(buf))) > 0)
+    seen.append(buf, static_cast<std::size_t>(n));
+  const double wall = seconds_since(t0);
+  close(in[1]);
+  while (read(out[0], buf, sizeof(buf)) > 0) {
+  }
+  close(out[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return seen.find("> ") == std::string::npos ? -1 : wall;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int runs = argc > 1 ? std::atoi(argv[1]) : 200;
+  const char *app = argc > 2 ? argv[2] : nullptr;
+  {
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i)
+      cli::CommandLineInterpreter cli;
+    report("in process, construct", runs, seconds_since(t0));
+  }
+  {
+    auto t0 = Clock::now();
+    for (int i = 0; i < runs; ++i) {
+      cli::CommandLineInterpreter cli;
+      std::istringstream in;
+      std::ostringstream out, err;
+      cli.run_script("true", in, out, err);
+    }
+    report("in process, run_script true", runs, seconds_since(t0));
+  }
+#ifndef _WIN32
+  if (app) {
+    int failures = 0;
+    {
+      auto t0 = Clock::now();
+      for (int i = 0; i < runs; ++i)
+        failures += !run_process({"/bin/true"});
+      report("process, /bin/true", runs, seconds_since(t0));
+    }
+    {
+      double wall = 0;
+      for (int i = 0; i < runs; ++i) {
+        const double t = time_to_prompt(app);
+        failures += t < 0;
+        wall += t < 0 ? 0 : t;
+      }
+      report("process, exec to prompt", runs, wall);
+    }
+    {
+      auto t0 = Clock::now();
+      for (int i = 0; i < runs; ++i)
+        failures += !run_process({app, "-c", "true"});
+      report("process, -c true to exit", runs, seconds_since(t0));
+    }
+    // Run as a test, the benchmark fails if the interpreter did not start.
+    if (failures != 0) {
+      std::fprintf(stderr, "%d of the runs failed\n", failures);
+      return 1;
+    }
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Cost of starting the helper tasks of a command (stdin writer, stderr
+// reader) on a fresh std::thread versus the interpreter-wide ThreadPool:
+//   - an empty helper task started and waited for;
+//   - a short external command (/bin/true) run through the Executor, as in
+//     a script that invokes thousands of them.
+//
+// Usage: bench_thread_pool [commands]   (default 2000)
+
+#include "cli/ast.hpp"
+#include "cli/command_registry.hpp"
+#include "cli/executor.hpp"
+#include "cli/thread_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void measure_tasks(const char *name, cli::ThreadPool *pool, int count) {
+  auto t0 = Clock::now();
+  for (int i = 0; i < count; ++i)
+    cli::run_concurrently(pool, [] {}).wait();
+  std::printf("%-32s %8.2f us/task\n", name,
+              seconds_since(t0) * 1e6 / count);
+}
+
+void measure_commands(const char *name, cli::ThreadPool *pool, int count) {
+  cli::CommandRegistry registry;
+  cli::Executor exec(registry);
+  exec.set_thread_pool(pool);
+  cli::Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  cli::Pipeline pl;
+  pl.push_back(cli::CommandNode{"true", {}, cli::Substitute::Yes, {}});
+  auto t0 = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    std::istringstream in;
+    std::ostringstream out, err;
+    exec.execute(pl, in, out, err, env);
+  }
+  std::printf("%-32s %8.2f us/command\n", name,
+              seconds_since(t0) * 1e6 / count);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int commands = argc > 1 ? std::atoi(argv[1]) : 2000;
+  cli::ThreadPool pool(4);
+
+  measure_tasks("helper task, new thread", nullptr, 100000);
+  measure_tasks("helper task, thread pool", &pool, 100000);
+  measure_commands("external true, new thread", nullptr, commands);
+  measure_commands("external true, thread pool", &pool, commands);
+  return 0;
+}
@@ -0,0 +1,201 @@
+// Parent-side CPU cost of moving data between descriptors: the iostream copy
+// loops used before (4 KiB read() into std::ostream, std::ifstream into
+// std::ostream) versus cli::transfer_fd (splice/sendfile on Linux), and an
+// external `cat FILE` whose output the interpreter copies versus one that
+// is given the output descriptor itself.
+//
+// Usage: bench_zero_copy [size_mib]   (default 512)
+
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/fd_io.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+double cpu_seconds() {
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  auto tv = [](const timeval &t) { return t.tv_sec + t.tv_usec / 1e6; };
+  return tv(ru.ru_utime) + tv(ru.ru_stime);
+}
+
+/// Forks a child that drains the read end of `fds` into /dev/null.
+pid_t spawn_sink(const int fds[2]) {
+  const int read_fd = fds[0];
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[1]);
+    int null_fd = open("/dev/null", O_WRONLY);
+    cli::transfer_fd(read_fd, null_fd);
+    _exit(0);
+  }
+  return pid;
+}
+
+/// Forks a child that writes the file at `path` into `fd`.
+pid_t spawn_source(const std::string &path, int write_fd) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    int file_fd = open(path.c_str(), O_RDONLY);
+    cli::transfer_fd(file_fd, write_fd);
+    _exit(0);
+  }
+  return pid;
+}
+
+/// Writes to a descriptor, but is not recognised by cli::output_fd(), so
+/// the interpreter has to copy a child's output into it.
+class OpaqueFdBuf : public std::streambuf {
+public:
+  explicit OpaqueFdBuf(int fd) : fd_(fd) {}
+
+protected:
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    std::streamsize left = n;
+    while (left > 0) {
+      ssize_t w = write(fd_, s, static_cast<std::size_t>(left));
+      if (w <= 0)
+        return n - left;
+      s += w;
+      left -= w;
+    }
+    return n;
+  }
+  int_type overflow(int_type ch) override {
+    char c = traits_type::to_char_type(ch);
+    return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+  }
+
+private:
+  int fd_;
+};
+
+/// Runs external `cat path` with its output going to `o`.
+void external_cat(const std::string &path, std::ostream &o) {
+  cli::ExternalCommand cmd;
+  cli::Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  std::istringstream in;
+  std::ostringstream err;
+  cmd.execute({"cat", path}, in, o, err, env);
+  o.flush();
+}
+
+struct Pipe {
+  int fds[2] = {-1, -1};
+  Pipe() {
+    if (pipe(fds) != 0)
+      std::exit(1);
+  }
+};
+
+/// Runs `copy(src_fd, dst_fd)` in the parent with children on both ends
+/// (or a file as the source) and prints parent CPU per GiB.
+void measure(const char *name, const std::string &file, bool from_pipe,
+             double gib, const std::function<void(int, int)> &copy) {
+  Pipe out;
+  pid_t sink = spawn_sink(out.fds);
+  close(out.fds[0]);
+
+  int src_fd = -1;
+  pid_t source = -1;
+  if (from_pipe) {
+    Pipe in;
+    source = spawn_source(file, in.fds[1]);
+    close(in.fds[1]);
+    src_fd = in.fds[0];
+  } else {
+    src_fd = open(file.c_str(), O_RDONLY);
+  }
+
+  double cpu0 = cpu_seconds();
+  auto t0 = std::chrono::steady_clock::now();
+  copy(src_fd, out.fds[1]);
+  auto t1 = std::chrono::steady_clock::now();
+  double cpu = cpu_seconds() - cpu0;
+
+  close(src_fd);
+  close(out.fds[1]);
+  waitpid(sink, nullptr, 0);
+  if (source > 0)
+    waitpid(source, nullptr, 0);
+
+  double wall = std::chrono::duration<double>(t1 - t0).count();
+  std::printf("%-34s wall %7.3f s  %8.1f MiB/s  parent CPU %6.3f s/GiB\n",
+              name, wall, gib * 1024 / wall, cpu / gib);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long mib = argc > 1 ? std::atol(argv[1]) : 512;
+  char tmpl[] = "/tmp/cli_bench_zero_copy_XXXXXX";
+  int fd = mkstemp(tmpl);
+  if (fd < 0)
+    return 1;
+  std::string path = tmpl;
+  std::vector<char> block(1 << 20);
+  for (std::size_t i = 0; i < block.size(); ++i)
+    block[i] = (i % 64 == 63) ? '\n' : static_cast<char>('a' + i % 26);
+  for (long i = 0; i < mib; ++i) {
+    if (write(fd, block.data(), block.size()) < 0)
+      return 1;
+  }
+  close(fd);
+  const double gib = mib / 1024.0;
+  std::printf("payload: %ld MiB\n", mib);
+
+  auto read_pipe_loop = [](int src, int dst) {
+    cli::FdStreamBuf buf(dst);
+    std::ostream o(&buf);
+    std::array<char, 4096> chunk;
+    ssize_t n;
+    while ((n = read(src, chunk.data(), chunk.size())) > 0)
+      o.write(chunk.data(), n);
+    o.flush();
+  };
+  auto kernel = [](int src, int dst) { cli::transfer_fd(src, dst); };
+
+  measure("pipe -> pipe, read_pipe + ostream", path, true, gib,
+          read_pipe_loop);
+  measure("pipe -> pipe, transfer_fd", path, true, gib, kernel);
+
+  measure("file -> pipe, ifstream + ostream", path, false, gib,
+          [&path](int, int dst) {
+            std::ifstream f(path, std::ios::binary);
+            cli::FdStreamBuf buf(dst);
+            std::ostream o(&buf);
+            o << f.rdbuf();
+            o.flush();
+          });
+  measure("file -> pipe, transfer_fd", path, false, gib, kernel);
+
+  measure("external cat, output copied", path, false, gib,
+          [&path](int, int dst) {
+            OpaqueFdBuf buf(dst);
+            std::ostream o(&buf);
+            external_cat(path, o);
+          });
+  measure("external cat, output fd inherited", path, false, gib,
+          [&path](int, int dst) {
+            cli::FdStreamBuf buf(dst);
+            std::ostream o(&buf);
+            external_cat(path, o);
+          });
+
+  std::remove(path.c_str());
+  return 0;
+}
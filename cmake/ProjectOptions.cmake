@@ -4,3 +4,5 @@ option(CLI_ENABLE_ASAN "Enable AddressSanitizer" OFF)
 option(CLI_ENABLE_UBSAN "Enable UndefinedBehaviorSanitizer" OFF)
 
 option(CLI_ENABLE_CLANG_TIDY "Enable clang-tidy during build" OFF)
+
+option(CLI_BUILD_BENCHMARKS "Build benchmark executables in bench/" OFF)
@@ -41,4 +41,30 @@ struct CommandNode {
  */
 using Pipeline = std::vector<CommandNode>;
 
+/**
+ * Operator that joins a pipeline of a command list to the one before it.
+ *
+ * `Sequence` (`;`) always runs the pipeline; `And` (`&&`) runs it only if
+ * the previous status is 0 and `Or` (`||`) only if it is not. As in sh, the
+ * operators have equal precedence and group from the left.
+ */
+enum class ListOperator { Sequence, And, Or };
+
+/**
+ * One pipeline of a command list.
+ */
+struct ListItem {
+  /// How the item is joined to the previous one; `Sequence` for the first.
+  ListOperator op{ListOperator::Sequence};
+  /// The pipeline; empty if nothing but whitespace stood between the
+  /// operators.
+  Pipeline pipeline;
+};
+
+/**
+ * Command list: pipelines separated by `;`, `&&` and `||`, run one after
+ * another in the same interpreter.
+ */
+using CommandList = std::vector<ListItem>;
+
 } // namespace cli
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Input of a command as a sequence of byte chunks.
+ *
+ * The chunked counterpart of `std::istream`: one virtual call hands over a
+ * whole buffer instead of a character or a line, and the command scans it
+ * in place.
+ *
+ * @see ByteSink
+ * @see ChunkedCommand
+ */
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+
+  /**
+   * Return the next chunk of input.
+   *
+   * @returns The chunk, valid until the next call; empty at end of input
+   *     (or after a read error, see failed()).
+   */
+  virtual std::span<const char> next() = 0;
+
+  /// True if reading stopped because of an error rather than end of input.
+  virtual bool failed() const { return false; }
+
+  /// Tell the producer that no more input will be read (see close_input()).
+  virtual void close() {}
+};
+
+/**
+ * Output of a command as a sequence of byte chunks.
+ *
+ * @see ByteSource
+ * @see ChunkedCommand
+ */
+class ByteSink {
+public:
+  virtual ~ByteSink() = default;
+
+  /**
+   * Write a chunk.
+   *
+   * @param[in] data Bytes to write; may be empty. A `std::string`
+   *     converts implicitly.
+   *
+   * @returns False once nothing written can reach a consumer any more
+   *     (see output_closed()); the producer should stop.
+   */
+  virtual bool write(std::span<const char> data) = 0;
+};
+
+/**
+ * ByteSource that reads a `std::istream`.
+ *
+ * Chunks come straight from the descriptor when the stream is fd-backed
+ * (see input_fd()) and straight from the channel for a PipeChannel stream,
+ * also behind a CountingReadBuf, which is then told what was read; any
+ * other stream is read with `sgetn()`, one virtual call per chunk.
+ * close() calls close_input() on the stream.
+ */
+class StreamByteSource : public ByteSource {
+public:
+  /// Chunk size.
+  static constexpr std::size_t kChunkSize = 64 * 1024;
+
+  /**
+   * @param[in,out] in Stream to read; must outlive the source.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit StreamByteSource(std::istream &in);
+
+  std::span<const char> next() override;
+  bool failed() const override { return failed_; }
+  void close() override;
+
+private:
+  std::istream &in_;
+  int fd_;
+  std::vector<char> buffer_;
+  bool failed_{false};
+};
+
+/**
+ * ByteSource over a file, shared by the built-ins that take file operands
+ * (cat, wc, grep and their fused and cooperative forms).
+ *
+ * A non-empty regular file is mapped with `mmap(2)` and advised
+ * `MADV_SEQUENTIAL`, and next() hands out slices of the mapping, so the
+ * command scans the page cache in place: no `read(2)` and no copy. Pipes,
+ * terminals and other special files (e.g. `/dev/stdin`), empty files
+ * (`/proc` files report size 0), files that cannot be mapped, and all files
+ * on Windows are read with `read(2)` into a buffer instead.
+ *
+ * The mapping covers the size at open time; bytes appended later are not
+ * seen. Like any reader of a mapping, the process gets SIGBUS if the file
+ * is truncated while being scanned.
+ */
+class FileByteSource : public ByteSource {
+public:
+  /// Size of the slices handed out from a mapping.
+  static constexpr std::size_t kMappedChunkSize = 1024 * 1024;
+
+  /**
+   * Open `path` for reading.
+   *
+   * @param[in] path File to read.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit FileByteSource(const std::string &path);
+  ~FileByteSource() override;
+
+  FileByteSource(const FileByteSource &) = delete;
+  FileByteSource &operator=(const FileByteSource &) = delete;
+
+  /// False if the file could not be opened.
+  bool is_open() const { return fd_ >= 0; }
+
+  /// True if the file is read from a mapping rather than with `read(2)`.
+  bool mapped() const { return map_ != nullptr; }
+
+  std::span<const char> next() override;
+  bool failed() const override { return failed_; }
+
+private:
+  void map_file();
+
+  int fd_;
+  const char *map_{nullptr};
+  std::size_t map_size_{0};
+  std::size_t offset_{0};
+  std::vector<char> buffer_;
+  bool failed_{false};
+};
+
+/**
+ * ByteSink that writes to a `std::ostream`, one `write()` per chunk.
+ */
+class StreamByteSink : public ByteSink {
+public:
+  /**
+   * @param[in,out] out Stream to write; must outlive the sink.
+   */
+  explicit StreamByteSink(std::ostream &out) : out_(out) {}
+
+  bool write(std::span<const char> data) override;
+
+private:
+  std::ostream &out_;
+};
+
+/**
+ * Input stream buffer over a ByteSource, so a command that takes
+ * `std::istream` can read from one. Chunks are used in place, not copied.
+ */
+class ByteSourceBuf : public std::streambuf {
+public:
+  /**
+   * @param[in,out] source Source to read; must outlive this buffer.
+   */
+  explicit ByteSourceBuf(ByteSource &source) : source_(source) {}
+
+protected:
+  int_type underflow() override;
+
+private:
+  ByteSource &source_;
+};
+
+/**
+ * Output stream buffer over a ByteSink, so a command that takes
+ * `std::ostream` can write to one. Small writes are collected into chunks;
+ * once the sink refuses a write, further writes fail, which sets `badbit`
+ * on the owning stream.
+ */
+class ByteSinkBuf : public std::streambuf {
+public:
+  /**
+   * @param[in,out] sink Sink to write; must outlive this buffer.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit ByteSinkBuf(ByteSink &sink);
+  ~ByteSinkBuf() override;
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  bool flush_buffer();
+
+  ByteSink &sink_;
+  std::vector<char> buffer_;
+  bool failed_{false};
+};
+
+/**
+ * Copy everything from `in` to `out`.
+ *
+ * @returns False if `out` refused a chunk (the consumer has finished).
+ *
+ * @exceptsafe Whatever the source and sink guarantee.
+ */
+bool copy_bytes(ByteSource &in, ByteSink &out);
+
+} // namespace cli
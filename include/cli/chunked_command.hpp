@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cli/byte_stream.hpp"
+#include "cli/command.hpp"
+#include "cli/environment.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Optional interface of built-ins that do their I/O in chunks.
+ *
+ * Going through `std::istream`/`std::ostream` costs a virtual streambuf
+ * call per `getline()` or `<<`, which is most of the work of a command like
+ * `grep` that looks at every line. A chunked command reads whole buffers
+ * from a ByteSource, scans them in place and hands whole buffers of output
+ * to a ByteSink. Such a command usually implements Command::execute() by
+ * wrapping its streams in a StreamByteSource and a StreamByteSink;
+ * run_chunked() does the opposite for commands that only take streams.
+ *
+ * The output of execute_chunks() must match Command::execute() for the
+ * same arguments and input.
+ *
+ * @see ByteSource
+ * @see ByteSink
+ * @see CooperativeCommand
+ */
+class ChunkedCommand {
+public:
+  virtual ~ChunkedCommand() = default;
+
+  /**
+   * Run the command on chunked input and output.
+   *
+   * @param[in] args Command name (args[0]) and arguments.
+   * @param[in,out] in Standard input.
+   * @param[in,out] out Standard output.
+   * @param[in,out] err Standard error stream.
+   * @param[in] env Current environment.
+   *
+   * @returns Exit code, as from Command::execute().
+   */
+  virtual int execute_chunks(const std::vector<std::string> &args,
+                             ByteSource &in, ByteSink &out, std::ostream &err,
+                             const Environment &env) = 0;
+};
+
+/**
+ * Run any command on a ByteSource and a ByteSink: directly if it is a
+ * ChunkedCommand, otherwise through a ByteSourceBuf and a ByteSinkBuf.
+ *
+ * @param[in,out] command Command to run.
+ * @param[in] args Command name (args[0]) and arguments.
+ * @param[in,out] in Standard input.
+ * @param[in,out] out Standard output; everything the command wrote has
+ *     been passed to it when run_chunked() returns.
+ * @param[in,out] err Standard error stream.
+ * @param[in] env Current environment.
+ *
+ * @returns The command's exit code.
+ *
+ * @exceptsafe Whatever the command guarantees.
+ */
+int run_chunked(Command &command, const std::vector<std::string> &args,
+                ByteSource &in, ByteSink &out, std::ostream &err,
+                const Environment &env);
+
+} // namespace cli
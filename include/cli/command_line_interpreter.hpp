@@ -2,21 +2,33 @@
 
 #include "cli/command_registry.hpp"
 #include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
 #include "cli/executor.hpp"
-#include "cli/parser.hpp"
+#include "cli/job_table.hpp"
+#include "cli/path_cache.hpp"
+#include "cli/thread_pool.hpp"
+#include "cli/zygote.hpp"
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace cli {
 
 /**
  * Main REPL: read a line, parse it, execute the pipeline, repeat until exit.
  *
- * Combines a Parser, Environment, CommandRegistry, and Executor to implement
- * a read-eval-print loop. Built-in commands (cat, echo, pwd, wc, grep, exit) are
- * registered at construction; unknown names are executed as external programs.
+ * Combines a PlanCache, Environment, CommandRegistry, and Executor to implement
+ * a read-eval-print loop. Built-in commands (cat, echo, pwd, wc, grep, head,
+ * hash, jobs, wait, fg, parallel, exit) are registered at construction;
+ * unknown names are executed as external programs, looked up in `PATH`
+ * through a PathCache. A line may be a command list whose pipelines are
+ * separated by `;`, `&&` and `||`. Lines ending with `&` run as background
+ * jobs (see JobTable); lines starting with `time` report what each stage
+ * cost.
  *
- * @see Parser
+ * @see ExecutionPlan
  * @see Executor
  * @see CommandRegistry
  */
@@ -25,8 +37,14 @@ public:
   /**
    * Construct an interpreter with default built-ins and current environment.
    *
-   * Registers the built-in commands (cat, echo, pwd, wc, grep, exit) and
-   * initializes the environment from the current process (e.g. getenv).
+   * Registers the built-in commands (cat, echo, pwd, wc, grep, head, hash,
+   * jobs, wait, fg, parallel, exit) and initializes the environment from
+   * the current process (e.g. getenv).
+   * Starts the interpreter-wide ThreadPool used for concurrent pipeline
+   * stages and I/O pumps; its size is `CLI_THREADS` from the environment,
+   * or the number of hardware threads (at least 2) if unset. With
+   * `CLI_ZYGOTE=1` in the environment, a Zygote process is forked first and
+   * used to launch external programs.
    *
    * @exceptsafe May throw on allocation or during register_builtins.
    */
@@ -35,9 +53,29 @@ public:
   /**
    * Run the read-execute-print loop until exit or EOF.
    *
-   * For each iteration: read a line from `in`, parse it into a pipeline,
-   * execute the pipeline with the current environment, and continue. The
+   * For each iteration: read a line from `in`, compile it into an
+   * ExecutionPlan (cached per line in a PlanCache, so repeated lines are
+   * parsed once), execute it with the current environment, and continue. The
    * loop stops when the user runs the "exit" command or when `in` reaches EOF.
+   * The pipelines of a command list run one after another in this process
+   * (see Executor::execute_list).
+   *
+   * A line ending with `&` is started as a background job (the whole list,
+   * for a command list) and the loop reads the next line right away. The
+   * job gets a copy of the environment (its own assignments only change
+   * that copy), empty stdin, and `out` and `err` for its output; writes to
+   * them are locked, so jobs and the foreground can share them. When
+   * reading from std::cin, the job number is printed to `err` as "[N]", and
+   * jobs that finished since the previous line are reported there (and
+   * forgotten) before the prompt; otherwise finished jobs stay in the table
+   * for `jobs` and `wait`. Before returning, run() waits for every job that
+   * is still running.
+   *
+   * If `out` is backed by a file descriptor (see output_fd()), commands
+   * write to an OutputSink on that descriptor instead: line-buffered when
+   * it is a terminal, otherwise written when the buffer fills up and at
+   * the end of every pipeline. `CLI_OUTPUT_BUFFER=line` or `=block` forces
+   * a policy, `CLI_OUTPUT_BUFFER=0` writes to `out` as is.
    *
    * @param[in,out] in Input stream for user lines (default: std::cin).
    * @param[in,out] out Output stream for command stdout (default: std::cout).
@@ -53,14 +91,97 @@ public:
   int run(std::istream &in = std::cin, std::ostream &out = std::cout,
           std::ostream &err = std::cerr);
 
+  /**
+   * Run a whole script non-interactively (the `-c` mode of the app).
+   *
+   * Every line of `script` is compiled before anything runs, bypassing the
+   * PlanCache; if any line has a syntax error, all of them are reported to
+   * `err` as "cli: line N: ..." and nothing runs. A first line starting
+   * with `#!` is skipped. The lines then run in order as in run(), with
+   * background jobs, output buffering and `exit`, but without prompts or
+   * job notices; run_script() waits for the jobs before returning. `PATH`
+   * directories are checked by modification time rather than watched
+   * (see PathCache::set_watch), which keeps a short script cheap to exit;
+   * the previous mode is restored on return.
+   *
+   * @param[in] script Script text, lines separated by '\n'.
+   * @param[in,out] in Standard input of the commands (default: std::cin).
+   * @param[in,out] out Output stream for command stdout (default:
+   * std::cout).
+   * @param[in,out] err Output stream for errors and stderr (default:
+   * std::cerr).
+   *
+   * @returns The exit code given to `exit`, otherwise that of the last line
+   *     that ran (0 for an empty script); 2 if the script has a syntax
+   *     error.
+   *
+   * @exceptsafe Basic guarantee; streams and internal state may change on
+   * failure.
+   */
+  int run_script(std::string_view script, std::istream &in = std::cin,
+                 std::ostream &out = std::cout, std::ostream &err = std::cerr);
+
+  /**
+   * Read the script file at `path` in one go and run it with run_script().
+   *
+   * @param[in] path Script file.
+   * @param[in,out] in Standard input of the commands.
+   * @param[in,out] out Output stream for command stdout.
+   * @param[in,out] err Output stream for errors and stderr.
+   *
+   * @returns As run_script(); 127 if the file cannot be opened and 126 if
+   *     it cannot be read.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  int run_file(const std::string &path, std::istream &in = std::cin,
+               std::ostream &out = std::cout, std::ostream &err = std::cerr);
+
+  /**
+   * Replace the environment that commands run with and `$VAR` expands
+   * from (see CommandServer). Running background jobs keep their copies.
+   *
+   * @param[in] env New environment.
+   */
+  void set_environment(Environment env) { env_ = std::move(env); }
+
 private:
-  /// Register built-in commands (cat, echo, pwd, wc, grep, exit) in the registry.
+  /**
+   * Register a factory for every built-in command in the registry.
+   */
   void register_builtins();
 
-  Parser parser_;
+  /**
+   * Start `plan` (compiled from `line`) as a background job writing to the
+   * buffers of `out` and `err` through streams of its own. The foreground
+   * goes on writing to the same buffers, so they must take a lock per write
+   * (OutputSinkBuf, LockedWriteBuf).
+   *
+   * @returns The job number.
+   */
+  int start_job(const ExecutionPlan &plan, const std::string &line,
+                std::ostream &out, std::ostream &err);
+
+  /**
+   * Run `plan` (compiled from `line`): start it as a background job if it
+   * ends with `&` (printing its number to `err` if `interactive`),
+   * otherwise execute it with Executor::execute_list.
+   *
+   * @returns The result of the foreground list; exit code 0 for a job.
+   */
+  ExecutorResult run_line(const ExecutionPlan &plan, const std::string &line,
+                          std::istream &in, std::ostream &out,
+                          std::ostream &err, bool interactive);
+
+  PlanCache plans_;
   Environment env_;
+  std::unique_ptr<Zygote> zygote_;
+  std::unique_ptr<ThreadPool> pool_;
+  PathCache paths_;
   CommandRegistry registry_;
   Executor executor_;
+  /// Declared last: running jobs use the members above.
+  JobTable jobs_;
 };
 
 } // namespace cli
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "cli/command.hpp"
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -14,6 +17,10 @@ namespace cli {
  * registered, the command is executed as an external program. Typically
  * holds built-in commands such as echo, cat, pwd, wc, and exit.
  *
+ * A command can also be registered as a factory, which is called the first
+ * time the command is found; an interpreter that runs a short script then
+ * constructs only the built-ins the script uses.
+ *
  * @see Executor
  * @see Command
  */
@@ -32,6 +39,25 @@ public:
    */
   void register_command(const std::string &name, std::unique_ptr<Command> cmd);
 
+  /// Creates a command on its first lookup.
+  using Factory = std::function<std::unique_ptr<Command>()>;
+
+  /**
+   * Register a command under the given name, to be constructed by
+   * `factory` the first time find() returns it.
+   *
+   * If the name was already registered, the previous command is replaced.
+   * The factory is called at most once, under a lock, so find() may be
+   * called from several threads.
+   *
+   * @param[in] name Command name; used for lookup.
+   * @param[in] factory Function creating the command; must not be empty
+   *     and must not return null.
+   *
+   * @exceptsafe Strong guarantee; may throw on allocation.
+   */
+  void register_factory(const std::string &name, Factory factory);
+
   /**
    * Find the command registered under the given name.
    *
@@ -39,7 +65,8 @@ public:
    *
    * @returns Pointer to the registered command, or `nullptr` if not found.
    *
-   * @exceptsafe Shall not throw exceptions.
+   * @exceptsafe Shall not throw exceptions, except from the factory of a
+   * command that is constructed now.
    */
   Command *find(const std::string &name) const;
 
@@ -54,8 +81,28 @@ public:
    */
   bool has(const std::string &name) const;
 
+  /**
+   * Counter that changes whenever a command is registered or replaced.
+   *
+   * Lets holders of cached lookups (e.g. ExecutionPlan) detect that their
+   * `Command *` results may be stale.
+   *
+   * @returns The current generation.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  std::uint64_t generation() const { return generation_; }
+
 private:
-  std::unordered_map<std::string, std::unique_ptr<Command>> commands_;
+  /// A command, or the factory that has not constructed it yet.
+  struct Entry {
+    Factory factory;
+    std::once_flag constructed;
+    std::unique_ptr<Command> command;
+  };
+
+  std::unordered_map<std::string, std::unique_ptr<Entry>> commands_;
+  std::uint64_t generation_{0};
 };
 
 } // namespace cli
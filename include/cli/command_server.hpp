@@ -0,0 +1,132 @@
+#pragma once
+
+#include "cli/command_line_interpreter.hpp"
+#include <atomic>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace cli {
+
+/**
+ * Local server that runs scripts for clients in one warm interpreter.
+ *
+ * Starting the interpreter for every short script costs a process start
+ * (loading and linking the program and its C++ runtime) and building a
+ * CommandLineInterpreter again. The server keeps one interpreter and
+ * accepts requests on a Unix domain socket (`SOCK_SEQPACKET`), one request
+ * per connection. A request carries the client's working directory, its
+ * environment and either a script (`-c`) or the path of a script file, and
+ * the client's stdin, stdout and stderr as descriptors (`SCM_RIGHTS`), so
+ * commands read and write the client's own terminal, pipes or files.
+ *
+ * Every request runs in a worker process forked from the server, so it
+ * starts with the interpreter already built. The worker changes to the
+ * client's directory, replaces the interpreter's environment with the
+ * client's, runs the script with CommandLineInterpreter::run_script or
+ * run_file, replies with the exit code and exits; nothing a request does
+ * (directory, variables, cached paths) reaches the server or other
+ * requests. Requests run side by side, and one that blocks or crashes
+ * holds up or takes down only its own worker. One worker always waits in
+ * accept() ahead of the next request, so a request does not wait for a
+ * fork.
+ *
+ * Whoever may run requests can run any command as the server's user, so
+ * the socket file is created with mode 0600 and connections from processes
+ * of other users (checked with `SO_PEERCRED`) are closed unanswered.
+ *
+ * Only available on Linux; elsewhere listen() fails and call() returns -1.
+ *
+ * @see CommandLineInterpreter
+ */
+class CommandServer {
+public:
+  /// Largest request (directory, script and environment, in bytes).
+  static constexpr std::size_t kMaxRequest = 128 * 1024;
+
+  /**
+   * Create the socket at `path` and listen on it.
+   *
+   * A socket file left behind by a server that is gone is replaced; one
+   * that a server still accepts on is not. The new file is readable and
+   * writable by the owner only.
+   *
+   * @param[in] path Socket path.
+   * @param[in,out] err Stream for the reason of a failure.
+   *
+   * @returns The listening server, or null on failure.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  static std::unique_ptr<CommandServer> listen(const std::string &path,
+                                               std::ostream &err);
+
+  /// Close the socket and remove its file.
+  ~CommandServer();
+
+  CommandServer(const CommandServer &) = delete;
+  CommandServer &operator=(const CommandServer &) = delete;
+
+  /**
+   * Serve requests with `interpreter` until stop() is called.
+   *
+   * `SIGPIPE` is ignored from here on, so a client that goes away cannot
+   * take the server with it. A worker is a fork of the calling thread
+   * alone, so `interpreter` must not have started threads (background
+   * jobs, its thread pool) before the call. After stop(), waits for the
+   * requests still running.
+   *
+   * @param[in,out] interpreter Interpreter whose copy in each worker runs
+   *     the request.
+   *
+   * @returns 0 after stop(), 1 if accepting connections or forking a
+   *     worker failed.
+   *
+   * @exceptsafe Basic guarantee; errors of a single request are reported to
+   * its client.
+   */
+  int serve(CommandLineInterpreter &interpreter);
+
+  /// Make serve() stop taking requests and return. Thread-safe.
+  void stop();
+
+  /**
+   * Client side: ask the server at `path` to run a script and wait for it.
+   *
+   * The descriptors are duplicated into the server; the caller still owns
+   * its copies.
+   *
+   * @param[in] path Socket path of the server.
+   * @param[in] script_is_file Whether `script` is the path of a script
+   *     file (resolved in the caller's working directory) rather than the
+   *     script itself.
+   * @param[in] script Script text or script path.
+   * @param[in] envp Null-terminated "NAME=value" strings of the environment
+   *     the script runs with.
+   * @param[in] stdin_fd Standard input of the commands.
+   * @param[in] stdout_fd Standard output of the commands.
+   * @param[in] stderr_fd Standard error of the commands.
+   *
+   * @returns The exit code of the script; -1 if the request did not reach
+   *     a server (none running, or the request is too large), so the
+   *     script has not run; -2 if the server took the request but did not
+   *     answer (it went away, found the request malformed or refused a
+   *     caller of another user).
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  static int call(const std::string &path, bool script_is_file,
+                  const std::string &script, char *const *envp, int stdin_fd,
+                  int stdout_fd, int stderr_fd);
+
+private:
+  CommandServer(std::string path, int socket)
+      : path_(std::move(path)), socket_(socket) {}
+
+  std::string path_;
+  int socket_;
+  std::atomic<bool> stopping_{false};
+};
+
+} // namespace cli
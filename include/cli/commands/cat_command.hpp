@@ -1,6 +1,8 @@
 #pragma once
 
+#include "cli/chunked_command.hpp"
 #include "cli/command.hpp"
+#include "cli/cooperative_command.hpp"
 
 namespace cli {
 
@@ -11,9 +13,13 @@ namespace cli {
  * arguments, copies standard input to standard output (e.g. for use in pipes).
  *
  * @see Command
+ * @see ChunkedCommand
+ * @see CooperativeCommand
  * @see WcCommand
  */
-class CatCommand : public Command {
+class CatCommand : public Command,
+                   public ChunkedCommand,
+                   public CooperativeCommand {
 public:
   /**
    * Execute cat: print files or stdin to stdout.
@@ -36,6 +42,27 @@ public:
   int execute(const std::vector<std::string> &args, std::istream &in,
               std::ostream &out, std::ostream &err,
               const Environment &env) override;
+
+  /**
+   * Run cat on chunked input and output: copies input chunks, or the
+   * files read with FileByteSource, to `out`. execute() runs this through
+   * a StreamByteSource and a StreamByteSink unless `out` is fd-backed.
+   *
+   * @see ChunkedCommand::execute_chunks
+   */
+  int execute_chunks(const std::vector<std::string> &args, ByteSource &in,
+                     ByteSink &out, std::ostream &err,
+                     const Environment &env) override;
+
+  /**
+   * Run cat as a cooperative stage: forwards input chunks, or the files
+   * read in chunks, to `out`.
+   *
+   * @see CooperativeCommand::run_stage
+   */
+  StageTask run_stage(std::vector<std::string> args, StageInput &in,
+                      StageOutput &out, std::ostream &err,
+                      const Environment &env, int &exit_code) override;
 };
 
 } // namespace cli
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cli/command.hpp"
+#include "cli/cooperative_command.hpp"
 
 namespace cli {
 
@@ -11,8 +12,9 @@ namespace cli {
  * single space between them, followed by a newline. Does not read from stdin.
  *
  * @see Command
+ * @see CooperativeCommand
  */
-class EchoCommand : public Command {
+class EchoCommand : public Command, public CooperativeCommand {
 public:
   /**
    * Execute echo: print arguments to stdout.
@@ -30,6 +32,16 @@ public:
   int execute(const std::vector<std::string> &args, std::istream &in,
               std::ostream &out, std::ostream &err,
               const Environment &env) override;
+
+  /**
+   * Run echo as a cooperative stage: writes the joined arguments as one
+   * chunk and ignores its input.
+   *
+   * @see CooperativeCommand::run_stage
+   */
+  StageTask run_stage(std::vector<std::string> args, StageInput &in,
+                      StageOutput &out, std::ostream &err,
+                      const Environment &env, int &exit_code) override;
 };
 
 } // namespace cli
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cli/command.hpp"
+#include "cli/job_table.hpp"
+
+namespace cli {
+
+/**
+ * Built-in command: fg — bring a background job to the foreground.
+ *
+ * Prints the job's command line and waits for it, so its exit code becomes
+ * the status of `fg`. The job is `%N` or `N`, or the most recently started
+ * one if none is given. Jobs run on interpreter threads rather than in
+ * their own process group, so there is no terminal hand-over: the job keeps
+ * the stdin it started with.
+ *
+ * @see Command
+ * @see JobTable
+ */
+class FgCommand : public Command {
+public:
+  /**
+   * @param[in] jobs Table the job is taken from; must outlive the command.
+   */
+  explicit FgCommand(JobTable &jobs) : jobs_(jobs) {}
+
+  /**
+   * Execute fg.
+   *
+   * @param[in] args args[0] is "fg"; optional args[1] is a job reference.
+   * @param[in,out] in Not used.
+   * @param[in,out] out Where the command line of the job is written.
+   * @param[in,out] err Where errors are written.
+   * @param[in] env Not used by this command.
+   *
+   * @returns The job's exit code; 1 if there is no such job; 2 on invalid
+   *     usage.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+
+private:
+  JobTable &jobs_;
+};
+
+} // namespace cli
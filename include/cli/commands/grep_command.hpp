@@ -1,6 +1,8 @@
 #pragma once
 
+#include "cli/chunked_command.hpp"
 #include "cli/command.hpp"
+#include "cli/cooperative_command.hpp"
 
 namespace cli {
 
@@ -13,10 +15,14 @@ namespace cli {
  * line is printed at most once.
  *
  * @see Command
+ * @see ChunkedCommand
+ * @see CooperativeCommand
  * @see CatCommand
  * @see WcCommand
  */
-class GrepCommand : public Command {
+class GrepCommand : public Command,
+                    public ChunkedCommand,
+                    public CooperativeCommand {
 public:
   /**
    * Execute grep: search for pattern in files or stdin.
@@ -40,6 +46,27 @@ public:
   int execute(const std::vector<std::string> &args, std::istream &in,
               std::ostream &out, std::ostream &err,
               const Environment &env) override;
+
+  /**
+   * Run grep on chunked input and output: splits input chunks into lines
+   * in place and writes the selected lines of each chunk as one chunk.
+   * execute() runs this through a StreamByteSource and a StreamByteSink.
+   *
+   * @see ChunkedCommand::execute_chunks
+   */
+  int execute_chunks(const std::vector<std::string> &args, ByteSource &in,
+                     ByteSink &out, std::ostream &err,
+                     const Environment &env) override;
+
+  /**
+   * Run grep as a cooperative stage: splits input chunks into lines and
+   * collects matching lines into output chunks.
+   *
+   * @see CooperativeCommand::run_stage
+   */
+  StageTask run_stage(std::vector<std::string> args, StageInput &in,
+                      StageOutput &out, std::ostream &err,
+                      const Environment &env, int &exit_code) override;
 };
 
 } // namespace cli
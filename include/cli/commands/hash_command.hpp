@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cli/command.hpp"
+#include "cli/path_cache.hpp"
+
+namespace cli {
+
+/**
+ * Built-in command: hash — show or reset the remembered command locations.
+ *
+ * Without arguments, lists the PathCache as "name<TAB>path" lines sorted by
+ * name ("(not found)" for names that were looked up and not found), or
+ * "hash: hash table empty". `-r` forgets every remembered location. Any
+ * names given are looked up in `PATH` and remembered.
+ *
+ * @see Command
+ * @see PathCache
+ */
+class HashCommand : public Command {
+public:
+  /**
+   * @param[in] paths Cache shown and reset by the command; must outlive it.
+   */
+  explicit HashCommand(PathCache &paths) : paths_(paths) {}
+
+  /**
+   * Execute hash.
+   *
+   * @param[in] args args[0] is "hash"; args[1..] are `-r` and names.
+   * @param[in,out] in Not used.
+   * @param[in,out] out Where the table is listed.
+   * @param[in,out] err Where errors are written.
+   * @param[in] env Environment whose `PATH` is searched for names.
+   *
+   * @returns 0 on success; 1 if a name was not found; 2 on invalid usage.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+
+private:
+  PathCache &paths_;
+};
+
+} // namespace cli
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cli/command.hpp"
+
+namespace cli {
+
+/**
+ * Built-in command: head — print the first lines of files or stdin.
+ *
+ * Prints the first N lines (10 by default; `-n N` or `-N` to change) or,
+ * with `-c N`, the first N bytes of each file, or of standard input if no
+ * files are given or a file is "-". A count written as `-N` (`-n -N`,
+ * `-c -N`) prints all but the last N lines or bytes instead. With several
+ * files, each is preceded by a "==> name <==" header. Once it has printed
+ * enough, head signals the upstream stage via close_input() so that a
+ * streaming producer (e.g. `cat huge.log | head`) stops instead of reading
+ * its whole input.
+ *
+ * @see Command
+ * @see CatCommand
+ * @see close_input
+ */
+class HeadCommand : public Command {
+public:
+  /**
+   * Execute head: print the first lines of files or stdin.
+   *
+   * @param[in] args args[0] is "head"; args[1..] are options (`-n N`,
+   *     `-c N`, `-N`) and optional file paths.
+   * @param[in,out] in Used when no file arguments are given.
+   * @param[in,out] out Where the selected lines are written.
+   * @param[in,out] err Where error messages are written.
+   * @param[in] env Not used by this command.
+   *
+   * @returns 0 on success; 1 if any file could not be opened; 2 on invalid
+   *     usage.
+   *
+   * @exceptsafe Basic guarantee; may throw on I/O or allocation.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+};
+
+} // namespace cli
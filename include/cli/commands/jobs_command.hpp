@@ -0,0 +1,46 @@
+#pragma once
+
+#include "cli/command.hpp"
+#include "cli/job_table.hpp"
+
+namespace cli {
+
+/**
+ * Built-in command: jobs — list the background jobs.
+ *
+ * Prints one line per job in the JobTable, ordered by number, e.g.
+ * "[1] Running<TAB>grep error big.log &". Finished jobs are shown as "Done"
+ * or "Exit N" once and then forgotten.
+ *
+ * @see Command
+ * @see JobTable
+ */
+class JobsCommand : public Command {
+public:
+  /**
+   * @param[in] jobs Table listed by the command; must outlive it.
+   */
+  explicit JobsCommand(JobTable &jobs) : jobs_(jobs) {}
+
+  /**
+   * Execute jobs.
+   *
+   * @param[in] args args[0] is "jobs"; no arguments are accepted.
+   * @param[in,out] in Not used.
+   * @param[in,out] out Where the jobs are listed.
+   * @param[in,out] err Where errors are written.
+   * @param[in] env Not used by this command.
+   *
+   * @returns 0 on success; 2 on invalid usage.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+
+private:
+  JobTable &jobs_;
+};
+
+} // namespace cli
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cli/command.hpp"
+#include "cli/executor.hpp"
+#include "cli/thread_pool.hpp"
+#include <cstddef>
+
+namespace cli {
+
+/**
+ * Built-in command: parallel — run a command template once per input item,
+ * several at a time.
+ *
+ * Usage: `parallel [-j N] [-k | -u] COMMAND [ARGS...] [::: ITEMS...]`.
+ * Items are the words after `:::`, or the lines of stdin if there is no
+ * `:::`. For each item, every `{}` in COMMAND and ARGS is replaced by the
+ * item; if no word contains `{}`, the item is appended as the last
+ * argument. The resulting words are not expanded again.
+ *
+ * Up to N commands (`-j N`; default: one per pool worker) run at the same
+ * time, each on a ThreadPool task: built-ins run in-process and external
+ * programs are started through the Executor's launcher, so `PATH` lookups
+ * and the zygote are shared with ordinary pipelines. Every command gets
+ * empty stdin; its stdout and stderr are collected and written as a whole
+ * once it finishes, in input order (`-k`, the default) or in the order the
+ * commands finish (`-u`). When the reader of `out` goes away (see
+ * output_closed()), no further commands are started.
+ *
+ * @see Command
+ * @see Executor
+ */
+class ParallelCommand : public Command {
+public:
+  /**
+   * @param[in] executor Runs each command; must outlive this command.
+   * @param[in] pool Pool the commands run on; if null, each of the N
+   *     runners gets its own thread (see run_concurrently).
+   */
+  ParallelCommand(Executor &executor, ThreadPool *pool)
+      : executor_(executor), pool_(pool) {}
+
+  /**
+   * Execute parallel.
+   *
+   * @param[in] args args[0] is "parallel"; then options, the command
+   *     template, and optionally `:::` followed by the items.
+   * @param[in,out] in Items, one per line, when there is no `:::`.
+   * @param[in,out] out Where the commands' stdout is written.
+   * @param[in,out] err Where the commands' stderr and errors are written.
+   * @param[in] env Environment the commands run with.
+   *
+   * @returns 0 if every command succeeded; otherwise the number of failed
+   *     commands, at most 101; 255 on invalid usage.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation or stream failure.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+
+private:
+  /// Number of commands run at the same time when `-j` is not given.
+  std::size_t default_jobs() const;
+
+  Executor &executor_;
+  ThreadPool *pool_;
+};
+
+} // namespace cli
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Running line, word and byte counts of `wc`.
+ *
+ * Input may arrive in any chunking: a word split across two add() calls is
+ * counted once.
+ *
+ * @see WcCommand
+ */
+struct WcCounts {
+  unsigned long lines{0};
+  unsigned long words{0};
+  unsigned long bytes{0};
+  bool in_word{false};
+
+  /// Count `n` bytes at `data`.
+  void add(const char *data, std::size_t n);
+
+  /// Count the bytes of `text`.
+  void add(std::string_view text) { add(text.data(), text.size()); }
+
+  /**
+   * Output line in the format used by wc.
+   *
+   * @param[in] path File name appended after the counts; may be empty.
+   *
+   * @returns " lines words bytes[ path]\n".
+   */
+  std::string format(const std::string &path) const;
+};
+
+/// Parsed `grep` command line.
+struct GrepOptions {
+  std::regex re;
+  /// The pattern if it has no regex metacharacters (and no -i/-w), so a
+  /// plain substring search gives the same result as `re`.
+  std::optional<std::string> literal;
+  std::size_t after_context{0};
+  std::vector<std::string> files;
+};
+
+/**
+ * Parse grep arguments and compile the pattern.
+ *
+ * @param[in] args args[0] is "grep"; args[1..] are options and operands.
+ * @param[in,out] err Where usage and regex errors are written.
+ *
+ * @returns The options, or std::nullopt on invalid usage or an invalid
+ *     regex (grep exits with code 2).
+ *
+ * @exceptsafe Basic guarantee; may throw on allocation.
+ */
+std::optional<GrepOptions> parse_grep_options(
+    const std::vector<std::string> &args, std::ostream &err);
+
+/**
+ * Decides line by line what grep prints: each matching line and up to
+ * `after_context` lines after it, each line at most once.
+ *
+ * @see GrepCommand
+ */
+class LineSelector {
+public:
+  /**
+   * @param[in] options Pattern and context; must outlive the selector.
+   */
+  explicit LineSelector(const GrepOptions &options) : options_(options) {}
+
+  /// Returns true if `line` (without its newline) is to be printed.
+  bool select(std::string_view line);
+
+  /// True if any line so far matched.
+  bool matched() const { return matched_; }
+
+  /**
+   * Text that every selected line contains, when lines without it need not
+   * be passed to select() at all: a literal pattern and no context.
+   *
+   * @returns The literal, or null if every line has to be seen.
+   */
+  const std::string *needle() const {
+    const bool usable = options_.literal && !options_.literal->empty() &&
+                        options_.literal->find('\n') == std::string::npos &&
+                        options_.after_context == 0;
+    return usable ? &*options_.literal : nullptr;
+  }
+
+private:
+  const GrepOptions &options_;
+  std::size_t to_print_{0};
+  bool matched_{false};
+};
+
+/**
+ * Splits a byte stream that arrives in chunks into lines the way
+ * `std::getline` does: lines end at '\n', and a non-empty last line
+ * without a newline is a line too.
+ *
+ * Complete lines inside a chunk are passed on without copying; only a line
+ * that spans chunks is assembled in an internal buffer.
+ */
+class LineSplitter {
+public:
+  /**
+   * Split the next chunk of input.
+   *
+   * @param[in] data Chunk contents.
+   * @param[in] n Chunk size.
+   * @param[in] on_line Called with each complete line, without '\n'.
+   */
+  template <typename OnLine>
+  void feed(const char *data, std::size_t n, OnLine &&on_line) {
+    std::string_view chunk(data, n);
+    std::size_t start = 0;
+    std::size_t newline;
+    while ((newline = chunk.find('\n', start)) != std::string_view::npos) {
+      if (partial_.empty()) {
+        on_line(chunk.substr(start, newline - start));
+      } else {
+        partial_.append(chunk, start, newline - start);
+        on_line(std::string_view(partial_));
+        partial_.clear();
+      }
+      start = newline + 1;
+    }
+    partial_.append(chunk, start, std::string_view::npos);
+  }
+
+  /**
+   * Split the next chunk of input for `selector`: like feed(), but when the
+   * selector has a needle(), the chunk is searched for it and only lines
+   * that contain it are passed on, so lines that cannot be selected cost
+   * no per-line work.
+   *
+   * @param[in] selector Selector the lines are for.
+   * @param[in] data Chunk contents.
+   * @param[in] n Chunk size.
+   * @param[in] on_line Called with each candidate line, without '\n'.
+   */
+  template <typename OnLine>
+  void feed(const LineSelector &selector, const char *data, std::size_t n,
+            OnLine &&on_line) {
+    const std::string *needle = selector.needle();
+    if (!needle) {
+      feed(data, n, on_line);
+      return;
+    }
+    std::string_view chunk(data, n);
+    std::size_t start = 0;
+    if (!partial_.empty()) {
+      const std::size_t newline = chunk.find('\n');
+      if (newline == std::string_view::npos) {
+        partial_.append(chunk);
+        return;
+      }
+      partial_.append(chunk, 0, newline);
+      if (partial_.find(*needle) != std::string::npos)
+        on_line(std::string_view(partial_));
+      partial_.clear();
+      start = newline + 1;
+    }
+    std::size_t hit;
+    while ((hit = chunk.find(*needle, start)) != std::string_view::npos) {
+      // The needle has no '\n', so the hit lies inside one line.
+      const std::size_t end = chunk.find('\n', hit);
+      if (end == std::string_view::npos)
+        break; // in the unterminated last line, kept below
+      const std::size_t newline = chunk.rfind('\n', hit);
+      const std::size_t begin =
+          newline == std::string_view::npos || newline < start ? start
+                                                               : newline + 1;
+      on_line(chunk.substr(begin, end - begin));
+      start = end + 1;
+    }
+    const std::size_t last = chunk.rfind('\n');
+    if (last != std::string_view::npos && last >= start)
+      start = last + 1;
+    partial_.append(chunk, start, std::string_view::npos);
+  }
+
+  /**
+   * End of input: pass on the unterminated last line, if any.
+   *
+   * @param[in] on_line Called with the last line if it is not empty.
+   */
+  template <typename OnLine> void finish(OnLine &&on_line) {
+    if (!partial_.empty())
+      on_line(std::string_view(partial_));
+    partial_.clear();
+  }
+
+private:
+  std::string partial_;
+};
+
+} // namespace cli
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cli/command.hpp"
+#include "cli/job_table.hpp"
+
+namespace cli {
+
+/**
+ * Built-in command: wait — wait for background jobs to finish.
+ *
+ * Without arguments, waits for every job and returns 0. Otherwise waits for
+ * each job given as `%N` or `N` and returns the exit code of the last one.
+ *
+ * @see Command
+ * @see JobTable
+ */
+class WaitCommand : public Command {
+public:
+  /**
+   * @param[in] jobs Table whose jobs are waited for; must outlive the
+   *     command.
+   */
+  explicit WaitCommand(JobTable &jobs) : jobs_(jobs) {}
+
+  /**
+   * Execute wait.
+   *
+   * @param[in] args args[0] is "wait"; args[1..] are job references.
+   * @param[in,out] in Not used.
+   * @param[in,out] out Not used.
+   * @param[in,out] err Where errors are written.
+   * @param[in] env Not used by this command.
+   *
+   * @returns 0 after waiting for every job; otherwise the exit code of the
+   *     last job given, or 127 if it does not exist.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  int execute(const std::vector<std::string> &args, std::istream &in,
+              std::ostream &out, std::ostream &err,
+              const Environment &env) override;
+
+private:
+  JobTable &jobs_;
+};
+
+} // namespace cli
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "cli/chunked_command.hpp"
 #include "cli/command.hpp"
+#include "cli/cooperative_command.hpp"
 
 namespace cli {
 
@@ -11,9 +13,13 @@ namespace cli {
  * number of lines, words, and bytes. Words are separated by whitespace.
  *
  * @see Command
+ * @see ChunkedCommand
+ * @see CooperativeCommand
  * @see CatCommand
  */
-class WcCommand : public Command {
+class WcCommand : public Command,
+                  public ChunkedCommand,
+                  public CooperativeCommand {
 public:
   /**
    * Execute wc: count lines, words, and bytes for files or stdin.
@@ -35,6 +41,26 @@ public:
   int execute(const std::vector<std::string> &args, std::istream &in,
               std::ostream &out, std::ostream &err,
               const Environment &env) override;
+
+  /**
+   * Run wc on chunked input and output: counts input chunks in place.
+   * execute() runs this through a StreamByteSource and a StreamByteSink.
+   *
+   * @see ChunkedCommand::execute_chunks
+   */
+  int execute_chunks(const std::vector<std::string> &args, ByteSource &in,
+                     ByteSink &out, std::ostream &err,
+                     const Environment &env) override;
+
+  /**
+   * Run wc as a cooperative stage: counts input chunks as they arrive and
+   * writes the totals at end of input.
+   *
+   * @see CooperativeCommand::run_stage
+   */
+  StageTask run_stage(std::vector<std::string> args, StageInput &in,
+                      StageOutput &out, std::ostream &err,
+                      const Environment &env, int &exit_code) override;
 };
 
 } // namespace cli
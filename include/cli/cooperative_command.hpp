@@ -0,0 +1,53 @@
+#pragma once
+
+#include "cli/coroutine_scheduler.hpp"
+#include "cli/environment.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Optional interface of built-ins that can run as a cooperative stage.
+ *
+ * A cooperative stage is a coroutine that reads its input in chunks and
+ * writes its output in chunks, suspending when the next input chunk is not
+ * there yet or the downstream queue is full. The Executor runs pipelines
+ * made only of such built-ins on one thread with a CoroutineScheduler
+ * (`CLI_PIPELINE=cooperative`), without threads and without buffering a
+ * whole intermediate result.
+ *
+ * The output of run_stage() must match Command::execute() for the same
+ * arguments and input.
+ *
+ * @see CoroutineScheduler
+ * @see Executor
+ */
+class CooperativeCommand {
+public:
+  virtual ~CooperativeCommand() = default;
+
+  /**
+   * Create the coroutine that runs the command as a pipeline stage.
+   *
+   * The coroutine is created suspended. The caller keeps `in`, `out`,
+   * `err`, `env` and `exit_code` alive until it has finished; closing `in`
+   * and `out` afterwards is also up to the caller.
+   *
+   * @param[in] args Command name (args[0]) and arguments; copied into the
+   *     coroutine.
+   * @param[in,out] in Input chunks of the stage.
+   * @param[in,out] out Where output chunks are written.
+   * @param[in,out] err Standard error stream.
+   * @param[in] env Current environment.
+   * @param[out] exit_code Set to the command's exit code before it finishes.
+   *
+   * @returns The suspended stage coroutine.
+   */
+  virtual StageTask run_stage(std::vector<std::string> args, StageInput &in,
+                              StageOutput &out, std::ostream &err,
+                              const Environment &env, int &exit_code) = 0;
+};
+
+} // namespace cli
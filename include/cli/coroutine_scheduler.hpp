@@ -0,0 +1,262 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Coroutine type of a cooperative pipeline stage.
+ *
+ * Lazily started: the body runs only once a CoroutineScheduler resumes it or
+ * another StageTask awaits it. Awaiting a StageTask runs it to completion
+ * and then resumes the awaiter (exceptions are rethrown there).
+ *
+ * @see CoroutineScheduler
+ * @see CooperativeCommand
+ */
+class StageTask {
+public:
+  struct promise_type {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    StageTask get_return_object() {
+      return StageTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          if (h.promise().continuation)
+            return h.promise().continuation;
+          return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  StageTask(StageTask &&other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  StageTask &operator=(StageTask &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  StageTask(const StageTask &) = delete;
+  StageTask &operator=(const StageTask &) = delete;
+  ~StageTask() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  /// True once the coroutine body has finished.
+  bool done() const { return !handle_ || handle_.done(); }
+
+  /// Rethrow the exception that escaped the body, if any.
+  void rethrow_if_failed() const {
+    if (handle_ && handle_.promise().exception)
+      std::rethrow_exception(handle_.promise().exception);
+  }
+
+  /// Handle used by the scheduler to resume the task.
+  std::coroutine_handle<> handle() const { return handle_; }
+
+  bool await_ready() const noexcept { return done(); }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  void await_resume() const { rethrow_if_failed(); }
+
+private:
+  explicit StageTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * Single-threaded round-robin scheduler for StageTask coroutines.
+ *
+ * Keeps a queue of ready coroutines and resumes them one at a time on the
+ * calling thread. Coroutines put themselves back in the queue indirectly:
+ * a ChunkPipe schedules a waiting reader when data arrives and a waiting
+ * writer when space frees up.
+ */
+class CoroutineScheduler {
+public:
+  /// Take ownership of a task and make it ready to run.
+  void spawn(StageTask task);
+
+  /// Make a suspended coroutine ready to run.
+  void schedule(std::coroutine_handle<> handle);
+
+  /**
+   * Resume ready coroutines until none is left.
+   *
+   * @returns True if every spawned task finished; false if some are still
+   *     suspended with nothing left to wake them (a deadlock).
+   *
+   * @throws Rethrows the first exception that escaped a spawned task.
+   */
+  bool run();
+
+  /// Number of coroutine resumptions performed by run() so far.
+  std::size_t switches() const { return switches_; }
+
+private:
+  std::deque<std::coroutine_handle<>> ready_;
+  std::vector<StageTask> tasks_;
+  std::size_t switches_{0};
+};
+
+/**
+ * Bounded queue of byte chunks between two coroutine stages.
+ *
+ * `co_await push(chunk)` suspends the writer while `capacity` chunks are
+ * queued; `co_await pop()` suspends the reader while the queue is empty.
+ * There is no locking: both ends must run on the same CoroutineScheduler.
+ */
+class ChunkPipe {
+public:
+  /// Default number of queued chunks.
+  static constexpr std::size_t kDefaultCapacity = 4;
+
+  /**
+   * @param[in] scheduler Scheduler that runs both ends; must outlive the
+   *     pipe.
+   * @param[in] capacity Maximum number of queued chunks; 0 is treated as 1.
+   */
+  explicit ChunkPipe(CoroutineScheduler &scheduler,
+                     std::size_t capacity = kDefaultCapacity);
+
+  struct PushAwaiter {
+    ChunkPipe &pipe;
+    std::string chunk;
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    /// @returns False if the reader is gone and the chunk was dropped.
+    bool await_resume();
+  };
+
+  struct PopAwaiter {
+    ChunkPipe &pipe;
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    /// @returns The next chunk, or std::nullopt at end of data.
+    std::optional<std::string> await_resume();
+  };
+
+  /// Awaitable that queues `chunk`, suspending while the pipe is full.
+  PushAwaiter push(std::string chunk) { return {*this, std::move(chunk)}; }
+
+  /// Awaitable that takes the next chunk, suspending while the pipe is empty.
+  PopAwaiter pop() { return {*this}; }
+
+  /// Mark the end of data and wake a waiting reader.
+  void close_write();
+
+  /// Mark that the reader is gone, drop queued chunks, wake the writer.
+  void close_read();
+
+  /// True once close_read() has been called.
+  bool read_closed() const { return read_closed_; }
+
+private:
+  void wake(std::coroutine_handle<> &waiter);
+
+  CoroutineScheduler &scheduler_;
+  std::size_t capacity_;
+  std::deque<std::string> chunks_;
+  std::coroutine_handle<> waiting_reader_;
+  std::coroutine_handle<> waiting_writer_;
+  bool write_closed_{false};
+  bool read_closed_{false};
+};
+
+/**
+ * Input end of a cooperative stage: a ChunkPipe or a plain `std::istream`.
+ *
+ * The first stage of a pipeline reads the interpreter's input stream
+ * directly (reads never suspend); later stages read from a ChunkPipe.
+ */
+class StageInput {
+public:
+  /// Preferred chunk size when reading from a stream.
+  static constexpr std::size_t kChunkSize = 16 * 1024;
+
+  explicit StageInput(ChunkPipe &pipe) : pipe_(&pipe) {}
+  explicit StageInput(std::istream &in) : stream_(&in) {}
+
+  struct NextAwaiter {
+    StageInput &input;
+    std::optional<ChunkPipe::PopAwaiter> pop;
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    std::optional<std::string> await_resume();
+  };
+
+  /// Awaitable yielding the next chunk, or std::nullopt at end of data.
+  NextAwaiter next();
+
+  /// Tell the producer that no more input will be read.
+  void close();
+
+private:
+  ChunkPipe *pipe_{nullptr};
+  std::istream *stream_{nullptr};
+};
+
+/**
+ * Output end of a cooperative stage: a ChunkPipe or a plain `std::ostream`.
+ */
+class StageOutput {
+public:
+  explicit StageOutput(ChunkPipe &pipe) : pipe_(&pipe) {}
+  explicit StageOutput(std::ostream &out) : stream_(&out) {}
+
+  struct WriteAwaiter {
+    StageOutput &output;
+    std::optional<ChunkPipe::PushAwaiter> push;
+    std::string chunk;
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    /// @returns False if the consumer has finished.
+    bool await_resume();
+  };
+
+  /// Awaitable that hands `chunk` to the consumer.
+  WriteAwaiter write(std::string chunk);
+
+  /// True once the consumer has finished (see output_closed()).
+  bool closed() const;
+
+  /// Mark the end of this stage's output.
+  void close();
+
+private:
+  ChunkPipe *pipe_{nullptr};
+  std::ostream *stream_{nullptr};
+};
+
+} // namespace cli
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -11,11 +13,17 @@ namespace cli {
  *
  * Holds a key-value map of variable names to values. Used for variable
  * substitution in command lines and for building the environment block
- * passed to external processes.
+ * passed to external processes. The block for `execve` (see envp()) is kept
+ * up to date by set() and unset(), so starting a child costs no
+ * environment work however many variables there are.
  */
 class Environment {
 public:
   Environment();
+  Environment(const Environment &other);
+  Environment &operator=(const Environment &other);
+  Environment(Environment &&) noexcept = default;
+  Environment &operator=(Environment &&) noexcept = default;
 
   /**
    * Initialize environment from the current process environment.
@@ -92,8 +100,93 @@ public:
    */
   std::vector<std::string> to_env_vector() const;
 
+  /**
+   * Environment block in the form expected by `execve` and `posix_spawn`.
+   *
+   * One "key=value" string per variable, in no particular order, followed
+   * by a null pointer. The block is maintained incrementally by set() and
+   * unset(): each of them rewrites or moves at most one entry.
+   *
+   * @returns The block; valid until the environment is next modified.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  char *const *envp() const { return envp_.data(); }
+
+  /// Number of variables.
+  std::size_t size() const { return vars_.size(); }
+
+private:
+  /// A variable's value and the index of its "key=value" entry in envp_.
+  struct Var {
+    std::string value;
+    std::size_t slot;
+  };
+
+  /// Make room for `count` more variables without rehashing.
+  void reserve(std::size_t count);
+
+  /** Makes envp_[slot] point to a new "name=value" string. */
+  void write_entry(std::size_t slot, const std::string &name,
+                   const std::string &value);
+
+  std::unordered_map<std::string, Var> vars_;
+  // envp_[i] points into entries_[i] and belongs to the variable named
+  // *slot_names_[i] (a key of vars_); the last element of envp_ is null.
+  std::vector<std::unique_ptr<char[]>> entries_;
+  std::vector<const std::string *> slot_names_;
+  std::vector<char *> envp_{nullptr};
+};
+
+/**
+ * A word split once into literal text and variable references.
+ *
+ * expand() gives the same result as Environment::substitute() on the
+ * original word but does not scan it again, so words that are run many
+ * times (e.g. in a cached ExecutionPlan) are parsed only once.
+ *
+ * @see Environment::substitute
+ */
+class SubstitutionTemplate {
+public:
+  SubstitutionTemplate() = default;
+
+  /**
+   * Split `text` into segments.
+   *
+   * @param[in] text Word that may contain `$VAR` or `${VAR}` patterns.
+   * @param[in] substitute If false, the whole word is kept literally (e.g.
+   *     single-quoted text).
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit SubstitutionTemplate(const std::string &text,
+                                bool substitute = true);
+
+  /**
+   * Build the word for the current variable values.
+   *
+   * @param[in] env Environment to read variables from.
+   *
+   * @returns The expanded word.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  std::string expand(const Environment &env) const;
+
+  /// True if the word contains no variable references.
+  bool is_literal() const;
+
+  /// Text of a literal word; empty if the word references variables.
+  std::string literal() const;
+
 private:
-  std::unordered_map<std::string, std::string> vars_;
+  struct Segment {
+    std::string text;
+    bool variable{false};
+  };
+
+  std::vector<Segment> segments_;
 };
 
 } // namespace cli
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "cli/ast.hpp"
+#include "cli/command.hpp"
+#include "cli/command_registry.hpp"
+#include "cli/environment.hpp"
+#include "cli/path_cache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cli {
+
+/**
+ * A pipeline stage ready to run: expanded arguments and what runs them.
+ *
+ * Exactly one of `builtin` and `executable` is meaningful: a built-in if
+ * `builtin` is set, otherwise an external program at `executable`.
+ */
+struct BoundStage {
+  /// Command name (args[0]) and arguments after substitution.
+  std::vector<std::string> args;
+  /// Built-in that runs the stage, or null for an external program.
+  Command *builtin{nullptr};
+  /// Resolved program path of an external stage.
+  std::string executable;
+};
+
+/**
+ * One command line compiled for repeated execution.
+ *
+ * Holds what the front end (Parser, assignment stripping) produced for a
+ * line, with every word pre-split into a SubstitutionTemplate. The command
+ * of each stage whose name contains no variables is resolved once -- to a
+ * built-in `Command *` or to an executable path -- and remembered until the
+ * CommandRegistry generation or the `PATH` value changes, or the PathCache
+ * used for lookups drops its results. Names that reference variables are
+ * resolved on every run.
+ *
+ * @see PlanCache
+ * @see Executor
+ */
+class ExecutionPlan {
+public:
+  /// A leading `NAME=value` word of the line.
+  struct Assignment {
+    std::string name;
+    SubstitutionTemplate value;
+  };
+
+  /// One stage of the pipeline.
+  struct Stage {
+    SubstitutionTemplate name;
+    std::vector<SubstitutionTemplate> args;
+  };
+
+  /// A later pipeline of a command list (see rest()).
+  struct ListStep;
+
+  /**
+   * Compile a parsed pipeline as is (no assignment stripping).
+   *
+   * @param[in] pipeline Parsed pipeline.
+   *
+   * @returns Plan with one stage per CommandNode.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  static ExecutionPlan from_pipeline(const Pipeline &pipeline);
+
+  /**
+   * Compile a source line the way the interactive interpreter runs it.
+   *
+   * Parses `line`, moves leading `NAME=value` words of the first command to
+   * assignments() and drops leading stages left without a name. A trailing
+   * `&` sets background(); a leading unquoted `time` word (before any
+   * assignments) is removed and sets timed().
+   *
+   * A command list (see Parser::parse_list) compiles its first pipeline
+   * into this plan and each later one, the same way, into rest(). An empty
+   * pipeline other than one after the last `;` makes the line invalid: the
+   * plan then has nothing but a syntax_error().
+   *
+   * @param[in] line Source line.
+   *
+   * @returns The compiled plan; empty for an empty line.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  static ExecutionPlan compile(const std::string &line);
+
+  /// Assignments to apply, in order, before the pipeline runs.
+  const std::vector<Assignment> &assignments() const { return assignments_; }
+
+  /// Pipeline stages; empty if the line only assigns variables.
+  const std::vector<Stage> &stages() const { return stages_; }
+
+  /// Whether the line ended with `&` and runs as a background job.
+  bool background() const { return background_; }
+
+  /// Whether the line was prefixed with `time`; Executor then reports the
+  /// resources each stage used.
+  bool timed() const { return timed_; }
+
+  /// Pipelines of a command list after the first one, in order; empty for
+  /// a single pipeline. Executor::execute_list runs them.
+  const std::vector<ListStep> &rest() const { return rest_; }
+
+  /// Why the line could not be compiled, or empty if it could.
+  const std::string &syntax_error() const { return syntax_error_; }
+
+  /**
+   * Apply assignments() to `env`, in order.
+   *
+   * @param[in,out] env Environment to update.
+   */
+  void apply_assignments(Environment &env) const;
+
+  /**
+   * Expand and resolve every stage for one run.
+   *
+   * Resolution of literal command names is cached in the plan and redone
+   * only when `registry.generation()`, the `PATH` value in `env` or the
+   * generation of `paths` (see PathCache::validate) differs from the
+   * previous call.
+   *
+   * @param[in] registry Registry of built-ins.
+   * @param[in] env Environment for substitution and `PATH` lookup.
+   * @param[in] paths Cache for `PATH` lookups; if null, every lookup
+   *     searches `PATH` (ExternalCommand::resolve).
+   *
+   * @returns One BoundStage per stage, or std::nullopt if some stage has an
+   *     empty name after substitution.
+   *
+   * @exceptsafe Basic guarantee. Not thread-safe: updates the cached
+   *     resolution.
+   */
+  std::optional<std::vector<BoundStage>>
+  bind(const CommandRegistry &registry, const Environment &env,
+       PathCache *paths = nullptr) const;
+
+private:
+  struct Resolution {
+    Command *builtin{nullptr};
+    std::string executable;
+  };
+
+  static ExecutionPlan compile_pipeline(Pipeline &pipeline);
+
+  void refresh_resolutions(const CommandRegistry &registry,
+                           const Environment &env, PathCache *paths) const;
+
+  std::vector<Assignment> assignments_;
+  std::vector<Stage> stages_;
+  std::vector<ListStep> rest_;
+  std::string syntax_error_;
+  bool background_{false};
+  bool timed_{false};
+
+  // Cached resolution of literal stage names, valid for the stamp below.
+  mutable std::vector<std::optional<Resolution>> resolved_;
+  mutable std::uint64_t resolved_generation_{0};
+  mutable std::string resolved_path_;
+  mutable std::uint64_t resolved_path_generation_{0};
+  mutable bool resolved_valid_{false};
+};
+
+struct ExecutionPlan::ListStep {
+  /// Operator before the pipeline.
+  ListOperator op;
+  /// The pipeline, with its own assignments() and timed().
+  ExecutionPlan plan;
+};
+
+/**
+ * Least-recently-used cache of ExecutionPlan objects keyed by source line.
+ *
+ * Lets a script that repeats the same lines skip parsing and template
+ * splitting. Cached plans revalidate their command resolution on their own
+ * (see ExecutionPlan::bind), so entries never have to be evicted for
+ * correctness.
+ */
+class PlanCache {
+public:
+  /// Default number of cached lines.
+  static constexpr std::size_t kDefaultCapacity = 256;
+
+  /**
+   * @param[in] capacity Maximum number of cached plans; 0 disables caching.
+   */
+  explicit PlanCache(std::size_t capacity = kDefaultCapacity);
+
+  /**
+   * Get the plan for `line`, compiling and caching it on a miss.
+   *
+   * @param[in] line Source line.
+   *
+   * @returns The plan; valid until the next call.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  const ExecutionPlan &get(const std::string &line);
+
+  /// Number of cached plans.
+  std::size_t size() const { return entries_.size(); }
+
+  /// Number of get() calls answered from the cache.
+  std::size_t hits() const { return hits_; }
+
+  /// Drop all cached plans.
+  void clear();
+
+private:
+  using Entry = std::pair<std::string, ExecutionPlan>;
+
+  std::size_t capacity_;
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  ExecutionPlan uncached_;
+  std::size_t hits_{0};
+};
+
+} // namespace cli
@@ -2,10 +2,17 @@
 
 #include "cli/ast.hpp"
 #include "cli/command_registry.hpp"
+#include "cli/cooperative_command.hpp"
 #include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
 #include "cli/external_command.hpp"
+#include "cli/path_cache.hpp"
+#include "cli/stage_stats.hpp"
+#include "cli/thread_pool.hpp"
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace cli {
 
@@ -14,13 +21,15 @@ namespace cli {
  *
  * When a built-in exit command runs, `should_exit` is true and `exit_code`
  * holds the requested code. Otherwise, `exit_code` is the exit code of the
- * last command in the pipeline.
+ * last command in the pipeline. `stages` tells what each stage cost.
  */
 struct ExecutorResult {
   /// True if the interpreter should exit (e.g. user ran "exit").
   bool should_exit{false};
   /// Exit code to report (last command's code, or exit argument).
   int exit_code{0};
+  /// Resources used by the stages that ran, in pipeline order.
+  std::vector<StageStats> stages;
 };
 
 /**
@@ -91,6 +100,22 @@ public:
    * code is that of the last command; if any command requests exit (e.g.
    * built-in exit), the result has `should_exit` set.
    *
+   * If no stage is a registered built-in, the whole pipeline is handed to
+   * ExternalCommand::execute_pipeline, which connects the programs with kernel
+   * pipes. Chains of built-ins with a known shape (such as
+   * `cat FILE | grep X | wc`) run as one fused single-pass operator (see
+   * run_fused_pipeline()) unless `CLI_FUSION=0`. Otherwise, by default stages
+   * run one after another and each intermediate result is buffered in full in a
+   * SpillBuffer, which keeps up to `CLI_STAGE_BUFFER_LIMIT` bytes (64 MiB if
+   * unset) in memory and moves the rest to an unlinked temp file; with
+   * `CLI_SPILL_DEBUG` set, spilled bytes and peak RSS are reported to `err`.
+   * When `env` has `CLI_PIPELINE=streaming`, all stages run at the same time on
+   * their own threads, joined by bounded PipeChannel instances of
+   * `CLI_PIPE_CAPACITY` bytes (64 KiB if unset). With
+   * `CLI_PIPELINE=cooperative`, a pipeline made only of CooperativeCommand
+   * built-ins runs as coroutines on the calling thread (see
+   * execute_cooperative()); other pipelines fall back to the default mode.
+   *
    * @param[in] pipeline Parsed sequence of commands to execute.
    * @param[in,out] in Standard input for the first command.
    * @param[in,out] out Standard output (and input for next command in a pipe).
@@ -98,7 +123,8 @@ public:
    * @param[in] env Environment for variable substitution and external
    * processes.
    *
-   * @returns Result with exit code and whether the REPL should exit.
+   * @returns Result with exit code, whether the REPL should exit, and what
+   *     each stage cost (see StageStats).
    *
    * @throws ExitRequest Optionally, when the user runs the exit command.
    *
@@ -109,27 +135,110 @@ public:
                          std::ostream &out, std::ostream &err,
                          const Environment &env);
 
-private:
   /**
-   * Expand a command node's name and arguments using the environment.
+   * Execute a compiled pipeline.
+   *
+   * Same as execute(const Pipeline &, ...), but words are expanded from the
+   * plan's pre-split templates and command resolution cached in the plan is
+   * reused (see ExecutionPlan::bind). Assignments of the plan are not
+   * applied here. `out` is flushed once the pipeline has finished, which
+   * is when a block-buffered OutputSink writes what the pipeline printed.
+   * If the line was prefixed with `time` (see ExecutionPlan::timed), a
+   * per-stage report (print_stage_stats()) is written to `err` after that.
+   *
+   * @param[in] plan Compiled command line.
+   * @param[in,out] in Standard input for the first command.
+   * @param[in,out] out Standard output of the last command.
+   * @param[in,out] err Standard error stream.
+   * @param[in] env Environment for variable substitution and external
+   * processes.
    *
-   * Applies substitution only where Substitute::Yes is set; fills args_out
-   * with the final list of strings for execute_one.
+   * @returns Result with exit code, whether the REPL should exit, and what
+   *     each stage cost (see StageStats).
    *
-   * @param[in] node AST node (name, args, substitute flags).
-   * @param[in] env Environment for variable expansion.
-   * @param[out] args_out Output vector of expanded command name and arguments.
+   * @exceptsafe Basic guarantee; streams and process state may change on
+   * failure.
    */
-  static void expand_node(const CommandNode &node, const Environment &env,
-                         std::vector<std::string> &args_out);
+  ExecutorResult execute(const ExecutionPlan &plan, std::istream &in,
+                         std::ostream &out, std::ostream &err,
+                         const Environment &env);
 
   /**
-   * Run a single command with already-expanded arguments.
+   * Execute a compiled line the way the interpreter runs it: the plan's
+   * pipeline and then, for a command list, each pipeline of
+   * ExecutionPlan::rest() that its `&&` or `||` lets run.
+   *
+   * Before a pipeline runs, its assignments are applied to `env`, so later
+   * pipelines of the list see them; a pipeline of assignments alone has
+   * status 0. Every pipeline runs through execute(const ExecutionPlan &,
+   * ...) in this process, reading the rest of `in`. The list stops early
+   * once a pipeline requests exit. A plan with a syntax error is reported
+   * to `err` and nothing runs.
+   *
+   * @param[in] plan Compiled command line.
+   * @param[in,out] in Standard input shared by the pipelines.
+   * @param[in,out] out Standard output shared by the pipelines.
+   * @param[in,out] err Standard error stream.
+   * @param[in,out] env Environment to update and expand words from.
    *
-   * Used internally by execute(Pipeline) after expand_node. Looks up the
-   * command in the registry or runs it as external.
+   * @returns Result of the last pipeline that ran; exit code 2 for a
+   *     syntax error.
    *
-   * @param[in] args Command name (args[0]) and arguments (args[1..]).
+   * @exceptsafe Basic guarantee; streams, `env` and process state may
+   * change on failure.
+   */
+  ExecutorResult execute_list(const ExecutionPlan &plan, std::istream &in,
+                              std::ostream &out, std::ostream &err,
+                              Environment &env);
+
+  /**
+   * Run concurrent pipeline stages and I/O pumps of external commands on
+   * `pool` instead of creating a thread for each of them.
+   *
+   * @param[in] pool Interpreter-wide pool; may be null (threads are
+   *     created per use). Must outlive the executor.
+   */
+  void set_thread_pool(ThreadPool *pool);
+
+  /**
+   * Launch external programs through `zygote` (see
+   * ExternalCommand::set_zygote).
+   *
+   * @param[in] zygote Launcher process; may be null. Must outlive the
+   *     executor.
+   */
+  void set_zygote(Zygote *zygote) { external_.set_zygote(zygote); }
+
+  /**
+   * Look up external programs through `paths` instead of searching `PATH`
+   * for every command.
+   *
+   * @param[in] paths Interpreter-wide cache; may be null. Must outlive the
+   *     executor.
+   */
+  void set_path_cache(PathCache *paths) { paths_ = paths; }
+
+private:
+  /**
+   * Run bound stages in the mode execute() describes.
+   *
+   * @param[in] stages Bound stages (at least one).
+   * @param[in,out] in Standard input for the first stage.
+   * @param[in,out] out Standard output of the last stage.
+   * @param[in,out] err Standard error shared by all stages.
+   * @param[in] env Environment for external commands.
+   *
+   * @returns Result of the pipeline, with one StageStats per stage (or per
+   *     group of stages run together).
+   */
+  ExecutorResult execute_stages(const std::vector<BoundStage> &stages,
+                                std::istream &in, std::ostream &out,
+                                std::ostream &err, const Environment &env);
+
+  /**
+   * Run a single bound stage: its built-in, or its external program.
+   *
+   * @param[in] stage Expanded arguments and resolved command.
    * @param[in,out] in Standard input.
    * @param[in,out] out Standard output.
    * @param[in,out] err Standard error.
@@ -137,12 +246,76 @@ private:
    *
    * @returns Result with exit code and should_exit flag.
    */
-  ExecutorResult execute_one(const std::vector<std::string> &args,
+  ExecutorResult execute_one(const BoundStage &stage,
                              std::istream &in, std::ostream &out,
                              std::ostream &err, const Environment &env);
 
+  /**
+   * Run expanded pipeline stages one after another through SpillBuffer.
+   *
+   * @param[in] stages Bound stages (at least two).
+   * @param[in,out] in Standard input for the first stage.
+   * @param[in,out] out Standard output of the last stage.
+   * @param[in,out] err Standard error shared by all stages.
+   * @param[in] env Environment for external commands.
+   *
+   * @returns Result of the last stage, or of the stage that requested exit.
+   */
+  ExecutorResult
+  execute_sequential(const std::vector<BoundStage> &stages,
+                     std::istream &in, std::ostream &out, std::ostream &err,
+                     const Environment &env);
+
+  /**
+   * Run expanded pipeline stages concurrently, joined by PipeChannel.
+   *
+   * Every stage except the last runs concurrently (on the thread pool if
+   * one is set, otherwise on its own thread); the last one runs on the
+   * calling thread. When a stage finishes, its output channel is closed
+   * for writing and its input channel for reading, so neighbours see EOF or
+   * a failing output stream instead of blocking forever.
+   *
+   * @param[in] stages Bound stages (at least two).
+   * @param[in,out] in Standard input for the first stage.
+   * @param[in,out] out Standard output of the last stage.
+   * @param[in,out] err Standard error shared (with locking) by all stages.
+   * @param[in] env Environment for external commands.
+   *
+   * @returns Result of the last stage; `should_exit` is set if any stage
+   *     requested exit.
+   */
+  ExecutorResult
+  execute_streaming(const std::vector<BoundStage> &stages,
+                    std::istream &in, std::ostream &out, std::ostream &err,
+                    const Environment &env);
+
+  /**
+   * Run a pipeline of cooperative built-ins as coroutines on one thread.
+   *
+   * Stages are joined by ChunkPipe queues and multiplexed by a
+   * CoroutineScheduler: a stage suspends when its input queue is empty or
+   * its output queue is full. When a stage finishes, its output queue is
+   * closed for writing and its input queue for reading.
+   *
+   * @param[in] commands Cooperative implementation of each stage.
+   * @param[in] stages Bound stages (at least two).
+   * @param[in,out] in Standard input for the first stage.
+   * @param[in,out] out Standard output of the last stage.
+   * @param[in,out] err Standard error shared by all stages.
+   * @param[in] env Environment passed to the stages.
+   *
+   * @returns Result of the last stage.
+   */
+  ExecutorResult
+  execute_cooperative(const std::vector<CooperativeCommand *> &commands,
+                      const std::vector<BoundStage> &stages,
+                      std::istream &in, std::ostream &out, std::ostream &err,
+                      const Environment &env);
+
   CommandRegistry &registry_;
   ExternalCommand external_;
+  ThreadPool *pool_{nullptr};
+  PathCache *paths_{nullptr};
 };
 
 } // namespace cli
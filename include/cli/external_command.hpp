@@ -1,6 +1,11 @@
 #pragma once
 
 #include "cli/command.hpp"
+#include "cli/stage_stats.hpp"
+#include "cli/thread_pool.hpp"
+#include "cli/zygote.hpp"
+#include <string>
+#include <vector>
 
 namespace cli {
 
@@ -8,12 +13,19 @@ namespace cli {
  * Run an external program by name with given arguments and environment.
  *
  * Spawns a child process: on Windows uses CreateProcess; on POSIX uses
- * fork/exec. Standard input is fed from the given stream; stdout and stderr
- * of the child are captured to the given streams. The exit code is that of
- * the child process (e.g. 127 if the program was not found).
+ * posix_spawn, whose cost does not grow with the interpreter's RSS the way
+ * fork's page-table copy does (`CLI_LAUNCHER=fork` in the environment
+ * selects fork/exec instead). Standard input is fed from the given stream;
+ * stdout and stderr of the child are captured to the given streams. On
+ * POSIX a stream that is backed by a real descriptor (`std::cout`,
+ * `std::cerr`, `std::cin` on a terminal, an FdStreamBuf; see input_fd() and
+ * output_fd()) is given to the child as that descriptor, so interactive
+ * programs see the terminal and their output costs the interpreter no
+ * copying. The exit code is that of the child process (e.g. 127 if the
+ * program was not found).
  *
  * @see Command
- * @see Environment::to_env_vector
+ * @see Environment::envp
  */
 class ExternalCommand : public Command {
 public:
@@ -29,8 +41,8 @@ public:
    * @param[in,out] in Standard input for the child process.
    * @param[in,out] out Standard output from the child process.
    * @param[in,out] err Standard error from the child process.
-   * @param[in] env Environment for the child (e.g. via
-   * Environment::to_env_vector).
+   * @param[in] env Environment for the child (Environment::envp on POSIX,
+   * Environment::to_env_vector on Windows).
    *
    * @returns Exit code of the child process (0 on success; 127 if command
    *     not found; other values as returned by the program).
@@ -40,6 +52,109 @@ public:
   int execute(const std::vector<std::string> &args, std::istream &in,
               std::ostream &out, std::ostream &err,
               const Environment &env) override;
+
+  /**
+   * Run the program at `program_path` with arguments `args`.
+   *
+   * Same as execute(), but `args[0]` is not looked up in `PATH`; it is only
+   * passed to the program as its name and used in error messages.
+   *
+   * @param[in] program_path Program to run (see resolve()).
+   * @param[in] args Program name (args[0]) and arguments (args[1..]).
+   * @param[in,out] in Standard input for the child process.
+   * @param[in,out] out Standard output from the child process.
+   * @param[in,out] err Standard error from the child process.
+   * @param[in] env Environment for the child.
+   * @param[out] stats If not null, receives the name, exit code, wall time
+   *     and (on POSIX) resource usage of the program (see StageStats).
+   *
+   * @returns Exit code of the child process, as for execute().
+   *
+   * @exceptsafe Basic guarantee; may throw on fork/exec or stream failure.
+   */
+  int execute_resolved(const std::string &program_path,
+                       const std::vector<std::string> &args, std::istream &in,
+                       std::ostream &out, std::ostream &err,
+                       const Environment &env, StageStats *stats = nullptr);
+
+  /**
+   * Find the program that runs for `name`.
+   *
+   * Names containing a path separator are returned unchanged; other names
+   * are searched in the directories of `PATH` from `env`.
+   *
+   * @param[in] env Environment providing `PATH`.
+   * @param[in] name Command name.
+   *
+   * @returns Path of the executable, or `name` if none was found (running
+   *     it then fails with exit code 127).
+   */
+  static std::string resolve(const Environment &env, const std::string &name);
+
+  /**
+   * Execute a pipeline in which every stage is an external program.
+   *
+   * On POSIX, all stages are started up front and connected directly with
+   * `pipe(2)`, so data between stages never passes through the interpreter
+   * and all programs run concurrently. The parent only feeds `in` to the
+   * first stage, copies the last stage's stdout to `out`, forwards the
+   * shared stderr of all stages to `err`, and waits for the children. On
+   * Windows the stages are chained through memory buffers instead.
+   *
+   * @param[in] stages Program name and arguments of each stage, in order;
+   *     each element has the same layout as `args` of execute().
+   * @param[in,out] in Standard input for the first stage.
+   * @param[in,out] out Standard output of the last stage.
+   * @param[in,out] err Standard error of all stages.
+   * @param[in] env Environment for every child.
+   * @param[in] paths Already resolved program of each stage (see
+   *     resolve()); stages without an entry are resolved here.
+   * @param[out] stats If not null, receives one StageStats per stage (the
+   *     wall time of a stage runs from its start until it is reaped); left
+   *     with default entries if the stages could not all be started.
+   *
+   * @returns Exit code of the last stage (127 if it was not found); 0 for
+   *     an empty pipeline; 1 if pipes or processes could not be created.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation or stream failure.
+   */
+  int execute_pipeline(const std::vector<std::vector<std::string>> &stages,
+                       std::istream &in, std::ostream &out, std::ostream &err,
+                       const Environment &env,
+                       const std::vector<std::string> &paths = {},
+                       std::vector<StageStats> *stats = nullptr);
+
+  /**
+   * Use `pool` for the helper tasks that feed stdin to children and drain
+   * their output; without a pool a thread is created per helper.
+   *
+   * @param[in] pool Interpreter-wide pool; may be null. Must outlive this
+   *     command.
+   */
+  void set_thread_pool(ThreadPool *pool) { pool_ = pool; }
+
+  /**
+   * Launch programs through `zygote` instead of starting them from the
+   * interpreter.
+   *
+   * If the zygote cannot take a request (it has exited, or argv and
+   * environment are too large), the program is started directly as usual.
+   *
+   * @param[in] zygote Launcher process; may be null. Must outlive this
+   *     command.
+   */
+  void set_zygote(Zygote *zygote) { zygote_ = zygote; }
+
+private:
+  /// execute_resolved() without the bookkeeping; `stats` receives the
+  /// child's resource usage and stdin/stdout byte counts on POSIX.
+  int run_resolved(const std::string &program_path,
+                   const std::vector<std::string> &args, std::istream &in,
+                   std::ostream &out, std::ostream &err,
+                   const Environment &env, StageStats &stats);
+
+  ThreadPool *pool_{nullptr};
+  Zygote *zygote_{nullptr};
 };
 
 } // namespace cli
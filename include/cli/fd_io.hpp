@@ -0,0 +1,343 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+
+namespace cli {
+
+/**
+ * Stream buffer that reads from and writes to a raw file descriptor.
+ *
+ * Lets a `std::istream`/`std::ostream` be backed by an fd so that the
+ * executor can recognise it (see input_fd() and output_fd()) and move data
+ * with kernel-side copies instead of going through the stream.
+ */
+class FdStreamBuf : public std::streambuf {
+public:
+  /**
+   * Wrap a file descriptor.
+   *
+   * @param[in] fd Open file descriptor.
+   * @param[in] owns_fd If true, the descriptor is closed by the destructor.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit FdStreamBuf(int fd, bool owns_fd = false);
+  ~FdStreamBuf() override;
+
+  FdStreamBuf(const FdStreamBuf &) = delete;
+  FdStreamBuf &operator=(const FdStreamBuf &) = delete;
+
+  /// Underlying file descriptor.
+  int fd() const { return fd_; }
+
+  /// Number of bytes already read from the fd but not yet consumed.
+  std::streamsize buffered_input() const { return egptr() - gptr(); }
+
+protected:
+  int_type underflow() override;
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  bool flush_output();
+
+  int fd_;
+  bool owns_fd_;
+  // Left uninitialised: pages a short-lived stream never reaches are never
+  // touched.
+  std::unique_ptr<char[]> in_buf_;
+  std::unique_ptr<char[]> out_buf_;
+};
+
+/// When an OutputSinkBuf hands its bytes to the descriptor.
+enum class FlushPolicy {
+  /// After every write that contains a newline (terminals).
+  Line,
+  /// Only when the buffer is full or on an explicit flush (files, pipes).
+  Block,
+};
+
+/**
+ * Output stream buffer of the interpreter's own stdout.
+ *
+ * `std::cout` goes through stdio one `<<` at a time and writes in chunks of
+ * a few KiB, so a built-in that prints millions of short lines spends most
+ * of its time in the stream layer and in `write(2)`. The sink collects
+ * output in one large buffer and writes it according to its FlushPolicy:
+ * line by line for a terminal, so prompts and results show up at once, and
+ * only when the buffer fills up or on `flush()` otherwise. The Executor
+ * flushes its output at the end of every pipeline.
+ *
+ * Thread-safe: background jobs and `parallel` write to the same stdout, so
+ * every write takes a lock (the put area is kept empty for that reason).
+ * A failed write (e.g. EPIPE) makes further writes fail, which sets
+ * `badbit` on the owning stream and so output_closed().
+ *
+ * @see OutputSink
+ */
+class OutputSinkBuf : public std::streambuf {
+public:
+  /// Default buffer size.
+  static constexpr std::size_t kDefaultCapacity = 256 * 1024;
+
+  /**
+   * Wrap a file descriptor; it is not closed by the destructor.
+   *
+   * @param[in] fd Open file descriptor.
+   * @param[in] policy When to write buffered bytes.
+   * @param[in] capacity Buffer size; 0 is treated as 1.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  OutputSinkBuf(int fd, FlushPolicy policy,
+                std::size_t capacity = kDefaultCapacity);
+  ~OutputSinkBuf() override;
+
+  OutputSinkBuf(const OutputSinkBuf &) = delete;
+  OutputSinkBuf &operator=(const OutputSinkBuf &) = delete;
+
+  /// Underlying file descriptor.
+  int fd() const { return fd_; }
+
+  /// When buffered bytes are written.
+  FlushPolicy policy() const { return policy_; }
+
+  /// Number of `write(2)` calls made so far.
+  std::uint64_t write_calls() const;
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  bool append_locked(const char *s, std::size_t n);
+  bool flush_locked();
+  bool write_locked(const char *s, std::size_t n);
+
+  mutable std::mutex mutex_;
+  int fd_;
+  FlushPolicy policy_;
+  std::size_t capacity_;
+  // Uninitialised, like FdStreamBuf's buffers.
+  std::unique_ptr<char[]> buffer_;
+  std::size_t size_{0};
+  std::uint64_t write_calls_{0};
+  bool failed_{false};
+};
+
+/**
+ * `std::ostream` over an OutputSinkBuf.
+ *
+ * @see CommandLineInterpreter::run
+ */
+class OutputSink : public std::ostream {
+public:
+  /**
+   * @param[in] fd Open file descriptor; not closed by the sink.
+   * @param[in] policy When to write buffered bytes.
+   * @param[in] capacity Buffer size.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  OutputSink(int fd, FlushPolicy policy,
+             std::size_t capacity = OutputSinkBuf::kDefaultCapacity);
+
+  /// Line for a terminal, Block for anything else.
+  static FlushPolicy policy_for(int fd);
+
+  /// The buffer behind the stream.
+  OutputSinkBuf &sink() { return buf_; }
+
+private:
+  OutputSinkBuf buf_;
+};
+
+/**
+ * Input stream buffer that reads through another buffer and counts the
+ * bytes taken from it.
+ *
+ * Has no get area of its own, so it never takes more from the source than
+ * the reader consumes (a reader of `std::cin` leaves the rest of the line
+ * buffer to the interpreter). The Executor wraps the stdin of every
+ * built-in stage in one to fill StageStats::bytes_in. input_fd(),
+ * close_input() and StreamByteSource look through it to the source; a
+ * reader that then bypasses it reports what it read with count_input().
+ *
+ * @see CountingWriteBuf
+ */
+class CountingReadBuf : public std::streambuf {
+public:
+  /**
+   * @param[in,out] source Buffer to read from; must outlive this one.
+   */
+  explicit CountingReadBuf(std::streambuf *source) : source_(source) {}
+
+  /// Buffer the bytes come from.
+  std::streambuf *source() const { return source_; }
+
+  /// Bytes read so far.
+  std::uint64_t count() const { return count_; }
+
+  /// Add bytes read from the source by other means.
+  void add(std::uint64_t n) { count_ += n; }
+
+protected:
+  int_type underflow() override;
+  int_type uflow() override;
+  std::streamsize xsgetn(char *s, std::streamsize n) override;
+  std::streamsize showmanyc() override;
+
+private:
+  std::streambuf *source_;
+  std::uint64_t count_{0};
+};
+
+/**
+ * Output stream buffer that writes through to another buffer and counts
+ * the bytes it accepts.
+ *
+ * Unbuffered, so nothing is held back from the sink. The Executor wraps
+ * the stdout of every built-in stage in one to fill StageStats::bytes_out;
+ * output_fd() and output_closed() look through it, and a writer that then
+ * uses the descriptor directly reports what it wrote with count_output().
+ *
+ * @see CountingReadBuf
+ */
+class CountingWriteBuf : public std::streambuf {
+public:
+  /**
+   * @param[in,out] sink Buffer to write to; must outlive this one.
+   */
+  explicit CountingWriteBuf(std::streambuf *sink) : sink_(sink) {}
+
+  /// Buffer the bytes go to.
+  std::streambuf *sink() const { return sink_; }
+
+  /// Bytes written so far.
+  std::uint64_t count() const { return count_; }
+
+  /// Add bytes written to the sink by other means.
+  void add(std::uint64_t n) { count_ += n; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  std::streambuf *sink_;
+  std::uint64_t count_{0};
+};
+
+/**
+ * Output stream buffer that writes through to another buffer under a lock.
+ *
+ * Lets several threads share one output whose buffer is not thread-safe
+ * (e.g. a background job and the foreground writing to the interpreter's
+ * stderr): each thread writes through an `std::ostream` of its own over
+ * the same LockedWriteBuf, since the stream objects themselves cannot be
+ * shared. Unbuffered, so writes keep their order across threads; a single
+ * write is never interleaved with another. output_fd() and output_closed()
+ * look through it.
+ *
+ * @see OutputSinkBuf
+ */
+class LockedWriteBuf : public std::streambuf {
+public:
+  /**
+   * @param[in,out] sink Buffer to write to; must outlive this one.
+   */
+  explicit LockedWriteBuf(std::streambuf *sink) : sink_(sink) {}
+
+  /// Buffer the bytes go to.
+  std::streambuf *sink() const { return sink_; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  std::mutex mutex_;
+  std::streambuf *sink_;
+};
+
+/// Buffer `in` reads from, looking through a CountingReadBuf.
+std::streambuf *source_buf(std::istream &in);
+
+/// Buffer `out` writes to, looking through a CountingWriteBuf and a
+/// LockedWriteBuf.
+std::streambuf *sink_buf(std::ostream &out);
+
+/// Count `n` bytes read from the source of `in` without going through
+/// `in` (no-op unless `in` reads through a CountingReadBuf).
+void count_input(std::istream &in, std::uint64_t n);
+
+/// Count `n` bytes written to the sink of `out` without going through
+/// `out` (no-op unless `out` writes through a CountingWriteBuf).
+void count_output(std::ostream &out, std::uint64_t n);
+
+/**
+ * Return the file descriptor behind an output stream, flushing it first.
+ *
+ * Recognises `std::cout`, `std::cerr` and `std::clog` (by their original
+ * buffers, so a stream redirected with `rdbuf()` is not mistaken for fd 1
+ * or 2) and streams whose buffer is an FdStreamBuf or an OutputSinkBuf,
+ * also behind a CountingWriteBuf or a LockedWriteBuf. Pending stream (and
+ * stdio) data is flushed so bytes written directly to the descriptor
+ * afterwards keep their order.
+ *
+ * @param[in,out] out Stream to inspect.
+ *
+ * @returns The descriptor, or -1 if the stream is not fd-backed (or on
+ *     Windows).
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+int output_fd(std::ostream &out);
+
+/**
+ * Return the file descriptor behind an input stream.
+ *
+ * Recognises streams whose buffer (or the source of their CountingReadBuf)
+ * is an FdStreamBuf with no bytes buffered, and `std::cin` (with its
+ * original buffer) when standard input is a terminal. A terminal delivers
+ * one line per read, so once the interpreter has consumed its line stdio
+ * holds no read-ahead; from a pipe or file stdio may already have buffered
+ * data that a direct read from fd 0 would skip, so `std::cin` is not
+ * recognised then.
+ *
+ * @param[in] in Stream to inspect.
+ *
+ * @returns The descriptor, or -1 if the stream is not fd-backed.
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+int input_fd(std::istream &in);
+
+/**
+ * Move all bytes from one descriptor to another until EOF on `in_fd`.
+ *
+ * On Linux uses `splice(2)` when either side is a pipe and `sendfile(2)`
+ * when the source is a regular file, so the data is not copied through user
+ * space. Falls back to a `read`/`write` loop with a large buffer when the
+ * kernel refuses (e.g. for terminals) or on other platforms.
+ *
+ * @param[in] in_fd Source descriptor.
+ * @param[in] out_fd Destination descriptor.
+ *
+ * @returns Number of bytes transferred, or -1 on a read/write error (EPIPE
+ *     on the destination is treated as the consumer being done and is not
+ *     an error).
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+std::int64_t transfer_fd(int in_fd, int out_fd);
+
+} // namespace cli
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Moves data between a child process's stdio pipes and the interpreter's
+ * streams from a single thread.
+ *
+ * The pump waits with `poll(2)` on the write end of the child's stdin and
+ * the read ends of its stdout and stderr (all switched to non-blocking
+ * mode) and services whichever is ready. A child that writes heavily to
+ * stderr while the interpreter is still collecting its stdout, or that
+ * only reads more input after its output has been taken, keeps running
+ * instead of blocking on a full pipe.
+ *
+ * The buffers are allocated once and reused by every run(), so a pump is
+ * meant to be kept per thread (see ExternalCommand). POSIX only; on Windows
+ * run() does nothing.
+ *
+ * @see ExternalCommand
+ */
+class IoPump {
+public:
+  /// Size of the stdin buffer and of the stdout/stderr read buffer.
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  /**
+   * @exceptsafe May throw on allocation.
+   */
+  IoPump();
+
+  /**
+   * Pump until stdout and stderr reach EOF and the input is used up (or the
+   * child stopped reading it).
+   *
+   * Every descriptor passed in is closed by the time run() returns; the
+   * child's stdin is closed as soon as `in` is exhausted, so the child sees
+   * EOF. When the child closes its stdin early, the producer of `in` is
+   * told via close_input(); once `out` or `err` reports output_closed(),
+   * the corresponding pipe is closed so the child gets EPIPE.
+   *
+   * @param[in,out] in Source of the child's stdin; must satisfy
+   *     can_pump_input(). Ignored if `stdin_fd` is -1.
+   * @param[in] stdin_fd Write end of the child's stdin pipe, or -1 if the
+   *     caller feeds stdin by other means.
+   * @param[in] stdout_fd Read end of the child's stdout pipe, or -1.
+   * @param[in,out] out Destination of the child's stdout.
+   * @param[in] stderr_fd Read end of the child's stderr pipe, or -1.
+   * @param[in,out] err Destination of the child's stderr.
+   *
+   * @exceptsafe Basic guarantee; may throw on stream failure.
+   */
+  void run(std::istream &in, int stdin_fd, int stdout_fd, std::ostream &out,
+           int stderr_fd, std::ostream &err);
+
+  /**
+   * Whether reading `in` can never block the pump: it is fd-backed (see
+   * input_fd(), the descriptor is polled like the pipes) or held in memory
+   * (a `std::stringbuf`). Other streams, such as `std::cin` or a
+   * PipeChannel of a streaming pipeline, have to be fed by another thread.
+   *
+   * @param[in] in Stream to inspect.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  static bool can_pump_input(std::istream &in);
+
+  /// Bytes the last run() wrote to the child's stdin.
+  std::uint64_t bytes_in() const { return bytes_in_; }
+
+  /// Bytes the last run() took from the child's stdout.
+  std::uint64_t bytes_out() const { return bytes_out_; }
+
+private:
+  std::vector<char> in_buf_;
+  std::vector<char> out_buf_;
+  std::uint64_t bytes_in_{0};
+  std::uint64_t bytes_out_{0};
+};
+
+} // namespace cli
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "cli/thread_pool.hpp"
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Background jobs of the interpreter: command lines started with a trailing
+ * `&`.
+ *
+ * Each job runs on its own ThreadPool::spawn() task, so any number of jobs
+ * run at the same time as each other and as the foreground pipeline. A job
+ * reaps the external programs it started itself (waitpid() on their pids,
+ * like a foreground pipeline), and the table learns that the job finished
+ * from the job's task, which wakes wait() through a condition variable;
+ * nothing polls for finished children, and no process-wide SIGCHLD handler
+ * competes with the pipelines' own waitpid() calls.
+ *
+ * Jobs are numbered from 1; the number is reused once every job has been
+ * waited for or reported. The destructor waits for jobs that are still
+ * running.
+ *
+ * Thread-safe.
+ *
+ * @see JobsCommand
+ * @see WaitCommand
+ * @see FgCommand
+ */
+class JobTable {
+public:
+  /// What is known about a job.
+  struct Status {
+    int id{0};
+    /// Command line as typed (with the `&`).
+    std::string command;
+    bool done{false};
+    /// Exit code; meaningful once done.
+    int exit_code{0};
+  };
+
+  JobTable() = default;
+  ~JobTable();
+
+  JobTable(const JobTable &) = delete;
+  JobTable &operator=(const JobTable &) = delete;
+
+  /**
+   * Start a job.
+   *
+   * @param[in] command Command line, shown by list().
+   * @param[in] body Runs the job and returns its exit code; called on
+   *     another thread. An exception escaping it ends the job with exit
+   *     code 1.
+   * @param[in] pool Pool to spawn the job on; if null, a new thread is
+   *     used (see run_concurrently).
+   *
+   * @returns The job number.
+   *
+   * @exceptsafe Strong guarantee; may throw on allocation.
+   */
+  int start(std::string command, std::function<int()> body, ThreadPool *pool);
+
+  /**
+   * Every job, ordered by number.
+   *
+   * @param[in] forget_finished Drop the finished jobs from the table after
+   *     listing them (the `jobs` builtin reports a finished job once).
+   */
+  std::vector<Status> list(bool forget_finished = false);
+
+  /**
+   * Finished jobs that nobody has waited for, ordered by number; they are
+   * dropped from the table.
+   */
+  std::vector<Status> take_finished();
+
+  /**
+   * Block until job `id` has finished and drop it from the table.
+   *
+   * @param[in] id Job number.
+   *
+   * @returns The job's exit code, or std::nullopt if there is no such job.
+   */
+  std::optional<int> wait(int id);
+
+  /// Block until every job has finished, and drop them all.
+  void wait_all();
+
+  /// Number of the most recently started job, or std::nullopt if none.
+  std::optional<int> current() const;
+
+  /**
+   * Parse a job reference: `%N` or `N`.
+   *
+   * @param[in] spec Argument of `wait` or `fg`.
+   *
+   * @returns The job number, or std::nullopt if `spec` is not a number.
+   */
+  static std::optional<int> parse_spec(const std::string &spec);
+
+  /**
+   * One line about a job as `jobs` prints it, e.g. "[2] Exit 1<TAB>grep x
+   * log &" (without the newline). The state is "Running", "Done" or
+   * "Exit N".
+   */
+  static std::string describe(const Status &status);
+
+private:
+  struct Job {
+    Status status;
+    TaskHandle task;
+  };
+
+  mutable std::mutex mutex_;
+  std::condition_variable finished_;
+  std::map<int, std::unique_ptr<Job>> jobs_;
+};
+
+} // namespace cli
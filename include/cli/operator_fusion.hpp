@@ -0,0 +1,57 @@
+#pragma once
+
+#include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Check whether pipelines may be replaced by fused operators.
+ *
+ * Fusion is on unless `CLI_FUSION=0`, which lets the regular stage-by-stage
+ * execution be compared against the fused one. It is also off while
+ * `CLI_SPILL_DEBUG` is set, since fused pipelines have no stage buffers to
+ * report on.
+ *
+ * @param[in] env Current environment.
+ *
+ * @returns True if Executor may call run_fused_pipeline().
+ */
+bool fusion_enabled(const Environment &env);
+
+/**
+ * Run a pipeline of built-ins as one single-pass operator, if its shape is
+ * known.
+ *
+ * Recognised shapes, where the last `wc` has no file arguments and the
+ * middle `grep` has no file arguments:
+ * - `cat [FILE...] | wc` counts the files (or `in`) directly;
+ * - `grep OPTIONS PATTERN [FILE...] | wc` counts the lines grep would print
+ *   without building them;
+ * - `cat [FILE...] | grep OPTIONS PATTERN | wc` does both in one pass.
+ *
+ * Stages are matched by the type of their built-in (CatCommand,
+ * GrepCommand, WcCommand), not by name. Output, error messages and the exit
+ * code are the same as for the unfused pipeline. A pipeline whose grep
+ * arguments are invalid is not fused, so the regular path reports the
+ * error.
+ *
+ * @param[in] stages Bound stages of the pipeline.
+ * @param[in,out] in Standard input of the first stage.
+ * @param[in,out] out Standard output of the last stage.
+ * @param[in,out] err Standard error shared by all stages.
+ *
+ * @returns Exit code of the pipeline, or std::nullopt if the shape is not
+ *     recognised and nothing was run.
+ *
+ * @exceptsafe Basic guarantee; may throw on I/O or allocation.
+ */
+std::optional<int> run_fused_pipeline(const std::vector<BoundStage> &stages,
+                                      std::istream &in, std::ostream &out,
+                                      std::ostream &err);
+
+} // namespace cli
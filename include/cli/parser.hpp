@@ -35,6 +35,43 @@ public:
    * @exceptsafe Shall not throw exceptions.
    */
   static std::optional<Pipeline> parse(const std::string &line);
+
+  /**
+   * Parse a line that may ask to run in the background.
+   *
+   * Like parse(), except that a trailing `&` outside quotes (and not part of
+   * `&&`) is removed before parsing and reported through `background`.
+   *
+   * @param[in] line Raw input line from the user.
+   * @param[out] background Set to whether the line ended with `&`.
+   *
+   * @returns The parsed pipeline, or `std::nullopt` if nothing but
+   *     whitespace (and the `&`) is left.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  static std::optional<Pipeline> parse(const std::string &line,
+                                       bool &background);
+
+  /**
+   * Parse a line into a command list.
+   *
+   * Splits the line at `;`, `&&` and `||` outside quotes and parses each
+   * part with parse(). A part with nothing but whitespace becomes an item
+   * with an empty pipeline, which the caller reports as a syntax error
+   * unless it follows the last `;`. A trailing `&` is handled as in
+   * parse(const std::string &, bool &) and applies to the whole list.
+   *
+   * @param[in] line Raw input line from the user.
+   * @param[out] background Set to whether the line ended with `&`.
+   *
+   * @returns The parsed list (at least one item), or `std::nullopt` if
+   *     nothing but whitespace (and the `&`) is left.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  static std::optional<CommandList> parse_list(const std::string &line,
+                                               bool &background);
 };
 
 } // namespace cli
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "cli/environment.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Remembered `PATH` lookups: command name to executable path, like the hash
+ * table of bash.
+ *
+ * ExternalCommand::resolve() stats candidate files in every `PATH` entry
+ * until one matches, which for a long `PATH` and a script that runs many
+ * commands adds up to a lot of system calls. The cache keeps each result,
+ * including "not found", and throws all of them away when
+ *
+ * - the `PATH` value differs from the previous lookup,
+ * - a `PATH` directory changed, or
+ * - clear() is called (the `hash -r` builtin).
+ *
+ * On Linux directories are watched with inotify (entries added, removed or
+ * renamed, or their permissions changed), so checking for changes costs one
+ * non-blocking read() per lookup. Directories that cannot be watched (e.g.
+ * ones that do not exist yet), and every directory on other platforms, are
+ * checked by comparing their modification time, which does not see a
+ * `chmod` of a program; `hash -r` covers that.
+ *
+ * Thread-safe.
+ *
+ * @see ExternalCommand::resolve
+ * @see HashCommand
+ */
+class PathCache {
+public:
+  PathCache();
+  ~PathCache();
+
+  PathCache(const PathCache &) = delete;
+  PathCache &operator=(const PathCache &) = delete;
+
+  /**
+   * Look up `name` like ExternalCommand::resolve(), answering from the
+   * cache when possible.
+   *
+   * Names containing '/' are returned as is and not cached.
+   *
+   * @param[in] env Environment whose `PATH` is searched.
+   * @param[in] name Command name.
+   *
+   * @returns Path of the executable, or `name` if none was found.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  std::string resolve(const Environment &env, const std::string &name);
+
+  /**
+   * Drop cached results that may be out of date for `env` (see the class
+   * description) and return the generation.
+   *
+   * The generation changes every time cached results are dropped, so a
+   * caller that keeps its own copies of resolved paths (ExecutionPlan) can
+   * tell when to look them up again.
+   *
+   * @param[in] env Environment whose `PATH` is checked.
+   *
+   * @returns The current generation.
+   *
+   * @exceptsafe Basic guarantee; may throw on allocation.
+   */
+  std::uint64_t validate(const Environment &env);
+
+  /// Forget every cached result.
+  void clear();
+
+  /**
+   * Choose how `PATH` directories are checked for changes: with inotify
+   * (the default; Linux only) or, with `watch` false, by modification time
+   * only.
+   *
+   * Closing an inotify descriptor that has watches takes milliseconds,
+   * since the kernel waits for a grace period, and a short-lived process
+   * pays that at exit. Cached results are dropped when the mode changes.
+   *
+   * @param[in] watch Whether to watch directories with inotify.
+   */
+  void set_watch(bool watch);
+
+  /// Whether directories are watched with inotify (see set_watch()).
+  bool watch() const;
+
+  /**
+   * Cached results sorted by name.
+   *
+   * @returns Pairs of command name and executable path; the path is empty
+   *     for names that were not found.
+   */
+  std::vector<std::pair<std::string, std::string>> entries() const;
+
+private:
+  /// A `PATH` entry checked by modification time.
+  struct PolledDir {
+    std::string path;
+    std::filesystem::file_time_type mtime;
+    bool exists{false};
+  };
+
+  void validate_locked(const Environment &env);
+  void watch_dirs();
+  bool dirs_changed();
+  void drop_entries();
+
+  mutable std::mutex mutex_;
+  std::string path_value_;
+  bool initialized_{false};
+  std::uint64_t generation_{0};
+  /// Name to path; empty path for a name that was not found.
+  std::unordered_map<std::string, std::string> entries_;
+  std::vector<PolledDir> polled_;
+  bool watch_{true};
+  int inotify_fd_{-1};
+};
+
+} // namespace cli
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Bounded in-memory byte channel between two concurrently running stages.
+ *
+ * One producer writes bytes, one consumer reads them. The channel never holds
+ * more than `capacity` bytes: a writer blocks while the channel is full and a
+ * reader blocks while it is empty and the writer has not closed its end.
+ * Peak memory of a streaming pipeline therefore depends on the capacity, not
+ * on the amount of data that flows through it.
+ *
+ * @see ChannelReadBuf
+ * @see ChannelWriteBuf
+ * @see Executor
+ */
+class PipeChannel {
+public:
+  /// Default capacity in bytes used when none is configured.
+  static constexpr std::size_t kDefaultCapacity = 64 * 1024;
+
+  /**
+   * Construct an empty channel.
+   *
+   * @param[in] capacity Maximum number of buffered bytes; 0 is treated as 1.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit PipeChannel(std::size_t capacity = kDefaultCapacity);
+
+  /**
+   * Write bytes, blocking while the channel is full.
+   *
+   * @param[in] data Bytes to write.
+   * @param[in] n Number of bytes.
+   *
+   * @returns Number of bytes accepted; less than `n` only if the reader has
+   *     closed its end (the rest is discarded).
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  std::size_t write(const char *data, std::size_t n);
+
+  /**
+   * Read up to `n` bytes, blocking while the channel is empty.
+   *
+   * @param[out] data Destination buffer.
+   * @param[in] n Size of the destination buffer.
+   *
+   * @returns Number of bytes read; 0 means end of data (writer closed and
+   *     channel drained).
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  std::size_t read(char *data, std::size_t n);
+
+  /// Mark the end of data; readers see EOF once the buffer is drained.
+  void close_write();
+
+  /// Mark that the reader is gone; pending and future writes are discarded.
+  void close_read();
+
+  /// True once close_read() has been called.
+  bool read_closed() const { return read_closed_; }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::vector<char> buffer_;
+  std::size_t head_{0};
+  std::size_t size_{0};
+  bool write_closed_{false};
+  std::atomic<bool> read_closed_{false};
+};
+
+/**
+ * Input stream buffer that pulls bytes from a PipeChannel.
+ *
+ * Lets an unmodified Command read from a channel through `std::istream`.
+ */
+class ChannelReadBuf : public std::streambuf {
+public:
+  /**
+   * @param[in] channel Channel to read from; must outlive this buffer.
+   */
+  explicit ChannelReadBuf(PipeChannel &channel);
+
+  /// Channel this buffer reads from.
+  PipeChannel &channel() { return channel_; }
+
+protected:
+  int_type underflow() override;
+
+private:
+  PipeChannel &channel_;
+  std::vector<char> buffer_;
+};
+
+/**
+ * Output stream buffer that pushes bytes into a PipeChannel.
+ *
+ * Small writes are collected locally and handed to the channel on overflow,
+ * on `sync()` or from `close()`. Once the reader has closed the channel,
+ * writes fail, which sets `badbit` on the owning `std::ostream`.
+ */
+class ChannelWriteBuf : public std::streambuf {
+public:
+  /**
+   * @param[in] channel Channel to write to; must outlive this buffer.
+   */
+  explicit ChannelWriteBuf(PipeChannel &channel);
+
+  /// Flush buffered bytes and close the write end of the channel.
+  void close();
+
+  /// Channel this buffer writes to.
+  PipeChannel &channel() { return channel_; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  bool flush_buffer();
+
+  PipeChannel &channel_;
+  std::vector<char> buffer_;
+  bool failed_{false};
+};
+
+/**
+ * Tell whoever feeds `in` that no more input will be read.
+ *
+ * This is the downstream-closed signal of a pipeline: for a stream backed
+ * by a PipeChannel the read end is closed, so the upstream stage's writes
+ * start failing (see output_closed()) and it can stop early. For other
+ * streams this is a no-op.
+ *
+ * @param[in,out] in Input stream of the finishing stage.
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+void close_input(std::istream &in);
+
+/**
+ * Check whether nothing written to `out` can reach a consumer any more.
+ *
+ * True if `out` is bad (e.g. a write to a closed pipe failed) or if it is
+ * backed by a PipeChannel whose reader called close_input(). Producers
+ * check this in their loops and stop reading and writing once it is set.
+ *
+ * @param[in] out Output stream of the producing stage.
+ *
+ * @returns True if the consumer has finished.
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+bool output_closed(std::ostream &out);
+
+} // namespace cli
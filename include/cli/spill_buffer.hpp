@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <streambuf>
+#include <vector>
+
+namespace cli {
+
+/**
+ * Write-then-read stream buffer that spills to an unlinked temp file.
+ *
+ * Holds one intermediate pipeline result. Bytes are kept in memory until
+ * the configured budget is exceeded; then the buffer moves its contents to
+ * an anonymous temporary file (`O_TMPFILE` on Linux, `std::tmpfile`
+ * elsewhere) and keeps appending there. After start_reading() the contents
+ * are read back in fixed-size chunks, so a spilled buffer never has to fit
+ * in memory again.
+ *
+ * @see Executor
+ */
+class SpillBuffer : public std::streambuf {
+public:
+  /// Default in-memory budget in bytes.
+  static constexpr std::size_t kDefaultMemoryLimit = 64 * 1024 * 1024;
+
+  /// Opens the spill file; returns nullptr on failure.
+  using FileOpener = std::FILE *(*)();
+
+  /**
+   * Construct an empty buffer in write mode.
+   *
+   * @param[in] memory_limit Bytes kept in memory before spilling to disk.
+   * @param[in] open_file Spill file factory; nullptr selects an anonymous
+   *   temporary file.
+   */
+  explicit SpillBuffer(std::size_t memory_limit = kDefaultMemoryLimit,
+                       FileOpener open_file = nullptr);
+  ~SpillBuffer() override;
+
+  SpillBuffer(const SpillBuffer &) = delete;
+  SpillBuffer &operator=(const SpillBuffer &) = delete;
+
+  /**
+   * Switch from writing to reading, positioned at the first byte.
+   *
+   * @returns False if pending data could not be written to the spill file.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  bool start_reading();
+
+  /**
+   * Drop all contents and return to write mode.
+   *
+   * Memory already allocated is kept for reuse; the spill file is removed.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  void clear();
+
+  /// True if the contents currently live in the spill file.
+  bool spilled() const { return file_ != nullptr; }
+
+  /**
+   * True once a write to the spill file has failed.
+   *
+   * Further writes are refused until clear(). Bytes that never reached the
+   * file (all of them, if the initial spill failed) are still readable.
+   */
+  bool failed() const { return failed_; }
+
+  /// Total bytes written to spill files since construction.
+  std::uint64_t spilled_bytes() const { return spilled_bytes_; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  int_type underflow() override;
+  int sync() override;
+
+private:
+  bool spill();
+  bool flush_to_file();
+  void set_put_area(char *begin, std::size_t used, char *end);
+
+  std::size_t limit_;
+  FileOpener open_file_;
+  std::vector<char> memory_;
+  std::vector<char> io_buf_;
+  std::FILE *file_{nullptr};
+  std::uint64_t spilled_bytes_{0};
+  bool reading_{false};
+  bool failed_{false};
+};
+
+} // namespace cli
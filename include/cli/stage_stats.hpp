@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct rusage;
+
+namespace cli {
+
+/**
+ * Resources used by one pipeline stage.
+ *
+ * External programs are measured with the `rusage` their reaping returns
+ * (`wait4(2)`, also inside the Zygote). Built-ins run on an interpreter
+ * thread and are measured with `getrusage(RUSAGE_THREAD)` around the
+ * command, so CPU time of helper tasks a built-in hands to the ThreadPool
+ * is not included, and `max_rss_kib` is the peak of the whole
+ * interpreter. Stages that run fused into one operator or as coroutines on
+ * one thread (see Executor) share a single entry named after all of them;
+ * its `bytes_in` is what the first of them read and its `bytes_out` what
+ * the last one wrote.
+ *
+ * `bytes_in` and `bytes_out` count what crossed the stage's stdin and
+ * stdout. Built-ins are counted through a CountingReadBuf and a
+ * CountingWriteBuf around their streams. For an external program the
+ * interpreter counts what it pumps through the program's pipes; a program
+ * that reads or writes one of the interpreter's descriptors directly, or a
+ * kernel pipe to another program, moves bytes the interpreter never sees,
+ * and that side is left unknown.
+ *
+ * @see Executor
+ * @see ExecutorResult
+ */
+struct StageStats {
+  /// Command name (args[0]); "a | b" for stages measured together.
+  std::string name;
+  /// Whether the stage ran in-process.
+  bool builtin{false};
+  int exit_code{0};
+  /// Wall time from start to finish.
+  double real_seconds{0};
+  double user_seconds{0};
+  double system_seconds{0};
+  /// Peak resident set size.
+  long max_rss_kib{0};
+  long voluntary_switches{0};
+  long involuntary_switches{0};
+  /// Bytes read from stdin; unknown if the interpreter did not see them.
+  std::optional<std::uint64_t> bytes_in;
+  /// Bytes written to stdout; unknown if the interpreter did not see them.
+  std::optional<std::uint64_t> bytes_out;
+  /// Bytes read from and written to storage (block I/O; reads served from
+  /// the page cache do not count).
+  std::uint64_t block_bytes_read{0};
+  std::uint64_t block_bytes_written{0};
+};
+
+/**
+ * Measures the calling thread between construction and stop(); used for
+ * built-ins.
+ */
+class ThreadUsageMeter {
+public:
+  /// Take the starting snapshot of the calling thread.
+  ThreadUsageMeter();
+
+  /**
+   * Store what the calling thread used since construction in `stats` (all
+   * fields but name, builtin, exit_code, bytes_in and bytes_out). Call on
+   * the constructing thread.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  void stop(StageStats &stats) const;
+
+private:
+  std::chrono::steady_clock::time_point start_;
+  double user_{0};
+  double system_{0};
+  long voluntary_{0};
+  long involuntary_{0};
+  long in_blocks_{0};
+  long out_blocks_{0};
+};
+
+/**
+ * Copy the resources of a reaped child from `usage` to `stats` (all fields
+ * but name, builtin, exit_code, real_seconds, bytes_in and bytes_out).
+ *
+ * @exceptsafe Shall not throw exceptions.
+ */
+void set_child_usage(StageStats &stats, const struct rusage &usage);
+
+/**
+ * Write the report of the `time` prefix: a header, one row per stage, and
+ * a total row with the wall time of the whole pipeline, the sums (peak for
+ * RSS) of the stages, and the pipeline's own input (first stage) and
+ * output (last stage). Unknown byte counts are shown as "-".
+ *
+ * @param[in,out] out Where the report is written.
+ * @param[in] stages Stages of the pipeline, in order.
+ * @param[in] real_seconds Wall time of the whole pipeline.
+ *
+ * @exceptsafe Basic guarantee; may throw on stream failure.
+ */
+void print_stage_stats(std::ostream &out,
+                       const std::vector<StageStats> &stages,
+                       double real_seconds);
+
+} // namespace cli
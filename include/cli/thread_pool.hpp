@@ -0,0 +1,193 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cli {
+
+class ThreadPool;
+
+/**
+ * Completion handle of a task started by ThreadPool or run_concurrently().
+ *
+ * Move-only. Destroying a handle that has not been waited for waits for the
+ * task (and drops its exception), so a task never outlives the objects its
+ * creator captured by reference.
+ */
+class TaskHandle {
+public:
+  TaskHandle() = default;
+  TaskHandle(TaskHandle &&) noexcept = default;
+  TaskHandle &operator=(TaskHandle &&other) noexcept;
+  TaskHandle(const TaskHandle &) = delete;
+  TaskHandle &operator=(const TaskHandle &) = delete;
+  ~TaskHandle();
+
+  /**
+   * Block until the task has finished.
+   *
+   * While waiting for a pool task, the calling thread runs other queued
+   * compute tasks of the same pool (see ThreadPool::submit), so nested
+   * waits cannot starve the pool.
+   *
+   * @throws Rethrows the exception that escaped the task, if any.
+   */
+  void wait();
+
+  /// True if the handle refers to a task that has not been waited for.
+  bool valid() const { return state_ != nullptr; }
+
+private:
+  friend class ThreadPool;
+  friend TaskHandle run_concurrently(ThreadPool *pool,
+                                     std::function<void()> fn);
+
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done{false};
+    std::exception_ptr error;
+    /// Set when the task runs on a dedicated thread instead of a worker.
+    std::thread thread;
+    /// Pool whose queued tasks the waiter may run while waiting.
+    ThreadPool *pool{nullptr};
+
+    /// Run `fn`, keep the exception it throws and mark the task done.
+    void run(const std::function<void()> &fn);
+  };
+
+  explicit TaskHandle(std::shared_ptr<State> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * Interpreter-wide work-stealing thread pool.
+ *
+ * Every worker owns a deque of compute tasks. A worker pops its own tasks
+ * from the back (newest first) and, when it runs dry, steals the oldest
+ * task from the front of another worker's deque. Tasks submitted from
+ * outside the pool are spread over the deques round-robin.
+ *
+ * Two kinds of work are accepted:
+ * - submit(): short compute tasks (e.g. kernels of a parallel built-in).
+ *   They may be run by any worker or by a thread waiting in
+ *   TaskHandle::wait(), and must not block on I/O.
+ * - spawn(): tasks that may block for a long time (e.g. the I/O pumps of a
+ *   pipeline). They are guaranteed to run concurrently with the caller: on
+ *   an idle worker if there is one, otherwise on a new thread.
+ *
+ * The workers are started by the first submit() or spawn(), so an
+ * interpreter that never needs them (a script of built-ins and plain
+ * external commands) does not pay for creating and joining threads.
+ *
+ * @see CommandLineInterpreter
+ * @see Executor
+ */
+class ThreadPool {
+public:
+  /**
+   * Prepare `threads` workers; they start with the first task.
+   *
+   * @param[in] threads Number of workers; 0 is treated as 1.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  explicit ThreadPool(std::size_t threads);
+
+  /// Finish all queued tasks, then stop the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * Queue a non-blocking compute task.
+   *
+   * @param[in] fn Task to run.
+   *
+   * @returns Handle to wait for the task.
+   *
+   * @exceptsafe May throw if the workers are not running yet and a thread
+   * cannot be created.
+   */
+  TaskHandle submit(std::function<void()> fn);
+
+  /**
+   * Run a possibly blocking task concurrently with the caller.
+   *
+   * Hands the task to an idle worker, or starts a dedicated thread for it
+   * when every worker is busy, so the task never waits behind other work.
+   *
+   * @param[in] fn Task to run.
+   *
+   * @returns Handle to wait for the task.
+   */
+  TaskHandle spawn(std::function<void()> fn);
+
+  /// Number of workers, started or not.
+  std::size_t size() const { return queues_.size(); }
+
+  /// Number of tasks spawn() had to run on a dedicated thread so far.
+  std::size_t overflow_threads() const;
+
+private:
+  friend class TaskHandle;
+
+  struct Task {
+    std::function<void()> fn;
+    std::shared_ptr<TaskHandle::State> state;
+  };
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::shared_ptr<TaskHandle::State> make_state();
+  void start_workers();
+  void worker_loop(std::size_t index);
+  bool pop_spawned(Task &task);
+  bool pop_local(std::size_t index, Task &task);
+  bool steal(std::size_t thief, Task &task);
+  bool run_pending_task();
+  void help_until_done(TaskHandle::State &state);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<Task> spawned_;
+  std::size_t pending_{0};
+  std::size_t idle_{0};
+  std::size_t reserved_{0};
+  std::size_t next_queue_{0};
+  std::size_t overflow_threads_{0};
+  bool started_{false};
+  bool stopping_{false};
+};
+
+/**
+ * Run a possibly blocking task concurrently with the caller.
+ *
+ * Uses ThreadPool::spawn() if `pool` is set and a new thread otherwise, so
+ * code that can run with or without an interpreter-wide pool has one way
+ * to start its helpers.
+ *
+ * @param[in] pool Pool to use; may be null.
+ * @param[in] fn Task to run.
+ *
+ * @returns Handle to wait for the task.
+ */
+TaskHandle run_concurrently(ThreadPool *pool, std::function<void()> fn);
+
+} // namespace cli
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct rusage;
+
+namespace cli {
+
+/**
+ * Small helper process that forks and execs external programs on the
+ * interpreter's behalf.
+ *
+ * `fork()` has to copy the page tables of the calling process, so launching
+ * a program from an interpreter that has grown large (caches, big pipeline
+ * buffers) gets slower with its RSS. The zygote is forked once at startup,
+ * while the interpreter is still small, and then only receives launch
+ * requests over a Unix socket: the program path, argv, envp and the
+ * child's stdin/stdout/stderr and working directory descriptors (passed
+ * with `SCM_RIGHTS`). It forks the child from its own tiny address space,
+ * reaps it and reports the exit code and resource usage back through a
+ * per-launch status pipe, so launch latency does not depend on the
+ * interpreter's size.
+ *
+ * Only available on Linux; elsewhere start() returns null and programs are
+ * forked by the interpreter as before.
+ *
+ * @see ExternalCommand
+ * @see CommandLineInterpreter
+ */
+class Zygote {
+public:
+  /// Largest launch request (argv plus envp, in bytes) sent to the zygote.
+  static constexpr std::size_t kMaxRequest = 128 * 1024;
+
+  /**
+   * Fork the zygote process.
+   *
+   * Call before the interpreter starts threads or allocates much memory.
+   *
+   * @returns The running zygote, or null if unsupported or the process
+   *     could not be created.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  static std::unique_ptr<Zygote> start();
+
+  /// Close the request socket, which makes the zygote exit, and reap it.
+  ~Zygote();
+
+  Zygote(const Zygote &) = delete;
+  Zygote &operator=(const Zygote &) = delete;
+
+  /**
+   * Ask the zygote to run a program.
+   *
+   * Safe to call from several threads at once. The descriptors are
+   * duplicated into the zygote; the caller still owns (and closes) its
+   * copies. The program starts in the caller's current working directory,
+   * not the one the zygote was forked in.
+   *
+   * @param[in] program_path Program to execute.
+   * @param[in] args argv of the program; args[0] is replaced by
+   *     `program_path`, as the interpreter does for fork/exec.
+   * @param[in] envp Null-terminated "NAME=value" strings of the child's
+   *     environment (see Environment::envp).
+   * @param[in] stdin_fd Becomes the child's standard input.
+   * @param[in] stdout_fd Becomes the child's standard output.
+   * @param[in] stderr_fd Becomes the child's standard error.
+   *
+   * @returns Descriptor to pass to wait(), or -1 if the request could not
+   *     be delivered (the zygote is gone or the request is too large); the
+   *     caller then launches the program itself.
+   *
+   * @exceptsafe May throw on allocation.
+   */
+  int launch(const std::string &program_path,
+             const std::vector<std::string> &args, char *const *envp,
+             int stdin_fd, int stdout_fd, int stderr_fd);
+
+  /**
+   * Wait for a program started with launch() and close `status_fd`.
+   *
+   * @param[in] status_fd Descriptor returned by launch().
+   * @param[out] usage If not null, receives the resources the program used
+   *     (as from `wait4(2)`); left unchanged when -1 is returned.
+   *
+   * @returns Exit code of the program (1 if it was killed by a signal), or
+   *     -1 if the zygote could not fork it or exited before reporting.
+   *
+   * @exceptsafe Shall not throw exceptions.
+   */
+  static int wait(int status_fd, struct rusage *usage = nullptr);
+
+  /// Process id of the zygote.
+  int pid() const { return pid_; }
+
+private:
+  Zygote(int pid, int socket) : pid_(pid), socket_(socket) {}
+
+  int pid_;
+  int socket_;
+};
+
+} // namespace cli
@@ -0,0 +1,194 @@
+#include "cli/byte_stream.hpp"
+#include "cli/fd_io.hpp"
+#include "cli/pipe_channel.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+/// Read size of FileByteSource for unmapped files and buffer size of
+/// ByteSinkBuf.
+constexpr std::size_t kChunkSize = StreamByteSource::kChunkSize;
+
+/** read(2) that retries on EINTR. */
+long long read_fd(int fd, char *buf, std::size_t n) {
+  long long got;
+  do {
+#ifdef _WIN32
+    got = _read(fd, buf, static_cast<unsigned>(n));
+#else
+    got = read(fd, buf, n);
+#endif
+  } while (got < 0 && errno == EINTR);
+  return got;
+}
+
+} // namespace
+
+StreamByteSource::StreamByteSource(std::istream &in)
+    : in_(in), fd_(input_fd(in)), buffer_(kChunkSize) {}
+
+std::span<const char> StreamByteSource::next() {
+  std::size_t n = 0;
+  if (fd_ >= 0) {
+    const long long got = read_fd(fd_, buffer_.data(), buffer_.size());
+    failed_ = got < 0;
+    n = got > 0 ? static_cast<std::size_t>(got) : 0;
+    count_input(in_, n);
+  } else if (auto *buf = dynamic_cast<ChannelReadBuf *>(source_buf(in_));
+             buf && buf->in_avail() <= 0) {
+    n = buf->channel().read(buffer_.data(), buffer_.size());
+    count_input(in_, n);
+  } else {
+    const std::streamsize got = in_.rdbuf()->sgetn(
+        buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    n = got > 0 ? static_cast<std::size_t>(got) : 0;
+  }
+  if (n == 0)
+    in_.setstate(std::ios::eofbit);
+  return {buffer_.data(), n};
+}
+
+void StreamByteSource::close() { close_input(in_); }
+
+FileByteSource::FileByteSource(const std::string &path)
+#ifdef _WIN32
+    : fd_(_open(path.c_str(), _O_RDONLY | _O_BINARY)) {
+#else
+    : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+#endif
+  if (fd_ < 0)
+    return;
+  map_file();
+  if (!map_)
+    buffer_.resize(kChunkSize);
+}
+
+void FileByteSource::map_file() {
+#ifndef _WIN32
+  struct stat st = {};
+  if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    return;
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (p == MAP_FAILED)
+    return;
+  madvise(p, size, MADV_SEQUENTIAL);
+  map_ = static_cast<const char *>(p);
+  map_size_ = size;
+#endif
+}
+
+FileByteSource::~FileByteSource() {
+#ifndef _WIN32
+  if (map_)
+    munmap(const_cast<char *>(map_), map_size_);
+#endif
+  if (fd_ >= 0) {
+#ifdef _WIN32
+    _close(fd_);
+#else
+    ::close(fd_);
+#endif
+  }
+}
+
+std::span<const char> FileByteSource::next() {
+  if (map_) {
+    const std::size_t n = std::min(kMappedChunkSize, map_size_ - offset_);
+    std::span<const char> chunk(map_ + offset_, n);
+    offset_ += n;
+    return chunk;
+  }
+  if (fd_ < 0)
+    return {};
+  const long long got = read_fd(fd_, buffer_.data(), buffer_.size());
+  failed_ = got < 0;
+  return {buffer_.data(), got > 0 ? static_cast<std::size_t>(got) : 0};
+}
+
+bool StreamByteSink::write(std::span<const char> data) {
+  if (!data.empty())
+    out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+  return !output_closed(out_);
+}
+
+ByteSourceBuf::int_type ByteSourceBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  std::span<const char> chunk = source_.next();
+  if (chunk.empty())
+    return traits_type::eof();
+  // The chunk stays valid until the next call to next(), i.e. until the
+  // get area has been consumed.
+  char *data = const_cast<char *>(chunk.data());
+  setg(data, data, data + chunk.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+ByteSinkBuf::ByteSinkBuf(ByteSink &sink) : sink_(sink), buffer_(kChunkSize) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+ByteSinkBuf::~ByteSinkBuf() { flush_buffer(); }
+
+bool ByteSinkBuf::flush_buffer() {
+  const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  if (!failed_ && pending > 0 &&
+      !sink_.write(std::span<const char>(buffer_.data(), pending)))
+    failed_ = true;
+  return !failed_;
+}
+
+ByteSinkBuf::int_type ByteSinkBuf::overflow(int_type ch) {
+  if (!flush_buffer())
+    return traits_type::eof();
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
+
+std::streamsize ByteSinkBuf::xsputn(const char *s, std::streamsize n) {
+  const std::size_t len = static_cast<std::size_t>(n);
+  if (len <= static_cast<std::size_t>(epptr() - pptr())) {
+    std::memcpy(pptr(), s, len);
+    pbump(static_cast<int>(n));
+    return n;
+  }
+  if (!flush_buffer())
+    return 0;
+  if (!sink_.write(std::span<const char>(s, len))) {
+    failed_ = true;
+    return 0;
+  }
+  return n;
+}
+
+int ByteSinkBuf::sync() { return flush_buffer() ? 0 : -1; }
+
+bool copy_bytes(ByteSource &in, ByteSink &out) {
+  for (std::span<const char> chunk = in.next(); !chunk.empty();
+       chunk = in.next()) {
+    if (!out.write(chunk))
+      return false;
+  }
+  return true;
+}
+
+} // namespace cli
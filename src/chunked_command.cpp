@@ -0,0 +1,19 @@
+#include "cli/chunked_command.hpp"
+
+namespace cli {
+
+int run_chunked(Command &command, const std::vector<std::string> &args,
+                ByteSource &in, ByteSink &out, std::ostream &err,
+                const Environment &env) {
+  if (auto *chunked = dynamic_cast<ChunkedCommand *>(&command))
+    return chunked->execute_chunks(args, in, out, err, env);
+  ByteSourceBuf in_buf(in);
+  ByteSinkBuf out_buf(out);
+  std::istream in_stream(&in_buf);
+  std::ostream out_stream(&out_buf);
+  const int code = command.execute(args, in_stream, out_stream, err, env);
+  out_stream.flush();
+  return code;
+}
+
+} // namespace cli
@@ -1,119 +1,207 @@
 #include "cli/command_line_interpreter.hpp"
-#include "cli/ast.hpp"
+#include "cli/byte_stream.hpp"
 #include "cli/commands/cat_command.hpp"
 #include "cli/commands/echo_command.hpp"
 #include "cli/commands/exit_command.hpp"
+#include "cli/commands/fg_command.hpp"
+#include "cli/commands/jobs_command.hpp"
+#include "cli/commands/parallel_command.hpp"
+#include "cli/commands/wait_command.hpp"
 #include "cli/commands/pwd_command.hpp"
 #include "cli/commands/wc_command.hpp"
 #include "cli/commands/grep_command.hpp"
+#include "cli/commands/hash_command.hpp"
+#include "cli/commands/head_command.hpp"
+#include "cli/fd_io.hpp"
+#include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace cli {
 
 namespace {
 
-/** Returns true if s looks like VAR=value (valid identifier before =). */
-bool is_assignment(const std::string &s) {
-  if (s.empty())
-    return false;
-  std::size_t eq = s.find('=');
-  if (eq == std::string::npos || eq == 0)
-    return false;
-  for (std::size_t i = 0; i < eq; ++i) {
-    char c = s[i];
-    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
-              (i > 0 && (c >= '0' && c <= '9'));
-    if (!ok)
-      return false;
-  }
-  return true;
+/** Worker count for the interpreter's pool: `CLI_THREADS` if it is a
+ * positive number, otherwise the hardware concurrency (at least 2). */
+std::size_t pool_size(const Environment &env) {
+  std::string value = env.get("CLI_THREADS");
+  char *end = nullptr;
+  unsigned long n = std::strtoul(value.c_str(), &end, 10);
+  if (!value.empty() && *end == '\0' && n > 0)
+    return static_cast<std::size_t>(n);
+  return std::max(2u, std::thread::hardware_concurrency());
 }
 
-/** Strip leading VAR=value from first command and apply to env. Mutates
- * pipeline. */
-void apply_assignments(Pipeline &pipeline, Environment &env) {
-  if (pipeline.empty())
-    return;
-  CommandNode &first = pipeline[0];
-  std::vector<std::string> new_args;
-  std::vector<Substitute> new_sub;
-  bool name_consumed = false;
-  auto apply = [&](const std::string &token, Substitute sub) {
-    if (!name_consumed) {
-      if (is_assignment(token)) {
-        std::size_t eq = token.find('=');
-        std::string key = token.substr(0, eq);
-        std::string val = (eq + 1 < token.size()) ? token.substr(eq + 1) : "";
-        if (sub == Substitute::Yes)
-          val = env.substitute(val);
-        env.set(key, val);
-        return;
-      }
-      name_consumed = true;
-      first.name = token;
-      first.substitute_name = sub;
-      return;
-    }
-    new_args.push_back(token);
-    new_sub.push_back(sub);
-  };
-  apply(first.name, first.substitute_name);
-  for (std::size_t i = 0; i < first.args.size(); ++i) {
-    Substitute sub = (i < first.substitute_arg.size()) ? first.substitute_arg[i]
-                                                       : Substitute::Yes;
-    apply(first.args[i], sub);
-  }
-  first.args = std::move(new_args);
-  first.substitute_arg = std::move(new_sub);
-  if (!name_consumed)
-    first.name.clear();
+/** Buffered stream over the descriptor behind `out`, or null if `out` has
+ * none or `CLI_OUTPUT_BUFFER` is "0". `CLI_OUTPUT_BUFFER` set to "line" or
+ * "block" overrides the policy chosen by whether `out` is a terminal. */
+std::unique_ptr<OutputSink> make_output_sink(std::ostream &out,
+                                             const Environment &env) {
+  const std::string mode = env.get("CLI_OUTPUT_BUFFER");
+  if (mode == "0" || dynamic_cast<OutputSinkBuf *>(out.rdbuf()))
+    return nullptr;
+  const int fd = output_fd(out);
+  if (fd < 0)
+    return nullptr;
+  FlushPolicy policy = OutputSink::policy_for(fd);
+  if (mode == "line")
+    policy = FlushPolicy::Line;
+  else if (mode == "block")
+    policy = FlushPolicy::Block;
+  return std::make_unique<OutputSink>(fd, policy);
 }
 
-/** Remove leading commands that have empty name (after assignment stripping).
- */
-void drop_empty_leading_commands(Pipeline &pipeline) {
-  while (!pipeline.empty() && pipeline.front().name.empty() &&
-         pipeline.front().args.empty()) {
-    pipeline.erase(pipeline.begin());
+/** The interpreter's stdout and stderr as streams the foreground shares
+ * with background jobs: a buffer without a lock of its own (anything but
+ * an OutputSinkBuf) is written through a LockedWriteBuf. Jobs write through
+ * streams of their own over the same buffers (see start_job()). */
+class SharedStdio {
+public:
+  SharedStdio(std::ostream &out, std::ostream &err)
+      : out_(shared_buf(out, out_lock_)), err_(shared_buf(err, err_lock_)) {}
+
+  SharedStdio(const SharedStdio &) = delete;
+  SharedStdio &operator=(const SharedStdio &) = delete;
+
+  std::ostream &out() { return out_; }
+  std::ostream &err() { return err_; }
+
+private:
+  static std::streambuf *shared_buf(std::ostream &stream,
+                                    std::optional<LockedWriteBuf> &lock) {
+    if (dynamic_cast<OutputSinkBuf *>(stream.rdbuf()))
+      return stream.rdbuf();
+    return &lock.emplace(stream.rdbuf());
+  }
+
+  std::optional<LockedWriteBuf> out_lock_;
+  std::optional<LockedWriteBuf> err_lock_;
+  std::ostream out_;
+  std::ostream err_;
+};
+
+/** Switches a PathCache to another watch mode and back on destruction. */
+class WatchModeGuard {
+public:
+  WatchModeGuard(PathCache &paths, bool watch)
+      : paths_(paths), previous_(paths.watch()) {
+    paths_.set_watch(watch);
   }
+  ~WatchModeGuard() { paths_.set_watch(previous_); }
+
+  WatchModeGuard(const WatchModeGuard &) = delete;
+  WatchModeGuard &operator=(const WatchModeGuard &) = delete;
+
+private:
+  PathCache &paths_;
+  bool previous_;
+};
+
+/** Factory of a built-in that needs no interpreter state. */
+template <typename C> std::unique_ptr<Command> make_builtin() {
+  return std::make_unique<C>();
 }
 
 } // namespace
 
 CommandLineInterpreter::CommandLineInterpreter() : executor_(registry_) {
   env_.init_from_current();
+  // Fork the zygote first, while the process is small and single-threaded.
+  if (env_.get("CLI_ZYGOTE") == "1") {
+    zygote_ = Zygote::start();
+    executor_.set_zygote(zygote_.get());
+  }
+  pool_ = std::make_unique<ThreadPool>(pool_size(env_));
+  executor_.set_thread_pool(pool_.get());
+  executor_.set_path_cache(&paths_);
   register_builtins();
 }
 
 void CommandLineInterpreter::register_builtins() {
-  registry_.register_command("cat", std::make_unique<CatCommand>());
-  registry_.register_command("echo", std::make_unique<EchoCommand>());
-  registry_.register_command("wc", std::make_unique<WcCommand>());
-  registry_.register_command("pwd", std::make_unique<PwdCommand>());
-  registry_.register_command("exit", std::make_unique<ExitCommand>());
-  registry_.register_command("grep", std::make_unique<GrepCommand>());
+  // Constructed on first use: a short script pays only for its built-ins.
+  registry_.register_factory("cat", make_builtin<CatCommand>);
+  registry_.register_factory("echo", make_builtin<EchoCommand>);
+  registry_.register_factory("wc", make_builtin<WcCommand>);
+  registry_.register_factory("pwd", make_builtin<PwdCommand>);
+  registry_.register_factory("exit", make_builtin<ExitCommand>);
+  registry_.register_factory("grep", make_builtin<GrepCommand>);
+  registry_.register_factory("head", make_builtin<HeadCommand>);
+  registry_.register_factory(
+      "hash", [this] { return std::make_unique<HashCommand>(paths_); });
+  registry_.register_factory(
+      "jobs", [this] { return std::make_unique<JobsCommand>(jobs_); });
+  registry_.register_factory(
+      "wait", [this] { return std::make_unique<WaitCommand>(jobs_); });
+  registry_.register_factory(
+      "fg", [this] { return std::make_unique<FgCommand>(jobs_); });
+  registry_.register_factory("parallel", [this] {
+    return std::make_unique<ParallelCommand>(executor_, pool_.get());
+  });
+}
+
+int CommandLineInterpreter::start_job(const ExecutionPlan &plan,
+                                      const std::string &line,
+                                      std::ostream &out, std::ostream &err) {
+  // The job keeps its own copies: the cached plan and the environment go on
+  // changing while it runs. The stream objects cannot be shared with the
+  // foreground either, only their (locked) buffers.
+  auto body = [this, plan, env = env_, out_buf = out.rdbuf(),
+               err_buf = err.rdbuf()]() mutable {
+    std::istringstream no_input;
+    std::ostream job_out(out_buf);
+    std::ostream job_err(err_buf);
+    return executor_.execute_list(plan, no_input, job_out, job_err, env)
+        .exit_code;
+  };
+  const std::size_t first = line.find_first_not_of(" \t");
+  const std::size_t last = line.find_last_not_of(" \t");
+  return jobs_.start(line.substr(first, last - first + 1), std::move(body),
+                     pool_.get());
+}
+
+ExecutorResult CommandLineInterpreter::run_line(const ExecutionPlan &plan,
+                                                const std::string &line,
+                                                std::istream &in,
+                                                std::ostream &out,
+                                                std::ostream &err,
+                                                bool interactive) {
+  if (!plan.background())
+    return executor_.execute_list(plan, in, out, err, env_);
+  // Like a subshell: assignments alone change nothing here.
+  if (!plan.stages().empty() || !plan.rest().empty()) {
+    const int id = start_job(plan, line, out, err);
+    if (interactive)
+      err << '[' << id << "]\n";
+  }
+  return ExecutorResult{};
 }
 
-int CommandLineInterpreter::run(std::istream &in, std::ostream &out,
-                                std::ostream &err) {
+int CommandLineInterpreter::run(std::istream &in, std::ostream &stdout_stream,
+                                std::ostream &stderr_stream) {
+  std::unique_ptr<OutputSink> sink = make_output_sink(stdout_stream, env_);
+  SharedStdio stdio(sink ? *sink : stdout_stream, stderr_stream);
+  std::ostream &out = stdio.out();
+  std::ostream &err = stdio.err();
   std::string line;
   int exit_code = 0;
+  const bool interactive = &in == &std::cin;
   while (true) {
     try {
-      if (&in == &std::cin) {
+      if (interactive) {
+        for (const JobTable::Status &status : jobs_.take_finished())
+          err << JobTable::describe(status) << '\n';
         out << "> " << std::flush;
       }
       if (!std::getline(in, line))
         break;
-      auto pipeline = parser_.parse(line);
-      if (!pipeline) // empty line
-        continue;
-      apply_assignments(*pipeline, env_);
-      drop_empty_leading_commands(*pipeline);
-      if (pipeline->empty()) {
-        continue;
-      }
-      ExecutorResult result = executor_.execute(*pipeline, in, out, err, env_);
+      ExecutorResult result =
+          run_line(plans_.get(line), line, in, out, err, interactive);
       if (result.should_exit) {
         exit_code = result.exit_code;
         break;
@@ -124,7 +212,82 @@ int CommandLineInterpreter::run(std::istream &in, std::ostream &out,
       err << "cli: unknown error\n";
     }
   }
+  jobs_.wait_all();
+  return exit_code;
+}
+
+int CommandLineInterpreter::run_script(std::string_view script,
+                                       std::istream &in,
+                                       std::ostream &stdout_stream,
+                                       std::ostream &stderr_stream) {
+  // Compile everything first: a syntax error anywhere stops the script
+  // before any line has had an effect.
+  std::vector<std::pair<std::string, ExecutionPlan>> lines;
+  bool valid = true;
+  std::size_t number = 0;
+  for (std::size_t start = 0; start < script.size();) {
+    std::size_t end = script.find('\n', start);
+    if (end == std::string_view::npos)
+      end = script.size();
+    std::string line(script.substr(start, end - start));
+    start = end + 1;
+    if (++number == 1 && line.starts_with("#!"))
+      continue;
+    ExecutionPlan plan = ExecutionPlan::compile(line);
+    if (!plan.syntax_error().empty()) {
+      stderr_stream << "cli: line " << number << ": " << plan.syntax_error()
+                    << '\n';
+      valid = false;
+    }
+    // Empty lines leave the exit code alone.
+    if (!plan.assignments().empty() || !plan.stages().empty() ||
+        !plan.rest().empty())
+      lines.emplace_back(std::move(line), std::move(plan));
+  }
+  if (!valid)
+    return 2;
+
+  WatchModeGuard polling(paths_, false);
+  std::unique_ptr<OutputSink> sink = make_output_sink(stdout_stream, env_);
+  SharedStdio stdio(sink ? *sink : stdout_stream, stderr_stream);
+  std::ostream &out = stdio.out();
+  std::ostream &err = stdio.err();
+  int exit_code = 0;
+  for (const auto &[line, plan] : lines) {
+    try {
+      ExecutorResult result = run_line(plan, line, in, out, err, false);
+      exit_code = result.exit_code;
+      if (result.should_exit)
+        break;
+    } catch (const std::exception &e) {
+      err << "cli: " << e.what() << "\n";
+      exit_code = 1;
+    } catch (...) {
+      err << "cli: unknown error\n";
+      exit_code = 1;
+    }
+  }
+  jobs_.wait_all();
   return exit_code;
 }
 
+int CommandLineInterpreter::run_file(const std::string &path,
+                                     std::istream &in, std::ostream &out,
+                                     std::ostream &err) {
+  FileByteSource source(path);
+  if (!source.is_open()) {
+    err << "cli: cannot open '" << path << "'\n";
+    return 127;
+  }
+  std::string script;
+  for (std::span<const char> chunk = source.next(); !chunk.empty();
+       chunk = source.next())
+    script.append(chunk.data(), chunk.size());
+  if (source.failed()) {
+    err << "cli: cannot read '" << path << "'\n";
+    return 126;
+  }
+  return run_script(script, in, out, err);
+}
+
 } // namespace cli
@@ -4,15 +4,35 @@ namespace cli {
 
 void CommandRegistry::register_command(const std::string &name,
                                        std::unique_ptr<Command> cmd) {
-  if (cmd)
-    commands_[name] = std::move(cmd);
+  if (cmd) {
+    auto entry = std::make_unique<Entry>();
+    entry->command = std::move(cmd);
+    commands_[name] = std::move(entry);
+    ++generation_;
+  }
+}
+
+void CommandRegistry::register_factory(const std::string &name,
+                                       Factory factory) {
+  if (factory) {
+    auto entry = std::make_unique<Entry>();
+    entry->factory = std::move(factory);
+    commands_[name] = std::move(entry);
+    ++generation_;
+  }
 }
 
 Command *CommandRegistry::find(const std::string &name) const {
   auto it = commands_.find(name);
   if (it == commands_.end())
     return nullptr;
-  return it->second.get();
+  Entry &entry = *it->second;
+  if (entry.factory) {
+    // Jobs and streaming stages resolve commands on pool threads.
+    std::call_once(entry.constructed,
+                   [&entry] { entry.command = entry.factory(); });
+  }
+  return entry.command.get();
 }
 
 bool CommandRegistry::has(const std::string &name) const {
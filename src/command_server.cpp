@@ -0,0 +1,372 @@
+#include "cli/command_server.hpp"
+#include "cli/environment.hpp"
+#include "cli/fd_io.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+#ifdef __linux__
+/// Descriptors sent with a request: stdin, stdout, stderr.
+constexpr std::size_t kRequestFds = 3;
+
+/** Fills `addr` with `path`; false if the path does not fit. */
+bool make_address(const std::string &path, sockaddr_un &addr) {
+  addr = sockaddr_un{};
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    return false;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+/** Connects a new socket to `addr`; returns it, or -1. */
+int connect_to(const sockaddr_un &addr) {
+  const int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0)
+    return -1;
+  if (connect(sock, reinterpret_cast<const sockaddr *>(&addr),
+              sizeof(addr)) != 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/** True if `path` is a socket file that no server accepts on any more. */
+bool is_stale_socket(const std::string &path, const sockaddr_un &addr) {
+  struct stat st = {};
+  if (lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+    return false;
+  const int sock = connect_to(addr);
+  if (sock < 0)
+    return errno == ECONNREFUSED;
+  close(sock);
+  return false;
+}
+
+/** Request body fields, each terminated by '\0': working directory, "c"
+ * or "f", script or script path, then the environment. Returns false if
+ * the body is malformed. */
+bool parse_request(const char *data, std::size_t size,
+                   std::vector<const char *> &fields) {
+  if (size == 0 || data[size - 1] != '\0')
+    return false;
+  for (const char *p = data; p < data + size; p += std::strlen(p) + 1)
+    fields.push_back(p);
+  return fields.size() >= 3 && (std::strcmp(fields[1], "c") == 0 ||
+                                std::strcmp(fields[1], "f") == 0);
+}
+
+/** True if the process on the other end of `conn` runs as our user. */
+bool is_own_user(int conn) {
+  ucred peer{};
+  socklen_t len = sizeof(peer);
+  return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &len) == 0 &&
+         len == sizeof(peer) && peer.uid == geteuid();
+}
+
+/** Receives one request on `conn` and runs it. Returns the exit code, or
+ * -1 if the request is malformed or comes from another user. */
+int serve_request(int conn, std::vector<char> &buf,
+                  CommandLineInterpreter &interpreter) {
+  if (!is_own_user(conn))
+    return -1;
+  iovec iov{buf.data(), buf.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(kRequestFds * sizeof(int))];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  do {
+    n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return -1;
+
+  // Keeps the first kRequestFds descriptors received and closes the rest.
+  int fds[kRequestFds];
+  std::size_t nfds = 0;
+  for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+    if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+      continue;
+    const std::size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (std::size_t i = 0; i < count; ++i, ++nfds) {
+      int fd;
+      std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+      if (nfds < kRequestFds)
+        fds[nfds] = fd;
+      else
+        close(fd);
+    }
+  }
+  std::vector<const char *> fields;
+  const bool valid =
+      nfds == kRequestFds && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) &&
+      parse_request(buf.data(), static_cast<std::size_t>(n), fields);
+  if (!valid) {
+    for (std::size_t i = 0; i < std::min(nfds, kRequestFds); ++i)
+      close(fds[i]);
+    return -1;
+  }
+
+  FdStreamBuf in_buf(fds[0], true);
+  FdStreamBuf out_buf(fds[1], true);
+  FdStreamBuf err_buf(fds[2], true);
+  std::istream in(&in_buf);
+  std::ostream out(&out_buf);
+  std::ostream err(&err_buf);
+  err.setf(std::ios::unitbuf);
+  if (chdir(fields[0]) != 0) {
+    err << "cli: cannot change directory to '" << fields[0] << "'\n";
+    return 1;
+  }
+  Environment env;
+  for (std::size_t i = 3; i < fields.size(); ++i) {
+    const char *eq = std::strchr(fields[i], '=');
+    if (eq)
+      env.set(std::string(fields[i], eq), eq + 1);
+  }
+  interpreter.set_environment(std::move(env));
+  return fields[1][0] == 'f' ? interpreter.run_file(fields[2], in, out, err)
+                             : interpreter.run_script(fields[2], in, out, err);
+}
+
+/** Body of a worker process: takes one connection on `listener`, tells
+ * the server `server` through `report` that it has, serves the request and
+ * exits. */
+[[noreturn]] void serve_worker(int listener, pid_t server, int report,
+                               std::vector<char> &buf,
+                               CommandLineInterpreter &interpreter) {
+  // A worker still waiting when the server dies would take requests on
+  // its own.
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  if (getppid() != server)
+    _exit(1);
+  int conn;
+  do {
+    conn = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+  } while (conn < 0 && (errno == EINTR || errno == ECONNABORTED));
+  // 'a' once a connection is taken, 'e' if accept() failed (or stop()
+  // shut the socket down).
+  const char status = conn < 0 ? 'e' : 'a';
+  if (write(report, &status, 1) != 1 || conn < 0)
+    _exit(1);
+  close(report);
+  close(listener);
+  // A request already taken runs to the end even if the server dies.
+  prctl(PR_SET_PDEATHSIG, 0);
+  std::int32_t code;
+  try {
+    code = serve_request(conn, buf, interpreter);
+  } catch (...) {
+    code = 1;
+  }
+  if (code >= 0)
+    send(conn, &code, sizeof(code), MSG_NOSIGNAL);
+  // Skips the destructors of the server's objects, which belong to the
+  // server (e.g. ~CommandServer would remove the socket file).
+  _exit(0);
+}
+#endif
+
+} // namespace
+
+std::unique_ptr<CommandServer> CommandServer::listen(const std::string &path,
+                                                     std::ostream &err) {
+#ifdef __linux__
+  sockaddr_un addr;
+  if (!make_address(path, addr)) {
+    err << "cli: invalid socket path '" << path << "'\n";
+    return nullptr;
+  }
+  const int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    err << "cli: cannot create socket: " << std::strerror(errno) << '\n';
+    return nullptr;
+  }
+  auto bind_addr = [&] {
+    return bind(sock, reinterpret_cast<const sockaddr *>(&addr),
+                sizeof(addr)) == 0;
+  };
+  bool bound = bind_addr();
+  if (!bound && errno == EADDRINUSE && is_stale_socket(path, addr)) {
+    unlink(path.c_str());
+    bound = bind_addr();
+  }
+  // Nobody can connect before listen(), so restricting the file here leaves
+  // no window in which another user could reach the server.
+  if (!bound || chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(sock, SOMAXCONN) != 0) {
+    err << "cli: cannot listen on '" << path << "': " << std::strerror(errno)
+        << '\n';
+    close(sock);
+    return nullptr;
+  }
+  return std::unique_ptr<CommandServer>(new CommandServer(path, sock));
+#else
+  err << "cli: --serve is only supported on Linux\n";
+  (void)path;
+  return nullptr;
+#endif
+}
+
+CommandServer::~CommandServer() {
+#ifdef __linux__
+  close(socket_);
+  unlink(path_.c_str());
+#endif
+}
+
+int CommandServer::serve(CommandLineInterpreter &interpreter) {
+#ifdef __linux__
+  std::signal(SIGPIPE, SIG_IGN);
+  std::vector<char> buf(kMaxRequest);
+  std::vector<pid_t> workers;
+  // Reaps the workers that have finished, or all of them with `block`.
+  auto reap = [&workers](bool block) {
+    std::erase_if(workers, [block](pid_t pid) {
+      pid_t r;
+      do {
+        r = waitpid(pid, nullptr, block ? 0 : WNOHANG);
+      } while (r < 0 && errno == EINTR);
+      return r != 0;
+    });
+  };
+  const pid_t server = getpid();
+  int result = 0;
+  while (!stopping_) {
+    // Forks the worker for the next request, then waits until it has taken
+    // a connection: requests run side by side in workers of their own, and
+    // none waits for a fork.
+    int report[2];
+    if (pipe2(report, O_CLOEXEC) != 0) {
+      result = 1;
+      break;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(report[0]);
+      serve_worker(socket_, server, report[1], buf, interpreter);
+    }
+    close(report[1]);
+    if (pid < 0) {
+      close(report[0]);
+      result = 1;
+      break;
+    }
+    workers.push_back(pid);
+    char status = 0;
+    ssize_t n;
+    do {
+      n = read(report[0], &status, 1);
+    } while (n < 0 && errno == EINTR && !stopping_);
+    close(report[0]);
+    reap(false);
+    // A worker that died before it reported is simply replaced.
+    if (n < 0 || (n == 1 && status != 'a')) {
+      if (!stopping_)
+        result = 1;
+      break;
+    }
+  }
+  reap(true);
+  return result;
+#else
+  (void)interpreter;
+  return 1;
+#endif
+}
+
+void CommandServer::stop() {
+  stopping_ = true;
+#ifdef __linux__
+  // Wakes a blocked accept(), which then fails.
+  shutdown(socket_, SHUT_RDWR);
+#endif
+}
+
+int CommandServer::call(const std::string &path, bool script_is_file,
+                        const std::string &script, char *const *envp,
+                        int stdin_fd, int stdout_fd, int stderr_fd) {
+#ifdef __linux__
+  sockaddr_un addr;
+  std::error_code ec;
+  const std::string cwd = std::filesystem::current_path(ec).string();
+  if (!make_address(path, addr) || ec)
+    return -1;
+  std::string request = cwd;
+  request.push_back('\0');
+  request.append(script_is_file ? "f" : "c").push_back('\0');
+  request.append(script).push_back('\0');
+  for (char *const *p = envp; *p; ++p)
+    request.append(*p).push_back('\0');
+  if (request.size() > kMaxRequest)
+    return -1;
+  const int sock = connect_to(addr);
+  if (sock < 0)
+    return -1;
+
+  const int fds[kRequestFds] = {stdin_fd, stdout_fd, stderr_fd};
+  iovec iov{request.data(), request.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr *c = CMSG_FIRSTHDR(&msg);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type = SCM_RIGHTS;
+  c->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(c), fds, sizeof(fds));
+  ssize_t n;
+  do {
+    n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  std::int32_t code = -1;
+  if (n == static_cast<ssize_t>(request.size())) {
+    do {
+      n = recv(sock, &code, sizeof(code), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n != sizeof(code) || code < 0)
+      code = -2;
+  }
+  close(sock);
+  return code;
+#else
+  (void)path;
+  (void)script_is_file;
+  (void)script;
+  (void)envp;
+  (void)stdin_fd;
+  (void)stdout_fd;
+  (void)stderr_fd;
+  return -1;
+#endif
+}
+
+} // namespace cli
@@ -1,23 +1,87 @@
 #include "cli/commands/cat_command.hpp"
-#include <fstream>
+#include "cli/fd_io.hpp"
+#include <algorithm>
+#include <span>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace cli {
 
+namespace {
+
+#ifndef _WIN32
+/** Copies stdin or the files to an fd-backed output without going through
+ * streams (sendfile/splice where the kernel allows it). */
+int cat_to_fd(const std::vector<std::string> &args, std::istream &in,
+              int out_fd, std::ostream &out, std::ostream &err) {
+  if (args.size() < 2) {
+    int in_fd = input_fd(in);
+    if (in_fd < 0) {
+      StreamByteSource source(in);
+      StreamByteSink sink(out);
+      copy_bytes(source, sink);
+      return 0;
+    }
+    const std::int64_t n = transfer_fd(in_fd, out_fd);
+    if (n < 0)
+      return 1;
+    count_input(in, static_cast<std::uint64_t>(n));
+    count_output(out, static_cast<std::uint64_t>(n));
+    return 0;
+  }
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    int fd = open(args[i].c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      err << "cat: cannot open '" << args[i] << "'\n";
+      return 1;
+    }
+    std::int64_t n = transfer_fd(fd, out_fd);
+    close(fd);
+    if (n < 0) {
+      err << "cat: read error '" << args[i] << "'\n";
+      return 1;
+    }
+    count_output(out, static_cast<std::uint64_t>(n));
+  }
+  return 0;
+}
+#endif
+
+} // namespace
+
 int CatCommand::execute(const std::vector<std::string> &args,
                         std::istream &in, std::ostream &out,
-                        std::ostream &err, const Environment & /*env*/) {
+                        std::ostream &err, const Environment &env) {
+#ifndef _WIN32
+  int out_fd = output_fd(out);
+  if (out_fd >= 0)
+    return cat_to_fd(args, in, out_fd, out, err);
+#endif
+  StreamByteSource source(in);
+  StreamByteSink sink(out);
+  return execute_chunks(args, source, sink, err, env);
+}
+
+int CatCommand::execute_chunks(const std::vector<std::string> &args,
+                               ByteSource &in, ByteSink &out,
+                               std::ostream &err, const Environment & /*env*/) {
   if (args.size() < 2) {
-    out << in.rdbuf();
+    copy_bytes(in, out);
     return 0;
   }
   for (std::size_t i = 1; i < args.size(); ++i) {
-    std::ifstream f(args[i], std::ios::binary);
-    if (!f) {
+    FileByteSource f(args[i]);
+    if (!f.is_open()) {
       err << "cat: cannot open '" << args[i] << "'\n";
       return 1;
     }
-    out << f.rdbuf();
-    if (!f) {
+    if (!copy_bytes(f, out))
+      return 0;
+    if (f.failed()) {
       err << "cat: read error '" << args[i] << "'\n";
       return 1;
     }
@@ -25,4 +89,41 @@ int CatCommand::execute(const std::vector<std::string> &args,
   return 0;
 }
 
+StageTask CatCommand::run_stage(std::vector<std::string> args,
+                                StageInput &in, StageOutput &out,
+                                std::ostream &err, const Environment & /*env*/,
+                                int &exit_code) {
+  exit_code = 0;
+  if (args.size() < 2) {
+    while (auto chunk = co_await in.next()) {
+      if (!co_await out.write(std::move(*chunk)))
+        break;
+    }
+    co_return;
+  }
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    FileByteSource f(args[i]);
+    if (!f.is_open()) {
+      err << "cat: cannot open '" << args[i] << "'\n";
+      exit_code = 1;
+      co_return;
+    }
+    for (std::span<const char> data = f.next(); !data.empty();
+         data = f.next()) {
+      for (std::size_t at = 0; at < data.size();
+           at += StageInput::kChunkSize) {
+        const std::size_t n =
+            std::min(StageInput::kChunkSize, data.size() - at);
+        if (!co_await out.write(std::string(data.data() + at, n)))
+          co_return;
+      }
+    }
+    if (f.failed()) {
+      err << "cat: read error '" << args[i] << "'\n";
+      exit_code = 1;
+      co_return;
+    }
+  }
+}
+
 } // namespace cli
@@ -2,16 +2,35 @@
 
 namespace cli {
 
-int EchoCommand::execute(const std::vector<std::string> &args,
-                         std::istream & /*in*/, std::ostream &out,
-                         std::ostream & /*err*/, const Environment & /*env*/) {
+namespace {
+
+/** Arguments joined by single spaces, followed by a newline. */
+std::string echo_line(const std::vector<std::string> &args) {
+  std::string line;
   for (std::size_t i = 1; i < args.size(); ++i) {
     if (i > 1)
-      out << ' ';
-    out << args[i];
+      line += ' ';
+    line += args[i];
   }
-  out << '\n';
+  line += '\n';
+  return line;
+}
+
+} // namespace
+
+int EchoCommand::execute(const std::vector<std::string> &args,
+                         std::istream & /*in*/, std::ostream &out,
+                         std::ostream & /*err*/, const Environment & /*env*/) {
+  out << echo_line(args);
   return 0;
 }
 
+StageTask EchoCommand::run_stage(std::vector<std::string> args,
+                                 StageInput & /*in*/, StageOutput &out,
+                                 std::ostream & /*err*/,
+                                 const Environment & /*env*/, int &exit_code) {
+  co_await out.write(echo_line(args));
+  exit_code = 0;
+}
+
 } // namespace cli
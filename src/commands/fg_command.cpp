@@ -0,0 +1,34 @@
+#include "cli/commands/fg_command.hpp"
+
+namespace cli {
+
+int FgCommand::execute(const std::vector<std::string> &args,
+                       std::istream & /*in*/, std::ostream &out,
+                       std::ostream &err, const Environment & /*env*/) {
+  if (args.size() > 2) {
+    err << "fg: too many arguments\n"
+        << "usage: fg [%job]\n";
+    return 2;
+  }
+  std::optional<int> id =
+      args.size() == 2 ? JobTable::parse_spec(args[1]) : jobs_.current();
+  if (!id) {
+    err << "fg: " << (args.size() == 2 ? args[1] + ": no such job"
+                                       : std::string("no current job"))
+        << '\n';
+    return 1;
+  }
+  for (const JobTable::Status &status : jobs_.list()) {
+    if (status.id == *id)
+      out << status.command << '\n' << std::flush;
+  }
+  std::optional<int> code = jobs_.wait(*id);
+  if (!code) {
+    err << "fg: " << (args.size() == 2 ? args[1] : "%" + std::to_string(*id))
+        << ": no such job\n";
+    return 1;
+  }
+  return *code;
+}
+
+} // namespace cli
@@ -1,175 +1,176 @@
 #include "cli/commands/grep_command.hpp"
-#include <CLI/CLI.hpp>
+#include "cli/commands/text_kernels.hpp"
 #include <algorithm>
-#include <fstream>
-#include <iterator>
-#include <regex>
-#include <sstream>
+#include <optional>
+#include <span>
 #include <string>
-#include <utility>
+#include <string_view>
 #include <vector>
 
 namespace cli {
 
 namespace {
 
-/// Merges overlapping [start, end] (inclusive) intervals; returns sorted
-/// non-overlapping ranges.
-std::vector<std::pair<std::size_t, std::size_t>>
-merge_ranges(std::vector<std::pair<std::size_t, std::size_t>> ranges) {
-  if (ranges.empty())
-    return {};
-  std::sort(ranges.begin(), ranges.end());
-  std::vector<std::pair<std::size_t, std::size_t>> out;
-  out.push_back(ranges[0]);
-  for (std::size_t i = 1; i < ranges.size(); ++i) {
-    if (ranges[i].first <= out.back().second + 1) {
-      out.back().second =
-          std::max(out.back().second, ranges[i].second);
-    } else {
-      out.push_back(ranges[i]);
+/// Runs grep on one source (file or stdin). Lines are split out of each
+/// chunk in place, and the lines selected from a chunk are written as one
+/// output chunk, each prefixed with `prefix`. Sets `stopped` once the
+/// consumer of `out` has finished. Returns true if any line matched.
+bool grep_source(ByteSource &in, const GrepOptions &options,
+                 const std::string &prefix, ByteSink &out, bool &stopped) {
+  LineSelector selector(options);
+  LineSplitter splitter;
+  std::string pending;
+  auto collect = [&](std::string_view line) {
+    if (selector.select(line)) {
+      pending += prefix;
+      pending += line;
+      pending += '\n';
     }
-  }
-  return out;
-}
-
-/// Reads lines from stream into a vector (each element is one line without
-/// trailing newline; empty stream => empty vector).
-std::vector<std::string> read_lines(std::istream &in) {
-  std::vector<std::string> lines;
-  std::string line;
-  while (std::getline(in, line))
-    lines.push_back(std::move(line));
-  return lines;
-}
-
-/// Runs grep on a single input: lines, regex, after_context. Fills
-/// line_ranges with [start, end] (inclusive) of lines to print; each line
-/// index is only in one range (merged).
-void find_matching_ranges(const std::vector<std::string> &lines,
-                         const std::regex &re,
-                         std::size_t after_context,
-                         std::vector<std::pair<std::size_t, std::size_t>> &line_ranges) {
-  line_ranges.clear();
-  for (std::size_t i = 0; i < lines.size(); ++i) {
-    if (std::regex_search(lines[i], re)) {
-      std::size_t end = std::min(i + after_context, lines.size() - 1);
-      line_ranges.push_back({i, end});
-    }
-  }
-  line_ranges = merge_ranges(std::move(line_ranges));
-}
-
-/// Prints lines in the given ranges to out. If show_filename is non-empty,
-/// each line is prefixed with "show_filename:".
-void print_ranges(const std::vector<std::string> &lines,
-                 const std::vector<std::pair<std::size_t, std::size_t>> &ranges,
-                 const std::string &show_filename,
-                 std::ostream &out) {
-  for (const auto &[start, end] : ranges) {
-    for (std::size_t i = start; i <= end; ++i) {
-      if (!show_filename.empty())
-        out << show_filename << ":";
-      out << lines[i] << "\n";
+  };
+  auto flush = [&] {
+    if (!pending.empty())
+      stopped = !out.write(pending);
+    pending.clear();
+  };
+  while (!stopped) {
+    std::span<const char> chunk = in.next();
+    if (chunk.empty()) {
+      splitter.finish(collect);
+      flush();
+      break;
     }
+    splitter.feed(selector, chunk.data(), chunk.size(), collect);
+    // Per chunk rather than at the end, so lines typed at a terminal are
+    // answered at once.
+    flush();
   }
-}
-
-/// Runs grep on one stream (file or stdin). Returns number of matching
-/// lines (for exit code: 0 if > 0, else 1).
-int grep_stream(std::istream &in, const std::regex &re,
-                std::size_t after_context, const std::string &filename,
-                std::ostream &out) {
-  std::vector<std::string> lines = read_lines(in);
-  std::vector<std::pair<std::size_t, std::size_t>> ranges;
-  find_matching_ranges(lines, re, after_context, ranges);
-  bool multiple = !filename.empty();
-  print_ranges(lines, ranges, multiple ? filename : "", out);
-  return ranges.empty() ? 0 : 1;
+  return selector.matched();
 }
 
 } // namespace
 
 int GrepCommand::execute(const std::vector<std::string> &args,
                          std::istream &in, std::ostream &out,
-                         std::ostream &err, const Environment &) {
-  if (args.size() < 2) {
-    err << "grep: missing pattern\n";
-    return 2;
-  }
-
-  CLI::App app("grep");
-  std::string pattern;
-  std::vector<std::string> files;
-  bool word_boundary = false;
-  bool ignore_case = false;
-  int after_context = 0;
-
-  app.add_option("pattern", pattern, "Regular expression to search for")
-      ->required();
-  app.add_option("files", files, "Input files (stdin if none)")
-      ->expected(-1);
-  app.add_flag("-w,--word-regexp", word_boundary,
-               "Match only whole words");
-  app.add_flag("-i,--ignore-case", ignore_case,
-               "Case-insensitive search");
-  app.add_option("-A,--after-context", after_context,
-                 "Print N lines after each match")
-      ->default_val(0)
-      ->check(CLI::NonNegativeNumber);
-
-  // CLI11 expects argv[0] to be the program name; pass full args so first
-  // positional is pattern, not the command name.
-  std::vector<std::string> argv_str(args.begin(), args.end());
-  std::vector<char *> argv_ptrs;
-  argv_ptrs.reserve(argv_str.size());
-  std::transform(argv_str.begin(), argv_str.end(),
-                 std::back_inserter(argv_ptrs),
-                 [](std::string &s) { return &s[0]; });
+                         std::ostream &err, const Environment &env) {
+  StreamByteSource source(in);
+  StreamByteSink sink(out);
+  return execute_chunks(args, source, sink, err, env);
+}
 
-  try {
-    app.parse(static_cast<int>(argv_ptrs.size()), argv_ptrs.data());
-  } catch (const CLI::ParseError &e) {
-    err << "grep: " << e.what() << "\n";
+int GrepCommand::execute_chunks(const std::vector<std::string> &args,
+                                ByteSource &in, ByteSink &out,
+                                std::ostream &err, const Environment &) {
+  std::optional<GrepOptions> options = parse_grep_options(args, err);
+  if (!options)
     return 2;
-  }
 
-  std::string regex_pattern = pattern;
-  if (word_boundary)
-    regex_pattern = "\\b(" + pattern + ")\\b";
+  bool had_match = false;
+  bool stopped = false;
+  if (options->files.empty()) {
+    had_match = grep_source(in, *options, "", out, stopped);
+  } else {
+    for (const std::string &path : options->files) {
+      FileByteSource f(path);
+      if (!f.is_open()) {
+        err << "grep: cannot open '" << path << "'\n";
+        return 2;
+      }
+      const std::string prefix =
+          options->files.size() > 1 ? path + ":" : std::string();
+      if (grep_source(f, *options, prefix, out, stopped))
+        had_match = true;
+      if (stopped)
+        break;
+    }
+  }
 
-  std::regex::flag_type flags = std::regex::ECMAScript;
-  if (ignore_case)
-    flags |= std::regex::icase;
+  return had_match ? 0 : 1;
+}
 
-  std::regex re;
-  try {
-    re.assign(regex_pattern, flags);
-  } catch (const std::regex_error &e) {
-    err << "grep: invalid regular expression: " << e.what() << "\n";
-    return 2;
+StageTask GrepCommand::run_stage(std::vector<std::string> args,
+                                 StageInput &in, StageOutput &out,
+                                 std::ostream &err, const Environment &,
+                                 int &exit_code) {
+  std::optional<GrepOptions> options = parse_grep_options(args, err);
+  if (!options) {
+    exit_code = 2;
+    co_return;
   }
 
-  const std::size_t after_n =
-      static_cast<std::size_t>(std::max(0, after_context));
-  int had_match = 0;
-
-  if (files.empty()) {
-    had_match = grep_stream(in, re, after_n, "", out);
+  bool had_match = false;
+  bool stopped = false;
+  std::string pending;
+
+  if (options->files.empty()) {
+    LineSelector selector(*options);
+    LineSplitter splitter;
+    auto collect = [&](std::string_view line) {
+      if (selector.select(line)) {
+        pending += line;
+        pending += '\n';
+      }
+    };
+    while (!stopped) {
+      std::optional<std::string> chunk = co_await in.next();
+      if (!chunk)
+        break;
+      splitter.feed(selector, chunk->data(), chunk->size(), collect);
+      if (pending.size() >= StageInput::kChunkSize) {
+        stopped = !co_await out.write(std::move(pending));
+        pending.clear();
+      }
+    }
+    if (!stopped)
+      splitter.finish(collect);
+    had_match = selector.matched();
   } else {
-    for (const std::string &path : files) {
-      std::ifstream f(path);
-      if (!f) {
+    for (const std::string &path : options->files) {
+      FileByteSource f(path);
+      if (!f.is_open()) {
+        if (!pending.empty())
+          co_await out.write(std::move(pending));
         err << "grep: cannot open '" << path << "'\n";
-        return 2;
+        exit_code = 2;
+        co_return;
       }
-      int m = grep_stream(f, re, after_n, files.size() > 1 ? path : "", out);
-      if (m)
-        had_match = 1;
+      const std::string prefix =
+          options->files.size() > 1 ? path + ":" : std::string();
+      LineSelector selector(*options);
+      LineSplitter splitter;
+      auto collect = [&](std::string_view line) {
+        if (selector.select(line)) {
+          pending += prefix;
+          pending += line;
+          pending += '\n';
+        }
+      };
+      for (std::span<const char> data = f.next(); !stopped && !data.empty();
+           data = f.next()) {
+        // Fed in pieces so that output chunks stay about kChunkSize even
+        // when the mapping hands out much larger slices.
+        for (std::size_t at = 0; !stopped && at < data.size();
+             at += StageInput::kChunkSize) {
+          splitter.feed(selector, data.data() + at,
+                        std::min(StageInput::kChunkSize, data.size() - at),
+                        collect);
+          if (pending.size() >= StageInput::kChunkSize) {
+            stopped = !co_await out.write(std::move(pending));
+            pending.clear();
+          }
+        }
+      }
+      if (!stopped)
+        splitter.finish(collect);
+      if (selector.matched())
+        had_match = true;
+      if (stopped)
+        break;
     }
   }
 
-  return had_match ? 0 : 1;
+  if (!stopped && !pending.empty())
+    co_await out.write(std::move(pending));
+  exit_code = had_match ? 0 : 1;
 }
 
 } // namespace cli
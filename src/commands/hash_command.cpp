@@ -0,0 +1,35 @@
+#include "cli/commands/hash_command.hpp"
+
+namespace cli {
+
+int HashCommand::execute(const std::vector<std::string> &args,
+                         std::istream & /*in*/, std::ostream &out,
+                         std::ostream &err, const Environment &env) {
+  std::size_t i = 1;
+  for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+    if (args[i] != "-r") {
+      err << "hash: invalid option '" << args[i] << "'\n"
+          << "usage: hash [-r] [name ...]\n";
+      return 2;
+    }
+    paths_.clear();
+  }
+  if (args.size() == 1) {
+    auto entries = paths_.entries();
+    if (entries.empty())
+      out << "hash: hash table empty\n";
+    for (const auto &[name, path] : entries)
+      out << name << '\t' << (path.empty() ? "(not found)" : path) << '\n';
+    return 0;
+  }
+  int code = 0;
+  for (; i < args.size(); ++i) {
+    if (paths_.resolve(env, args[i]) == args[i]) {
+      err << "hash: " << args[i] << ": not found\n";
+      code = 1;
+    }
+  }
+  return code;
+}
+
+} // namespace cli
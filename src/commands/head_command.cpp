@@ -0,0 +1,202 @@
+#include "cli/commands/head_command.hpp"
+#include "cli/pipe_channel.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cli {
+
+namespace {
+
+/// What head keeps of each input.
+struct HeadLimit {
+  /// Count bytes (`-c`) rather than lines (`-n`).
+  bool bytes{false};
+  /// Print all but the last `count` units (`-n -N`, `-c -N`).
+  bool all_but_last{false};
+  std::size_t count{10};
+};
+
+/** Parses a count for `-n` or `-c`: digits, optionally after '-' for "all
+ * but the last N". */
+std::optional<HeadLimit> parse_limit(const std::string &value, bool bytes) {
+  HeadLimit limit;
+  limit.bytes = bytes;
+  std::string digits = value;
+  if (!digits.empty() && digits[0] == '-') {
+    limit.all_but_last = true;
+    digits.erase(0, 1);
+  }
+  if (digits.empty() ||
+      digits.find_first_not_of("0123456789") != std::string::npos)
+    return std::nullopt;
+  limit.count = static_cast<std::size_t>(std::strtoull(digits.c_str(),
+                                                       nullptr, 10));
+  return limit;
+}
+
+/// Copies the first `count` lines of `in` to `out`, keeping a missing
+/// trailing newline missing.
+void head_lines(std::istream &in, std::size_t count, std::ostream &out) {
+  std::string line;
+  for (std::size_t i = 0; i < count && std::getline(in, line); ++i) {
+    out << line;
+    if (!in.eof())
+      out << '\n';
+    if (output_closed(out))
+      break;
+  }
+}
+
+/// Copies all lines of `in` but the last `count` to `out`.
+void head_lines_but_last(std::istream &in, std::size_t count,
+                         std::ostream &out) {
+  std::deque<std::string> held;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!in.eof())
+      line += '\n';
+    held.push_back(std::move(line));
+    if (held.size() > count) {
+      out << held.front();
+      held.pop_front();
+      if (output_closed(out))
+        break;
+    }
+  }
+}
+
+/// Copies the first `count` bytes of `in` to `out`.
+void head_bytes(std::istream &in, std::size_t count, std::ostream &out) {
+  char buf[65536];
+  while (count > 0 && !output_closed(out)) {
+    in.read(buf, static_cast<std::streamsize>(std::min(count, sizeof buf)));
+    const std::size_t n = static_cast<std::size_t>(in.gcount());
+    if (n == 0)
+      break;
+    out.write(buf, static_cast<std::streamsize>(n));
+    count -= n;
+  }
+}
+
+/// Copies all bytes of `in` but the last `count` to `out`.
+void head_bytes_but_last(std::istream &in, std::size_t count,
+                         std::ostream &out) {
+  char buf[65536];
+  std::string held;
+  while (!output_closed(out)) {
+    in.read(buf, sizeof buf);
+    const std::size_t n = static_cast<std::size_t>(in.gcount());
+    if (n == 0)
+      break;
+    held.append(buf, n);
+    if (held.size() > count) {
+      out.write(held.data(),
+                static_cast<std::streamsize>(held.size() - count));
+      held.erase(0, held.size() - count);
+    }
+  }
+}
+
+/// Copies the part of `in` that `limit` selects to `out`.
+void head_stream(std::istream &in, const HeadLimit &limit, std::ostream &out) {
+  if (limit.bytes && limit.all_but_last)
+    head_bytes_but_last(in, limit.count, out);
+  else if (limit.bytes)
+    head_bytes(in, limit.count, out);
+  else if (limit.all_but_last)
+    head_lines_but_last(in, limit.count, out);
+  else
+    head_lines(in, limit.count, out);
+}
+
+int usage(std::ostream &err, const std::string &message) {
+  err << "head: " << message << '\n'
+      << "usage: head [-n [-]N | -c [-]N | -N] [file...]\n";
+  return 2;
+}
+
+} // namespace
+
+int HeadCommand::execute(const std::vector<std::string> &args,
+                         std::istream &in, std::ostream &out,
+                         std::ostream &err, const Environment & /*env*/) {
+  HeadLimit limit;
+  std::vector<std::string> files;
+  bool options_done = false;
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    const std::string &arg = args[i];
+    if (options_done || arg.size() < 2 || arg[0] != '-') {
+      files.push_back(arg);
+      continue;
+    }
+    if (arg == "--") {
+      options_done = true;
+      continue;
+    }
+    // -n N, -nN, --lines=N, --lines N and the same for -c/--bytes; -N is
+    // short for -n N.
+    std::string value;
+    bool bytes = false;
+    if (arg[1] >= '0' && arg[1] <= '9') {
+      value = arg.substr(1);
+    } else if (arg[1] == 'n' || arg[1] == 'c') {
+      bytes = arg[1] == 'c';
+      value = arg.substr(2);
+      if (value.empty()) {
+        if (i + 1 >= args.size())
+          return usage(err, "option '" + arg + "' requires an argument");
+        value = args[++i];
+      }
+    } else if (arg.starts_with("--lines") || arg.starts_with("--bytes")) {
+      bytes = arg.starts_with("--bytes");
+      if (arg.size() > 7 && arg[7] == '=') {
+        value = arg.substr(8);
+      } else if (arg.size() == 7 && i + 1 < args.size()) {
+        value = args[++i];
+      } else {
+        return usage(err, "invalid option '" + arg + "'");
+      }
+    } else {
+      return usage(err, "invalid option '" + arg + "'");
+    }
+    std::optional<HeadLimit> parsed = parse_limit(value, bytes);
+    if (!parsed)
+      return usage(err, std::string("invalid number of ") +
+                            (bytes ? "bytes" : "lines") + " '" + value +
+                            "'");
+    limit = *parsed;
+  }
+
+  if (files.empty()) {
+    head_stream(in, limit, out);
+    close_input(in);
+    return 0;
+  }
+
+  int code = 0;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    std::ifstream f;
+    if (files[i] != "-") {
+      f.open(files[i], std::ios::binary);
+      if (!f) {
+        err << "head: cannot open '" << files[i] << "'\n";
+        code = 1;
+        continue;
+      }
+    }
+    if (files.size() > 1)
+      out << (i > 0 ? "\n" : "") << "==> "
+          << (files[i] == "-" ? "standard input" : files[i]) << " <==\n";
+    head_stream(f.is_open() ? f : in, limit, out);
+    if (output_closed(out))
+      break;
+  }
+  return code;
+}
+
+} // namespace cli
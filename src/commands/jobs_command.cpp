@@ -0,0 +1,18 @@
+#include "cli/commands/jobs_command.hpp"
+
+namespace cli {
+
+int JobsCommand::execute(const std::vector<std::string> &args,
+                         std::istream & /*in*/, std::ostream &out,
+                         std::ostream &err, const Environment & /*env*/) {
+  if (args.size() > 1) {
+    err << "jobs: too many arguments\n"
+        << "usage: jobs\n";
+    return 2;
+  }
+  for (const JobTable::Status &status : jobs_.list(true))
+    out << JobTable::describe(status) << '\n';
+  return 0;
+}
+
+} // namespace cli
@@ -0,0 +1,200 @@
+#include "cli/commands/parallel_command.hpp"
+#include "cli/pipe_channel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace cli {
+
+namespace {
+
+/// Exit status cap, as in GNU parallel: the count of failed commands.
+constexpr int kMaxFailures = 101;
+
+/// Exit status for invalid usage, as in GNU parallel; above any failure
+/// count.
+constexpr int kUsageError = 255;
+
+/// Collected output of one command.
+struct Result {
+  std::string out;
+  std::string err;
+  int code{0};
+  bool done{false};
+};
+
+/** The command for one item: `{}` replaced by `item` in every word, or
+ * `item` appended if no word contains `{}`. Words are not expanded again. */
+Pipeline instantiate(const std::vector<std::string> &words,
+                     const std::string &item) {
+  CommandNode node;
+  bool replaced = false;
+  for (std::size_t w = 0; w < words.size(); ++w) {
+    std::string word = words[w];
+    for (std::size_t pos = 0;
+         (pos = word.find("{}", pos)) != std::string::npos;
+         pos += item.size()) {
+      word.replace(pos, 2, item);
+      replaced = true;
+    }
+    if (w == 0) {
+      node.name = std::move(word);
+      node.substitute_name = Substitute::No;
+    } else {
+      node.args.push_back(std::move(word));
+      node.substitute_arg.push_back(Substitute::No);
+    }
+  }
+  if (!replaced) {
+    node.args.push_back(item);
+    node.substitute_arg.push_back(Substitute::No);
+  }
+  return {std::move(node)};
+}
+
+/** Parses a positive job count; 0 if `value` is not one. */
+std::size_t parse_jobs(const std::string &value) {
+  char *end = nullptr;
+  unsigned long n = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || *end != '\0' || value[0] == '-')
+    return 0;
+  return static_cast<std::size_t>(n);
+}
+
+int usage(std::ostream &err, const std::string &message) {
+  err << "parallel: " << message << '\n'
+      << "usage: parallel [-j N] [-k | -u] command [args...] "
+         "[::: items...]\n";
+  return kUsageError;
+}
+
+} // namespace
+
+std::size_t ParallelCommand::default_jobs() const {
+  if (pool_)
+    return pool_->size();
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int ParallelCommand::execute(const std::vector<std::string> &args,
+                             std::istream &in, std::ostream &out,
+                             std::ostream &err, const Environment &env) {
+  std::size_t jobs = default_jobs();
+  bool ordered = true;
+  std::size_t i = 1;
+  for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+    const std::string &option = args[i];
+    if (option == "-k") {
+      ordered = true;
+    } else if (option == "-u") {
+      ordered = false;
+    } else if (option.compare(0, 2, "-j") == 0) {
+      std::string value = option.substr(2);
+      if (value.empty() && i + 1 < args.size())
+        value = args[++i];
+      jobs = parse_jobs(value);
+      if (jobs == 0)
+        return usage(err, "invalid job count '" + value + "'");
+    } else {
+      return usage(err, "invalid option '" + option + "'");
+    }
+  }
+  const auto separator = std::find(args.begin() + i, args.end(), ":::");
+  const std::vector<std::string> words(args.begin() + i, separator);
+  if (words.empty())
+    return usage(err, "missing command");
+
+  std::vector<std::string> items;
+  if (separator != args.end()) {
+    items.assign(separator + 1, args.end());
+  } else {
+    std::string line;
+    while (std::getline(in, line))
+      items.push_back(std::move(line));
+  }
+  if (items.empty())
+    return 0;
+
+  std::vector<Result> results(items.size());
+  std::deque<std::size_t> finished;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> stop{false};
+
+  auto runner = [&] {
+    while (!stop) {
+      const std::size_t k = next++;
+      if (k >= items.size())
+        break;
+      Result result;
+      std::istringstream no_input;
+      std::ostringstream job_out;
+      std::ostringstream job_err;
+      try {
+        result.code = executor_
+                          .execute(instantiate(words, items[k]), no_input,
+                                   job_out, job_err, env)
+                          .exit_code;
+      } catch (const std::exception &e) {
+        job_err << "parallel: " << e.what() << '\n';
+        result.code = 1;
+      } catch (...) {
+        // Escaping the task would leave the result undone and the writer
+        // below waiting for it forever.
+        job_err << "parallel: unknown error\n";
+        result.code = 1;
+      }
+      result.out = std::move(job_out).str();
+      result.err = std::move(job_err).str();
+      result.done = true;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[k] = std::move(result);
+        finished.push_back(k);
+      }
+      ready.notify_one();
+    }
+  };
+  std::vector<TaskHandle> runners;
+  const std::size_t count = std::min(jobs, items.size());
+  runners.reserve(count);
+  for (std::size_t r = 0; r < count; ++r)
+    runners.push_back(run_concurrently(pool_, runner));
+
+  // Write results on this thread as they become available.
+  int failures = 0;
+  std::size_t next_in_order = 0;
+  for (std::size_t written = 0; written < items.size() && !stop; ++written) {
+    Result result;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [&] {
+        return ordered ? results[next_in_order].done : !finished.empty();
+      });
+      std::size_t k = next_in_order++;
+      if (!ordered) {
+        k = finished.front();
+        finished.pop_front();
+      }
+      result = std::move(results[k]);
+    }
+    out << result.out;
+    err << result.err;
+    if (result.code != 0)
+      failures = std::min(failures + 1, kMaxFailures);
+    if (output_closed(out))
+      stop = true;
+  }
+  stop = true;
+  for (TaskHandle &handle : runners)
+    handle.wait();
+  return failures;
+}
+
+} // namespace cli
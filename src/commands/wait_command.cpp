@@ -0,0 +1,26 @@
+#include "cli/commands/wait_command.hpp"
+
+namespace cli {
+
+int WaitCommand::execute(const std::vector<std::string> &args,
+                         std::istream & /*in*/, std::ostream & /*out*/,
+                         std::ostream &err, const Environment & /*env*/) {
+  if (args.size() == 1) {
+    jobs_.wait_all();
+    return 0;
+  }
+  int code = 0;
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    std::optional<int> id = JobTable::parse_spec(args[i]);
+    std::optional<int> job_code = id ? jobs_.wait(*id) : std::nullopt;
+    if (!job_code) {
+      err << "wait: " << args[i] << ": no such job\n";
+      code = 127;
+    } else {
+      code = *job_code;
+    }
+  }
+  return code;
+}
+
+} // namespace cli
@@ -1,53 +1,71 @@
 #include "cli/commands/wc_command.hpp"
-#include <cctype>
-#include <fstream>
+#include "cli/commands/text_kernels.hpp"
+#include <span>
 
 namespace cli {
 
 namespace {
 
-void count_stream(std::istream &in, unsigned long &lines, unsigned long &words,
-                  unsigned long &bytes) {
-  lines = words = bytes = 0;
-  bool in_word = false;
-  char c;
-  while (in.get(c)) {
-    ++bytes;
-    if (c == '\n')
-      ++lines;
-    if (std::isspace(static_cast<unsigned char>(c)))
-      in_word = false;
-    else {
-      if (!in_word)
-        ++words;
-      in_word = true;
-    }
-  }
+WcCounts count_source(ByteSource &in) {
+  WcCounts counts;
+  for (std::span<const char> chunk = in.next(); !chunk.empty();
+       chunk = in.next())
+    counts.add(chunk.data(), chunk.size());
+  return counts;
 }
 
 } // namespace
 
 int WcCommand::execute(const std::vector<std::string> &args, std::istream &in,
                        std::ostream &out, std::ostream &err,
-                       const Environment & /*env*/) {
-  if (args.size() < 2) {
-    unsigned long lines = 0, words = 0, bytes = 0;
-    count_stream(in, lines, words, bytes);
-    out << " " << lines << " " << words << " " << bytes << "\n";
-    return 0;
-  }
+                       const Environment &env) {
+  StreamByteSource source(in);
+  StreamByteSink sink(out);
+  return execute_chunks(args, source, sink, err, env);
+}
+
+int WcCommand::execute_chunks(const std::vector<std::string> &args,
+                              ByteSource &in, ByteSink &out,
+                              std::ostream &err, const Environment & /*env*/) {
+  // A refused write means the counts never reached anyone.
+  if (args.size() < 2)
+    return out.write(count_source(in).format("")) ? 0 : 1;
   for (std::size_t i = 1; i < args.size(); ++i) {
-    std::ifstream f(args[i], std::ios::binary);
-    if (!f) {
+    FileByteSource f(args[i]);
+    if (!f.is_open()) {
       err << "wc: cannot open '" << args[i] << "'\n";
       return 1;
     }
-    unsigned long lines = 0, words = 0, bytes = 0;
-    count_stream(f, lines, words, bytes);
-    out << " " << lines << " " << words << " " << bytes << " " << args[i]
-        << "\n";
+    if (!out.write(count_source(f).format(args[i])))
+      return 1;
   }
   return 0;
 }
 
+StageTask WcCommand::run_stage(std::vector<std::string> args, StageInput &in,
+                               StageOutput &out, std::ostream &err,
+                               const Environment & /*env*/, int &exit_code) {
+  exit_code = 0;
+  if (args.size() < 2) {
+    WcCounts counts;
+    while (auto chunk = co_await in.next())
+      counts.add(chunk->data(), chunk->size());
+    if (!co_await out.write(counts.format("")))
+      exit_code = 1;
+    co_return;
+  }
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    FileByteSource f(args[i]);
+    if (!f.is_open()) {
+      err << "wc: cannot open '" << args[i] << "'\n";
+      exit_code = 1;
+      co_return;
+    }
+    if (!co_await out.write(count_source(f).format(args[i]))) {
+      exit_code = 1;
+      co_return;
+    }
+  }
+}
+
 } // namespace cli
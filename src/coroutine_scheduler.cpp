@@ -0,0 +1,165 @@
+#include "cli/coroutine_scheduler.hpp"
+#include "cli/pipe_channel.hpp"
+#include <algorithm>
+
+namespace cli {
+
+void CoroutineScheduler::spawn(StageTask task) {
+  ready_.push_back(task.handle());
+  tasks_.push_back(std::move(task));
+}
+
+void CoroutineScheduler::schedule(std::coroutine_handle<> handle) {
+  ready_.push_back(handle);
+}
+
+bool CoroutineScheduler::run() {
+  while (!ready_.empty()) {
+    std::coroutine_handle<> handle = ready_.front();
+    ready_.pop_front();
+    ++switches_;
+    handle.resume();
+  }
+  const bool finished =
+      std::all_of(tasks_.begin(), tasks_.end(),
+                  [](const StageTask &task) { return task.done(); });
+  std::exception_ptr failure;
+  for (const StageTask &task : tasks_) {
+    try {
+      task.rethrow_if_failed();
+    } catch (...) {
+      failure = std::current_exception();
+      break;
+    }
+  }
+  tasks_.clear();
+  if (failure)
+    std::rethrow_exception(failure);
+  return finished;
+}
+
+ChunkPipe::ChunkPipe(CoroutineScheduler &scheduler, std::size_t capacity)
+    : scheduler_(scheduler), capacity_(std::max<std::size_t>(capacity, 1)) {}
+
+void ChunkPipe::wake(std::coroutine_handle<> &waiter) {
+  if (waiter) {
+    scheduler_.schedule(waiter);
+    waiter = nullptr;
+  }
+}
+
+bool ChunkPipe::PushAwaiter::await_ready() const noexcept {
+  return pipe.read_closed_ || pipe.chunks_.size() < pipe.capacity_;
+}
+
+void ChunkPipe::PushAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  pipe.waiting_writer_ = h;
+}
+
+bool ChunkPipe::PushAwaiter::await_resume() {
+  if (pipe.read_closed_)
+    return false;
+  pipe.chunks_.push_back(std::move(chunk));
+  pipe.wake(pipe.waiting_reader_);
+  return true;
+}
+
+bool ChunkPipe::PopAwaiter::await_ready() const noexcept {
+  return !pipe.chunks_.empty() || pipe.write_closed_ || pipe.read_closed_;
+}
+
+void ChunkPipe::PopAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  pipe.waiting_reader_ = h;
+}
+
+std::optional<std::string> ChunkPipe::PopAwaiter::await_resume() {
+  if (pipe.chunks_.empty())
+    return std::nullopt;
+  std::string chunk = std::move(pipe.chunks_.front());
+  pipe.chunks_.pop_front();
+  pipe.wake(pipe.waiting_writer_);
+  return chunk;
+}
+
+void ChunkPipe::close_write() {
+  write_closed_ = true;
+  wake(waiting_reader_);
+}
+
+void ChunkPipe::close_read() {
+  read_closed_ = true;
+  chunks_.clear();
+  wake(waiting_writer_);
+}
+
+StageInput::NextAwaiter StageInput::next() {
+  NextAwaiter awaiter{*this, std::nullopt};
+  if (pipe_)
+    awaiter.pop.emplace(pipe_->pop());
+  return awaiter;
+}
+
+bool StageInput::NextAwaiter::await_ready() const noexcept {
+  return !pop || pop->await_ready();
+}
+
+void StageInput::NextAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+  pop->await_suspend(h);
+}
+
+std::optional<std::string> StageInput::NextAwaiter::await_resume() {
+  if (pop)
+    return pop->await_resume();
+  std::string chunk(kChunkSize, '\0');
+  input.stream_->read(chunk.data(), static_cast<std::streamsize>(kChunkSize));
+  const std::size_t n = static_cast<std::size_t>(input.stream_->gcount());
+  if (n == 0)
+    return std::nullopt;
+  chunk.resize(n);
+  return chunk;
+}
+
+void StageInput::close() {
+  if (pipe_)
+    pipe_->close_read();
+  else
+    close_input(*stream_);
+}
+
+StageOutput::WriteAwaiter StageOutput::write(std::string chunk) {
+  WriteAwaiter awaiter{*this, std::nullopt, {}};
+  if (pipe_)
+    awaiter.push.emplace(pipe_->push(std::move(chunk)));
+  else
+    awaiter.chunk = std::move(chunk);
+  return awaiter;
+}
+
+bool StageOutput::WriteAwaiter::await_ready() const noexcept {
+  return !push || push->await_ready();
+}
+
+void StageOutput::WriteAwaiter::await_suspend(
+    std::coroutine_handle<> h) noexcept {
+  push->await_suspend(h);
+}
+
+bool StageOutput::WriteAwaiter::await_resume() {
+  if (push)
+    return push->await_resume();
+  output.stream_->write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+  return !output_closed(*output.stream_);
+}
+
+bool StageOutput::closed() const {
+  return pipe_ ? pipe_->read_closed() : output_closed(*stream_);
+}
+
+void StageOutput::close() {
+  if (pipe_)
+    pipe_->close_write();
+  else
+    stream_->flush();
+}
+
+} // namespace cli
@@ -1,4 +1,5 @@
 #include "cli/environment.hpp"
+#include <cstring>
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -17,6 +18,18 @@ namespace cli {
 
 Environment::Environment() = default;
 
+Environment::Environment(const Environment &other) {
+  reserve(other.size());
+  for (const auto &[name, var] : other.vars_)
+    set(name, var.value);
+}
+
+Environment &Environment::operator=(const Environment &other) {
+  if (this != &other)
+    *this = Environment(other);
+  return *this;
+}
+
 void Environment::init_from_current() {
 #ifdef _WIN32
   LPSTR env = GetEnvironmentStringsA();
@@ -29,21 +42,19 @@ void Environment::init_from_current() {
     ++p;
     std::size_t eq = line.find('=');
     if (eq != std::string::npos) {
-      std::string key = line.substr(0, eq);
-      std::string val = line.substr(eq + 1);
-      vars_[key] = val;
+      set(line.substr(0, eq), line.substr(eq + 1));
     }
   }
   FreeEnvironmentStringsA(env);
 #else
+  std::size_t count = 0;
+  for (char **p = ::environ; p && *p; ++p)
+    ++count;
+  reserve(count);
   for (char **p = ::environ; p && *p; ++p) {
-    std::string line(*p);
-    std::size_t eq = line.find('=');
-    if (eq != std::string::npos) {
-      std::string key = line.substr(0, eq);
-      std::string val = line.substr(eq + 1);
-      vars_[key] = val;
-    }
+    const char *eq = std::strchr(*p, '=');
+    if (eq)
+      set(std::string(*p, static_cast<std::size_t>(eq - *p)), eq + 1);
   }
 #endif
 }
@@ -52,7 +63,7 @@ std::string Environment::get(const std::string &name) const {
   auto it = vars_.find(name);
   if (it == vars_.end())
     return "";
-  return it->second;
+  return it->second.value;
 }
 
 namespace {
@@ -67,20 +78,90 @@ bool is_var_char(char c, bool first) {
 } // namespace
 
 std::string Environment::substitute(const std::string &s) const {
-  std::string out;
-  out.reserve(s.size());
-  const std::size_t n = s.size();
+  return SubstitutionTemplate(s).expand(*this);
+}
+
+void Environment::set(const std::string &name, const std::string &value) {
+  auto [it, inserted] = vars_.try_emplace(name, Var{value, entries_.size()});
+  if (inserted) {
+    entries_.emplace_back();
+    slot_names_.push_back(&it->first);
+    envp_.push_back(nullptr);
+  } else {
+    it->second.value = value;
+  }
+  write_entry(it->second.slot, name, value);
+}
+
+void Environment::unset(const std::string &name) {
+  auto it = vars_.find(name);
+  if (it == vars_.end())
+    return;
+  // Move the last entry into the freed slot.
+  const std::size_t slot = it->second.slot;
+  const std::size_t last = entries_.size() - 1;
+  if (slot != last) {
+    entries_[slot] = std::move(entries_[last]);
+    slot_names_[slot] = slot_names_[last];
+    envp_[slot] = envp_[last];
+    vars_.find(*slot_names_[slot])->second.slot = slot;
+  }
+  entries_.pop_back();
+  slot_names_.pop_back();
+  envp_.pop_back();
+  envp_.back() = nullptr;
+  vars_.erase(it);
+}
+
+void Environment::reserve(std::size_t count) {
+  vars_.reserve(vars_.size() + count);
+  entries_.reserve(entries_.size() + count);
+  slot_names_.reserve(slot_names_.size() + count);
+  envp_.reserve(envp_.size() + count);
+}
+
+void Environment::write_entry(std::size_t slot, const std::string &name,
+                              const std::string &value) {
+  auto entry = std::make_unique<char[]>(name.size() + value.size() + 2);
+  std::memcpy(entry.get(), name.data(), name.size());
+  entry[name.size()] = '=';
+  std::memcpy(entry.get() + name.size() + 1, value.data(), value.size());
+  entry[name.size() + 1 + value.size()] = '\0';
+  envp_[slot] = entry.get();
+  entries_[slot] = std::move(entry);
+}
+
+std::vector<std::string> Environment::to_env_vector() const {
+  std::vector<std::string> out;
+  out.reserve(vars_.size());
+  for (const auto &[k, v] : vars_)
+    out.push_back(k + "=" + v.value);
+  return out;
+}
+
+SubstitutionTemplate::SubstitutionTemplate(const std::string &s,
+                                           bool substitute) {
+  std::string literal;
+  auto add_variable = [&](std::string name) {
+    if (!literal.empty())
+      segments_.push_back(Segment{std::move(literal), false});
+    literal.clear();
+    segments_.push_back(Segment{std::move(name), true});
+  };
+  const std::size_t n = substitute ? s.size() : 0;
+  if (!substitute)
+    literal = s;
   for (std::size_t i = 0; i < n; ++i) {
     if (s[i] != '$') {
-      out += s[i];
+      literal += s[i];
       continue;
     }
     if (i + 1 >= n) {
-      out += '$';
+      literal += '$';
       continue;
     }
     if (s[i + 1] == '$') {
-      out += '$';
+      literal += '$';
       ++i;
       continue;
     }
@@ -88,12 +169,11 @@ std::string Environment::substitute(const std::string &s) const {
       std::size_t j = i + 2;
       while (j < n && s[j] != '}')
         ++j;
-      std::string name = s.substr(i + 2, j - (i + 2));
       if (j < n) {
-        out += get(name);
+        add_variable(s.substr(i + 2, j - (i + 2)));
         i = j;
       } else {
-        out += s.substr(i);
+        literal += s.substr(i);
         break;
       }
       continue;
@@ -102,28 +182,36 @@ std::string Environment::substitute(const std::string &s) const {
       std::size_t j = i + 1;
       while (j < n && is_var_char(s[j], j == i + 1))
         ++j;
-      std::string name = s.substr(i + 1, j - (i + 1));
-      out += get(name);
+      add_variable(s.substr(i + 1, j - (i + 1)));
       i = j - 1;
       continue;
     }
-    out += '$';
+    literal += '$';
   }
-  return out;
+  if (!literal.empty())
+    segments_.push_back(Segment{std::move(literal), false});
 }
 
-void Environment::set(const std::string &name, const std::string &value) {
-  vars_[name] = value;
+std::string SubstitutionTemplate::expand(const Environment &env) const {
+  if (segments_.size() == 1 && !segments_[0].variable)
+    return segments_[0].text;
+  std::string out;
+  for (const Segment &segment : segments_)
+    out += segment.variable ? env.get(segment.text) : segment.text;
+  return out;
 }
 
-void Environment::unset(const std::string &name) { vars_.erase(name); }
+bool SubstitutionTemplate::is_literal() const {
+  for (const Segment &segment : segments_) {
+    if (segment.variable)
+      return false;
+  }
+  return true;
+}
 
-std::vector<std::string> Environment::to_env_vector() const {
-  std::vector<std::string> out;
-  out.reserve(vars_.size());
-  for (const auto &[k, v] : vars_)
-    out.push_back(k + "=" + v);
-  return out;
+std::string SubstitutionTemplate::literal() const {
+  return is_literal() && !segments_.empty() ? segments_[0].text
+                                            : std::string();
 }
 
 } // namespace cli
@@ -0,0 +1,273 @@
+#include "cli/execution_plan.hpp"
+#include "cli/external_command.hpp"
+#include "cli/parser.hpp"
+
+namespace cli {
+
+namespace {
+
+/** Looks `name` up in `PATH`, through `paths` if there is one. */
+std::string lookup(PathCache *paths, const Environment &env,
+                   const std::string &name) {
+  return paths ? paths->resolve(env, name)
+               : ExternalCommand::resolve(env, name);
+}
+
+/** Returns true if s looks like VAR=value (valid identifier before =). */
+bool is_assignment(const std::string &s) {
+  if (s.empty())
+    return false;
+  std::size_t eq = s.find('=');
+  if (eq == std::string::npos || eq == 0)
+    return false;
+  for (std::size_t i = 0; i < eq; ++i) {
+    char c = s[i];
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+              (i > 0 && (c >= '0' && c <= '9'));
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+/** Strip leading VAR=value words from the first command into `out`.
+ * Mutates pipeline. */
+void take_assignments(Pipeline &pipeline,
+                      std::vector<ExecutionPlan::Assignment> &out) {
+  if (pipeline.empty())
+    return;
+  CommandNode &first = pipeline[0];
+  std::vector<std::string> new_args;
+  std::vector<Substitute> new_sub;
+  bool name_consumed = false;
+  auto take = [&](const std::string &token, Substitute sub) {
+    if (!name_consumed) {
+      if (is_assignment(token)) {
+        std::size_t eq = token.find('=');
+        out.push_back(ExecutionPlan::Assignment{
+            token.substr(0, eq),
+            SubstitutionTemplate(token.substr(eq + 1),
+                                 sub == Substitute::Yes)});
+        return;
+      }
+      name_consumed = true;
+      first.name = token;
+      first.substitute_name = sub;
+      return;
+    }
+    new_args.push_back(token);
+    new_sub.push_back(sub);
+  };
+  take(first.name, first.substitute_name);
+  for (std::size_t i = 0; i < first.args.size(); ++i) {
+    Substitute sub = (i < first.substitute_arg.size()) ? first.substitute_arg[i]
+                                                       : Substitute::Yes;
+    take(first.args[i], sub);
+  }
+  first.args = std::move(new_args);
+  first.substitute_arg = std::move(new_sub);
+  if (!name_consumed)
+    first.name.clear();
+}
+
+/** Removes a leading unquoted `time` word followed by a command; returns
+ * whether there was one. */
+bool take_time_prefix(Pipeline &pipeline) {
+  if (pipeline.empty() || pipeline[0].name != "time" ||
+      pipeline[0].substitute_name != Substitute::Yes ||
+      pipeline[0].args.empty())
+    return false;
+  CommandNode &first = pipeline[0];
+  first.name = std::move(first.args.front());
+  first.args.erase(first.args.begin());
+  if (first.substitute_arg.empty()) {
+    first.substitute_name = Substitute::Yes;
+  } else {
+    first.substitute_name = first.substitute_arg.front();
+    first.substitute_arg.erase(first.substitute_arg.begin());
+  }
+  return true;
+}
+
+/** Remove leading commands that have empty name (after assignment stripping).
+ */
+void drop_empty_leading_commands(Pipeline &pipeline) {
+  while (!pipeline.empty() && pipeline.front().name.empty() &&
+         pipeline.front().args.empty()) {
+    pipeline.erase(pipeline.begin());
+  }
+}
+
+/** Spelling of `op` for error messages. */
+const char *list_operator_token(ListOperator op) {
+  switch (op) {
+  case ListOperator::And:
+    return "&&";
+  case ListOperator::Or:
+    return "||";
+  case ListOperator::Sequence:
+    break;
+  }
+  return ";";
+}
+
+/** Message for the first pipeline of `list` that may not be empty, or an
+ * empty string if there is none. Only the item after the last `;` may be
+ * empty. */
+std::string list_syntax_error(const CommandList &list) {
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    if (!list[i].pipeline.empty())
+      continue;
+    if (i + 1 < list.size())
+      return std::string("syntax error near `") +
+             list_operator_token(list[i + 1].op) + "'";
+    if (list[i].op != ListOperator::Sequence)
+      return std::string("syntax error: nothing after `") +
+             list_operator_token(list[i].op) + "'";
+  }
+  return {};
+}
+
+} // namespace
+
+ExecutionPlan ExecutionPlan::from_pipeline(const Pipeline &pipeline) {
+  ExecutionPlan plan;
+  plan.stages_.reserve(pipeline.size());
+  for (const CommandNode &node : pipeline) {
+    Stage stage;
+    stage.name = SubstitutionTemplate(node.name,
+                                      node.substitute_name == Substitute::Yes);
+    stage.args.reserve(node.args.size());
+    for (std::size_t i = 0; i < node.args.size(); ++i) {
+      bool sub = (i < node.substitute_arg.size())
+                     ? (node.substitute_arg[i] == Substitute::Yes)
+                     : true;
+      stage.args.emplace_back(node.args[i], sub);
+    }
+    plan.stages_.push_back(std::move(stage));
+  }
+  return plan;
+}
+
+ExecutionPlan ExecutionPlan::compile_pipeline(Pipeline &pipeline) {
+  std::vector<Assignment> assignments;
+  const bool timed = take_time_prefix(pipeline);
+  take_assignments(pipeline, assignments);
+  drop_empty_leading_commands(pipeline);
+  ExecutionPlan plan = from_pipeline(pipeline);
+  plan.assignments_ = std::move(assignments);
+  plan.timed_ = timed;
+  return plan;
+}
+
+ExecutionPlan ExecutionPlan::compile(const std::string &line) {
+  bool background = false;
+  std::optional<CommandList> list = Parser::parse_list(line, background);
+  if (!list)
+    return ExecutionPlan{};
+  ExecutionPlan plan;
+  plan.syntax_error_ = list_syntax_error(*list);
+  if (!plan.syntax_error_.empty())
+    return plan;
+  plan = compile_pipeline(list->front().pipeline);
+  plan.background_ = background;
+  for (std::size_t i = 1; i < list->size(); ++i) {
+    ListItem &item = (*list)[i];
+    if (item.pipeline.empty()) // after a trailing `;`
+      continue;
+    plan.rest_.push_back(ListStep{item.op, compile_pipeline(item.pipeline)});
+  }
+  return plan;
+}
+
+void ExecutionPlan::apply_assignments(Environment &env) const {
+  for (const Assignment &assignment : assignments_)
+    env.set(assignment.name, assignment.value.expand(env));
+}
+
+void ExecutionPlan::refresh_resolutions(const CommandRegistry &registry,
+                                        const Environment &env,
+                                        PathCache *paths) const {
+  std::string path = env.get("PATH");
+  const std::uint64_t path_generation = paths ? paths->validate(env) : 0;
+  if (resolved_valid_ && resolved_generation_ == registry.generation() &&
+      resolved_path_ == path && resolved_path_generation_ == path_generation)
+    return;
+  resolved_.assign(stages_.size(), std::nullopt);
+  for (std::size_t i = 0; i < stages_.size(); ++i) {
+    if (!stages_[i].name.is_literal())
+      continue;
+    const std::string name = stages_[i].name.literal();
+    if (name.empty())
+      continue;
+    Resolution resolution;
+    resolution.builtin = registry.find(name);
+    if (!resolution.builtin) {
+      resolution.executable = lookup(paths, env, name);
+      // Not found (or an explicit path): look again on every run.
+      if (resolution.executable == name)
+        continue;
+    }
+    resolved_[i] = std::move(resolution);
+  }
+  resolved_generation_ = registry.generation();
+  resolved_path_ = std::move(path);
+  resolved_path_generation_ = path_generation;
+  resolved_valid_ = true;
+}
+
+std::optional<std::vector<BoundStage>>
+ExecutionPlan::bind(const CommandRegistry &registry, const Environment &env,
+                    PathCache *paths) const {
+  refresh_resolutions(registry, env, paths);
+  std::vector<BoundStage> bound(stages_.size());
+  for (std::size_t i = 0; i < stages_.size(); ++i) {
+    const Stage &stage = stages_[i];
+    BoundStage &out = bound[i];
+    out.args.reserve(stage.args.size() + 1);
+    out.args.push_back(stage.name.expand(env));
+    if (out.args[0].empty())
+      return std::nullopt;
+    for (const SubstitutionTemplate &arg : stage.args)
+      out.args.push_back(arg.expand(env));
+    if (resolved_[i]) {
+      out.builtin = resolved_[i]->builtin;
+      out.executable = resolved_[i]->executable;
+    } else {
+      out.builtin = registry.find(out.args[0]);
+      if (!out.builtin)
+        out.executable = lookup(paths, env, out.args[0]);
+    }
+  }
+  return bound;
+}
+
+PlanCache::PlanCache(std::size_t capacity) : capacity_(capacity) {}
+
+const ExecutionPlan &PlanCache::get(const std::string &line) {
+  if (capacity_ == 0) {
+    uncached_ = ExecutionPlan::compile(line);
+    return uncached_;
+  }
+  auto it = index_.find(line);
+  if (it != index_.end()) {
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+  ExecutionPlan plan = ExecutionPlan::compile(line);
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(line, std::move(plan));
+  index_.emplace(line, entries_.begin());
+  return entries_.front().second;
+}
+
+void PlanCache::clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+} // namespace cli
@@ -1,103 +1,454 @@
 #include "cli/executor.hpp"
-#include <sstream>
+#include "cli/cooperative_command.hpp"
+#include "cli/coroutine_scheduler.hpp"
+#include "cli/fd_io.hpp"
+#include "cli/operator_fusion.hpp"
+#include "cli/pipe_channel.hpp"
+#include "cli/spill_buffer.hpp"
+#include "cli/thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 namespace cli {
 
-Executor::Executor(CommandRegistry &registry) : registry_(registry) {}
+namespace {
+
+/** Unbuffered stream buffer that forwards every write to `target` under a
+ * shared mutex, so concurrently running stages can share one error stream. */
+class LockedStreamBuf : public std::streambuf {
+public:
+  LockedStreamBuf(std::streambuf *target, std::mutex &mutex)
+      : target_(target), mutex_(mutex) {}
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+      return traits_type::not_eof(ch);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return target_->sputc(traits_type::to_char_type(ch));
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return target_->sputn(s, n);
+  }
+
+  int sync() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return target_->pubsync();
+  }
+
+private:
+  std::streambuf *target_;
+  std::mutex &mutex_;
+};
 
-void Executor::expand_node(const CommandNode &node, const Environment &env,
-                           std::vector<std::string> &args_out) {
-  args_out.clear();
-  std::string name = (node.substitute_name == Substitute::Yes)
-                         ? env.substitute(node.name)
-                         : node.name;
-  args_out.push_back(std::move(name));
-  for (std::size_t i = 0; i < node.args.size(); ++i) {
-    bool sub = (i < node.substitute_arg.size())
-                   ? (node.substitute_arg[i] == Substitute::Yes)
-                   : true;
-    std::string arg = sub ? env.substitute(node.args[i]) : node.args[i];
-    args_out.push_back(std::move(arg));
+/** Streams over a stage's stdin and stdout that count what a built-in (or
+ * a group of built-ins run together) reads and writes; see
+ * StageStats::bytes_in. */
+class CountedStdio {
+public:
+  CountedStdio(std::istream &in, std::ostream &out)
+      : in_(in), out_(out), in_buf_(in.rdbuf()), out_buf_(out.rdbuf()),
+        counted_in_(&in_buf_), counted_out_(&out_buf_) {
+    counted_in_.tie(in.tie());
   }
+
+  std::istream &in() { return counted_in_; }
+  std::ostream &out() { return counted_out_; }
+
+  /** Passes end of input and write errors on to the underlying streams, as
+   * if the command had used them, and stores the counts in `stats`. */
+  void finish(StageStats &stats) {
+    in_.setstate(counted_in_.rdstate());
+    out_.setstate(counted_out_.rdstate());
+    stats.bytes_in = in_buf_.count();
+    stats.bytes_out = out_buf_.count();
+  }
+
+private:
+  std::istream &in_;
+  std::ostream &out_;
+  CountingReadBuf in_buf_;
+  CountingWriteBuf out_buf_;
+  std::istream counted_in_;
+  std::ostream counted_out_;
+};
+
+/** Returns true if the environment selects the concurrent pipeline mode. */
+bool streaming_enabled(const Environment &env) {
+  return env.get("CLI_PIPELINE") == "streaming";
 }
 
-ExecutorResult Executor::execute_one(const std::vector<std::string> &args,
+/** Returns true if the environment selects the single-threaded coroutine
+ * pipeline mode. */
+bool cooperative_enabled(const Environment &env) {
+  return env.get("CLI_PIPELINE") == "cooperative";
+}
+
+/** Awaits one stage coroutine, reports an exception escaping it like the
+ * streaming mode does, and then closes the stage's ends so its neighbours
+ * see end of data or a finished consumer. */
+StageTask supervise_stage(StageTask body, StageInput &in, StageOutput &out,
+                          std::ostream &err, int &exit_code) {
+  try {
+    co_await body;
+  } catch (const std::exception &e) {
+    err << "cli: " << e.what() << "\n";
+    exit_code = 1;
+  } catch (...) {
+    err << "cli: unknown error\n";
+    exit_code = 1;
+  }
+  out.close();
+  in.close();
+}
+
+/** Positive byte count from the variable `name`, or `fallback` if unset or
+ * invalid. */
+std::size_t size_from_env(const Environment &env, const std::string &name,
+                          std::size_t fallback) {
+  std::string value = env.get(name);
+  if (value.empty())
+    return fallback;
+  char *end = nullptr;
+  unsigned long long n = std::strtoull(value.c_str(), &end, 10);
+  if (end == value.c_str() || *end != '\0' || n == 0)
+    return fallback;
+  return static_cast<std::size_t>(n);
+}
+
+/** Peak resident set size of the process in KiB, or 0 if unknown. */
+long peak_rss_kib() {
+#ifdef _WIN32
+  return 0;
+#else
+  rusage ru{};
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  return static_cast<long>(ru.ru_maxrss / 1024);
+#else
+  return static_cast<long>(ru.ru_maxrss);
+#endif
+#endif
+}
+
+/** One entry for stages that ran together on the calling thread (fused or
+ * as coroutines), measured by `meter`. */
+StageStats combined_stats(const std::vector<BoundStage> &stages,
+                          const ThreadUsageMeter &meter, int exit_code) {
+  StageStats stats;
+  meter.stop(stats);
+  for (const BoundStage &stage : stages)
+    stats.name += (stats.name.empty() ? "" : " | ") + stage.args[0];
+  stats.builtin = true;
+  stats.exit_code = exit_code;
+  return stats;
+}
+
+} // namespace
+
+Executor::Executor(CommandRegistry &registry) : registry_(registry) {}
+
+void Executor::set_thread_pool(ThreadPool *pool) {
+  pool_ = pool;
+  external_.set_thread_pool(pool);
+}
+
+ExecutorResult Executor::execute_one(const BoundStage &stage,
                                      std::istream &in, std::ostream &out,
                                      std::ostream &err,
                                      const Environment &env) {
-  if (args.empty()) {
-    err << "cli: empty command\n";
-    return ExecutorResult{false, 127};
-  }
-  const std::string &name = args[0];
-  Command *cmd = registry_.find(name);
-  if (cmd) {
-    int code = cmd->execute(args, in, out, err, env);
+  ExecutorResult result;
+  StageStats stats;
+  if (stage.builtin) {
+    CountedStdio stdio(in, out);
+    ThreadUsageMeter meter;
+    int code =
+        stage.builtin->execute(stage.args, stdio.in(), stdio.out(), err, env);
+    meter.stop(stats);
+    stdio.finish(stats);
     if (code < 0)
-      return ExecutorResult{true, -1 - code};
-    return ExecutorResult{false, code};
+      result = ExecutorResult{true, -1 - code, {}};
+    else
+      result = ExecutorResult{false, code, {}};
+    stats.name = stage.args[0];
+    stats.builtin = true;
+    stats.exit_code = result.exit_code;
+  } else {
+    result.exit_code = external_.execute_resolved(
+        stage.executable, stage.args, in, out, err, env, &stats);
   }
-  int code = external_.execute(args, in, out, err, env);
-  return ExecutorResult{false, code};
+  result.stages.push_back(std::move(stats));
+  return result;
 }
 
 ExecutorResult Executor::execute(const Pipeline &pipeline, std::istream &in,
                                  std::ostream &out, std::ostream &err,
                                  const Environment &env) {
-  if (pipeline.empty()) {
-    return ExecutorResult{false, 0};
-  }
-  if (pipeline.size() == 1) {
-    std::vector<std::string> args;
-    expand_node(pipeline[0], env, args);
-    if (args.empty() || args[0].empty()) {
-      err << "cli: command not found\n";
-      return ExecutorResult{false, 127};
-    }
-    return execute_one(args, in, out, err, env);
+  return execute(ExecutionPlan::from_pipeline(pipeline), in, out, err, env);
+}
+
+ExecutorResult Executor::execute(const ExecutionPlan &plan, std::istream &in,
+                                 std::ostream &out, std::ostream &err,
+                                 const Environment &env) {
+  if (plan.stages().empty()) {
+    return ExecutorResult{false, 0, {}};
+  }
+  const auto start = std::chrono::steady_clock::now();
+  std::optional<std::vector<BoundStage>> bound =
+      plan.bind(registry_, env, paths_);
+  if (!bound) {
+    err << (plan.stages().size() == 1 ? "cli: command not found\n"
+                                      : "cli: empty command in pipeline\n");
+    return ExecutorResult{false, 127, {}};
   }
+  ExecutorResult result = execute_stages(*bound, in, out, err, env);
+  out.flush();
+  if (plan.timed()) {
+    print_stage_stats(err, result.stages,
+                      std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  return result;
+}
 
-  std::vector<std::vector<std::string>> expanded;
-  expanded.reserve(pipeline.size());
-  for (const auto &node : pipeline) {
-    std::vector<std::string> args;
-    expand_node(node, env, args);
-    if (args.empty() || args[0].empty()) {
-      err << "cli: empty command in pipeline\n";
-      return ExecutorResult{false, 127};
+ExecutorResult Executor::execute_list(const ExecutionPlan &plan,
+                                      std::istream &in, std::ostream &out,
+                                      std::ostream &err, Environment &env) {
+  if (!plan.syntax_error().empty()) {
+    err << "cli: " << plan.syntax_error() << "\n";
+    return ExecutorResult{false, 2, {}};
+  }
+  auto run = [&](const ExecutionPlan &pipeline) {
+    pipeline.apply_assignments(env);
+    return execute(pipeline, in, out, err, env);
+  };
+  ExecutorResult result = run(plan);
+  for (const ExecutionPlan::ListStep &step : plan.rest()) {
+    if (result.should_exit)
+      break;
+    const bool succeeded = result.exit_code == 0;
+    if ((step.op == ListOperator::And && !succeeded) ||
+        (step.op == ListOperator::Or && succeeded))
+      continue;
+    result = run(step.plan);
+  }
+  return result;
+}
+
+ExecutorResult Executor::execute_stages(const std::vector<BoundStage> &stages,
+                                        std::istream &in, std::ostream &out,
+                                        std::ostream &err,
+                                        const Environment &env) {
+  if (stages.size() == 1)
+    return execute_one(stages[0], in, out, err, env);
+
+  const bool all_external =
+      std::none_of(stages.begin(), stages.end(),
+                   [](const BoundStage &stage) { return stage.builtin; });
+  if (all_external) {
+    std::vector<std::vector<std::string>> args;
+    std::vector<std::string> paths;
+    args.reserve(stages.size());
+    paths.reserve(stages.size());
+    for (const BoundStage &stage : stages) {
+      args.push_back(stage.args);
+      paths.push_back(stage.executable);
+    }
+    ExecutorResult result;
+    result.exit_code = external_.execute_pipeline(args, in, out, err, env,
+                                                  paths, &result.stages);
+    return result;
+  }
+  if (fusion_enabled(env)) {
+    CountedStdio stdio(in, out);
+    ThreadUsageMeter meter;
+    if (std::optional<int> code =
+            run_fused_pipeline(stages, stdio.in(), stdio.out(), err)) {
+      ExecutorResult result{false, *code, {}};
+      result.stages.push_back(combined_stats(stages, meter, *code));
+      stdio.finish(result.stages.back());
+      return result;
     }
-    expanded.push_back(std::move(args));
   }
+  if (streaming_enabled(env))
+    return execute_streaming(stages, in, out, err, env);
+  if (cooperative_enabled(env)) {
+    std::vector<CooperativeCommand *> commands;
+    commands.reserve(stages.size());
+    for (const BoundStage &stage : stages) {
+      auto *cmd = dynamic_cast<CooperativeCommand *>(stage.builtin);
+      if (!cmd)
+        break;
+      commands.push_back(cmd);
+    }
+    if (commands.size() == stages.size()) {
+      CountedStdio stdio(in, out);
+      ThreadUsageMeter meter;
+      ExecutorResult result = execute_cooperative(
+          commands, stages, stdio.in(), stdio.out(), err, env);
+      result.stages.push_back(
+          combined_stats(stages, meter, result.exit_code));
+      stdio.finish(result.stages.back());
+      return result;
+    }
+  }
+  return execute_sequential(stages, in, out, err, env);
+}
 
+ExecutorResult
+Executor::execute_sequential(const std::vector<BoundStage> &stages,
+                             std::istream &in, std::ostream &out,
+                             std::ostream &err, const Environment &env) {
+  const std::size_t limit = size_from_env(env, "CLI_STAGE_BUFFER_LIMIT",
+                                          SpillBuffer::kDefaultMemoryLimit);
+  SpillBuffer buf_a(limit);
+  SpillBuffer buf_b(limit);
+  SpillBuffer *write_buf = &buf_a;
+  SpillBuffer *read_buf = &buf_b;
+  std::istream pipe_in(read_buf);
+  std::ostream pipe_out(write_buf);
   std::istream *current_in = &in;
-  std::stringstream pipe_read;
-  std::stringstream pipe_write;
-  int last_code = 0;
-
-  for (std::size_t i = 0; i < expanded.size(); ++i) {
-    const bool is_last = (i == expanded.size() - 1);
-    if (i >= 1) {
-      current_in->seekg(0);
-      current_in->clear();
+  ExecutorResult result;
+  std::vector<StageStats> stats;
+
+  for (std::size_t i = 0; i < stages.size(); ++i) {
+    const bool is_last = (i == stages.size() - 1);
+    std::ostream *current_out = is_last ? &out : &pipe_out;
+    result = execute_one(stages[i], *current_in, *current_out, err, env);
+    stats.insert(stats.end(), result.stages.begin(), result.stages.end());
+    if (result.should_exit || is_last)
+      break;
+    pipe_out.flush();
+    if (!write_buf->start_reading())
+      err << "cli: failed to write stage buffer\n";
+    std::swap(read_buf, write_buf);
+    write_buf->clear();
+    pipe_in.rdbuf(read_buf);
+    pipe_out.rdbuf(write_buf);
+    current_in = &pipe_in;
+  }
+
+  if (!env.get("CLI_SPILL_DEBUG").empty()) {
+    err << "cli: stage buffers spilled "
+        << buf_a.spilled_bytes() + buf_b.spilled_bytes()
+        << " bytes, peak RSS " << peak_rss_kib() << " KiB\n";
+  }
+  result.stages = std::move(stats);
+  return result;
+}
+
+ExecutorResult
+Executor::execute_streaming(const std::vector<BoundStage> &stages,
+                            std::istream &in, std::ostream &out,
+                            std::ostream &err, const Environment &env) {
+  const std::size_t n = stages.size();
+  const std::size_t capacity =
+      size_from_env(env, "CLI_PIPE_CAPACITY", PipeChannel::kDefaultCapacity);
+  std::vector<std::unique_ptr<PipeChannel>> channels;
+  channels.reserve(n - 1);
+  for (std::size_t i = 0; i + 1 < n; ++i)
+    channels.push_back(std::make_unique<PipeChannel>(capacity));
+
+  std::mutex err_mutex;
+  std::vector<ExecutorResult> results(n);
+
+  auto run_stage = [&](std::size_t i) {
+    LockedStreamBuf err_buf(err.rdbuf(), err_mutex);
+    std::ostream stage_err(&err_buf);
+    std::unique_ptr<ChannelReadBuf> in_buf;
+    std::unique_ptr<std::istream> channel_in;
+    if (i > 0) {
+      in_buf = std::make_unique<ChannelReadBuf>(*channels[i - 1]);
+      channel_in = std::make_unique<std::istream>(in_buf.get());
     }
-    std::ostream *current_out = is_last ? &out : &pipe_write;
-    ExecutorResult result =
-        execute_one(expanded[i], *current_in, *current_out, err, env);
-    if (result.should_exit)
-      return result;
-    last_code = result.exit_code;
-    if (!is_last) {
-      pipe_write.seekg(0);
-      std::string pipe_data = pipe_write.str();
-      pipe_read.str(pipe_data);
-      pipe_read.seekg(0);
-      pipe_read.clear();
-      pipe_write.str("");
-      pipe_write.clear();
-      current_in = &pipe_read;
+    std::unique_ptr<ChannelWriteBuf> out_buf;
+    std::unique_ptr<std::ostream> channel_out;
+    if (i + 1 < n) {
+      out_buf = std::make_unique<ChannelWriteBuf>(*channels[i]);
+      channel_out = std::make_unique<std::ostream>(out_buf.get());
+    }
+    std::istream &stage_in = channel_in ? *channel_in : in;
+    std::ostream &stage_out = channel_out ? *channel_out : out;
+    try {
+      results[i] = execute_one(stages[i], stage_in, stage_out, stage_err, env);
+    } catch (const std::exception &e) {
+      stage_err << "cli: " << e.what() << "\n";
+      results[i] = ExecutorResult{false, 1, {}};
+    } catch (...) {
+      stage_err << "cli: unknown error\n";
+      results[i] = ExecutorResult{false, 1, {}};
     }
+    if (out_buf)
+      out_buf->close();
+    if (i > 0)
+      channels[i - 1]->close_read();
+  };
+
+  std::vector<TaskHandle> stage_tasks;
+  stage_tasks.reserve(n - 1);
+  for (std::size_t i = 0; i + 1 < n; ++i)
+    stage_tasks.push_back(
+        run_concurrently(pool_, [&run_stage, i] { run_stage(i); }));
+  run_stage(n - 1);
+  for (auto &task : stage_tasks)
+    task.wait();
+
+  std::vector<StageStats> stats;
+  for (const auto &r : results)
+    stats.insert(stats.end(), r.stages.begin(), r.stages.end());
+  ExecutorResult result = results.back();
+  for (const auto &r : results) {
+    if (r.should_exit) {
+      result = r;
+      break;
+    }
+  }
+  result.stages = std::move(stats);
+  return result;
+}
+
+ExecutorResult Executor::execute_cooperative(
+    const std::vector<CooperativeCommand *> &commands,
+    const std::vector<BoundStage> &stages, std::istream &in,
+    std::ostream &out, std::ostream &err, const Environment &env) {
+  const std::size_t n = stages.size();
+  CoroutineScheduler scheduler;
+  std::vector<std::unique_ptr<ChunkPipe>> pipes;
+  pipes.reserve(n - 1);
+  for (std::size_t i = 0; i + 1 < n; ++i)
+    pipes.push_back(std::make_unique<ChunkPipe>(scheduler));
+
+  std::vector<std::unique_ptr<StageInput>> inputs;
+  std::vector<std::unique_ptr<StageOutput>> outputs;
+  std::vector<int> codes(n, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    inputs.push_back(i == 0 ? std::make_unique<StageInput>(in)
+                            : std::make_unique<StageInput>(*pipes[i - 1]));
+    outputs.push_back(i + 1 == n ? std::make_unique<StageOutput>(out)
+                                 : std::make_unique<StageOutput>(*pipes[i]));
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    StageTask body = commands[i]->run_stage(stages[i].args, *inputs[i],
+                                            *outputs[i], err, env, codes[i]);
+    scheduler.spawn(supervise_stage(std::move(body), *inputs[i], *outputs[i],
+                                    err, codes[i]));
+  }
+  if (!scheduler.run()) {
+    err << "cli: cooperative pipeline stalled\n";
+    return ExecutorResult{false, 1, {}};
   }
-  return ExecutorResult{false, last_code};
+  return ExecutorResult{false, codes.back(), {}};
 }
 
 } // namespace cli
@@ -1,11 +1,15 @@
 #include "cli/external_command.hpp"
 #include "cli/environment.hpp"
+#include "cli/fd_io.hpp"
+#include "cli/io_pump.hpp"
+#include "cli/pipe_channel.hpp"
+#include "cli/zygote.hpp"
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstring>
-#include <list>
+#include <optional>
 #include <sstream>
-#include <thread>
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -21,6 +25,8 @@
 #include <cerrno>
 #include <csignal>
 #include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #endif
@@ -93,13 +99,6 @@ std::string resolve_executable_win32(const Environment &env,
 #else
 #include <sys/stat.h>
 
-/** Builds argv for execve: vector of char* ending with nullptr. */
-std::vector<char> str_to_vec(const std::string &x) {
-  std::vector<char> v(x.begin(), x.end());
-  v.push_back('\0');
-  return v;
-}
-
 /** Resolves executable path using PATH when name has no '/'. */
 std::string resolve_executable(const Environment &env,
                                const std::string &name) {
@@ -130,18 +129,338 @@ std::string resolve_executable(const Environment &env,
   }
   return name;
 }
+
+/** Null-terminated array of C strings for execve's argv, packed into one
+ * buffer so building it costs a couple of allocations however many
+ * arguments there are. */
+class ExecStrings {
+public:
+  void add(const std::string &s) {
+    offsets_.push_back(storage_.size());
+    storage_.append(s).push_back('\0');
+  }
+
+  /// The array; valid until the next add().
+  char *const *data() {
+    ptrs_.clear();
+    for (std::size_t off : offsets_)
+      ptrs_.push_back(storage_.data() + off);
+    ptrs_.push_back(nullptr);
+    return ptrs_.data();
+  }
+
+private:
+  std::string storage_;
+  std::vector<std::size_t> offsets_;
+  std::vector<char *> ptrs_;
+};
+
+/** Builds argv for execve with argv[0] replaced by the resolved path. */
+ExecStrings build_argv(const std::string &program_path,
+                       const std::vector<std::string> &args) {
+  ExecStrings out;
+  out.add(program_path);
+  for (std::size_t i = 1; i < args.size(); ++i)
+    out.add(args[i]);
+  return out;
+}
+
+/** Creates a pipe whose ends are closed on exec, so that a child started by
+ * another thread at the same moment does not inherit them (and keep the
+ * pipe open after its real users are done). */
+bool make_pipe(int fds[2]) {
+#ifdef __linux__
+  return pipe2(fds, O_CLOEXEC) == 0;
+#else
+  if (pipe(fds) != 0)
+    return false;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return true;
+#endif
+}
+
+/** Copies `in` into fd until EOF or until the reader goes away, then closes
+ * fd; returns the bytes written. Used for streams the IoPump cannot poll.
+ * When the child stops reading, the producer of `in` is told via
+ * close_input(). */
+std::uint64_t copy_stream_to_fd(std::istream &in, int fd) {
+  std::signal(SIGPIPE, SIG_IGN);
+  std::array<char, 4096> buf;
+  bool pipe_closed = false;
+  std::uint64_t written = 0;
+  while (!pipe_closed &&
+         (in.read(buf.data(), buf.size()) || in.gcount() > 0)) {
+    ssize_t n = in.gcount();
+    if (n <= 0)
+      continue;
+    const char *p = buf.data();
+    while (n > 0) {
+      ssize_t w = write(fd, p, static_cast<size_t>(n));
+      if (w == -1) {
+        if (errno == EINTR)
+          continue;
+        if (errno == EPIPE)
+          pipe_closed = true;
+        break;
+      }
+      p += w;
+      n -= w;
+      written += static_cast<std::uint64_t>(w);
+    }
+  }
+  close(fd);
+  if (pipe_closed)
+    close_input(in);
+  return written;
+}
+
+/** The calling thread's pump; its buffers are reused by every command the
+ * thread runs. */
+IoPump &thread_pump() {
+  thread_local IoPump pump;
+  return pump;
+}
+
+/** Pumps the pipes of a child's stdio from the calling thread; -1 marks a
+ * stream the child uses directly. `in` is fed by a helper task only if
+ * reading it could block the pump (see IoPump::can_pump_input). Closes all
+ * three descriptors. Stores the bytes that went through the stdin and
+ * stdout pipes in `stats`; a stream the child used directly stays
+ * unknown. */
+void pump_child_io(ThreadPool *pool, std::istream &in, int stdin_fd,
+                   int stdout_fd, std::ostream &out, int stderr_fd,
+                   std::ostream &err, StageStats &stats) {
+  const bool stdin_piped = stdin_fd >= 0;
+  const bool stdout_piped = stdout_fd >= 0;
+  TaskHandle writer;
+  std::uint64_t fed = 0;
+  if (stdin_piped && !IoPump::can_pump_input(in)) {
+    writer = run_concurrently(pool, [&in, &fed, stdin_fd]() {
+      fed = copy_stream_to_fd(in, stdin_fd);
+    });
+    stdin_fd = -1;
+  }
+  IoPump &pump = thread_pump();
+  pump.run(in, stdin_fd, stdout_fd, out, stderr_fd, err);
+  writer.wait();
+  if (stdin_piped)
+    stats.bytes_in = stdin_fd >= 0 ? pump.bytes_in() : fed;
+  if (stdout_piped)
+    stats.bytes_out = pump.bytes_out();
+}
+
+/** Descriptors for the stdin, stdout and stderr (indices 0-2) of a child
+ * or of a whole pipeline. A stream backed by one of the interpreter's
+ * descriptors (see input_fd() and output_fd()) is handed to the children as
+ * is, so nothing is copied through the interpreter; any other stream gets a
+ * pipe whose `parent` end is serviced by the IoPump. */
+struct ChildStdio {
+  std::array<int, 3> child{-1, -1, -1};
+  /// Parent end of the pipe, or -1 if the child uses the stream's own fd.
+  std::array<int, 3> parent{-1, -1, -1};
+
+  /** Sets up all three streams; on failure closes what was opened. */
+  bool open(std::istream &in, std::ostream &out, std::ostream &err) {
+    const int direct[3] = {input_fd(in), output_fd(out), output_fd(err)};
+    for (std::size_t i = 0; i < 3; ++i) {
+      if (direct[i] >= 0) {
+        child[i] = direct[i];
+        continue;
+      }
+      int p[2];
+      if (!make_pipe(p)) {
+        close_all();
+        return false;
+      }
+      child[i] = i == 0 ? p[0] : p[1];
+      parent[i] = i == 0 ? p[1] : p[0];
+    }
+    return true;
+  }
+
+  /** Closes the children's ends of the pipes once they have been started. */
+  void close_child_ends() {
+    for (std::size_t i = 0; i < 3; ++i) {
+      if (parent[i] >= 0 && child[i] >= 0)
+        close(child[i]);
+      if (parent[i] >= 0)
+        child[i] = -1;
+    }
+  }
+
+  void close_all() {
+    close_child_ends();
+    for (int &fd : parent) {
+      if (fd >= 0)
+        close(fd);
+      fd = -1;
+    }
+  }
+};
+
+/** How the interpreter starts programs itself (without a zygote). */
+enum class Launcher {
+  Spawn, ///< posix_spawn(): no page-table copy, cost independent of RSS
+  Fork,  ///< fork() + execve(), selected with CLI_LAUNCHER=fork
+};
+
+Launcher launcher_from_env(const Environment &env) {
+  return env.get("CLI_LAUNCHER") == "fork" ? Launcher::Fork : Launcher::Spawn;
+}
+
+/** A started child: launched by the interpreter (`pid`), by the zygote
+ * (`status_fd`, see Zygote::launch), or one whose exec already failed
+ * (`exit_code`). */
+struct Child {
+  pid_t pid{-1};
+  int status_fd{-1};
+  int exit_code{-1};
+  std::chrono::steady_clock::time_point started{
+      std::chrono::steady_clock::now()};
+};
+
+/** Starts `program_path` with the given stdio descriptors. Goes through the
+ * zygote when there is one and it accepts the request; otherwise starts it
+ * with `launcher`. All other descriptors of the interpreter are expected to
+ * be close-on-exec. Returns std::nullopt if no process could be created. */
+std::optional<Child> start_child(Zygote *zygote, Launcher launcher,
+                                 const std::string &program_path,
+                                 const std::vector<std::string> &args,
+                                 char *const *envp, int in_fd, int out_fd,
+                                 int err_fd) {
+  if (zygote) {
+    int status_fd =
+        zygote->launch(program_path, args, envp, in_fd, out_fd, err_fd);
+    if (status_fd >= 0)
+      return Child{-1, status_fd};
+  }
+  ExecStrings argv = build_argv(program_path, args);
+  char *const *argv_data = argv.data();
+
+  if (launcher == Launcher::Spawn) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+    // The interpreter ignores SIGPIPE; the program gets the default.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+    pid_t pid = -1;
+    const int rc =
+        posix_spawn(&pid, argv_data[0], &actions, &attr, argv_data, envp);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc == 0)
+      return Child{pid, -1};
+    if (rc == EAGAIN || rc == ENOMEM)
+      return std::nullopt;
+    // The process was created but exec failed (ENOENT, EACCES, ...).
+    return Child{-1, -1, 127};
+  }
+
+  pid_t pid = fork();
+  if (pid < 0)
+    return std::nullopt;
+  if (pid == 0) {
+    std::signal(SIGPIPE, SIG_DFL);
+    dup2(in_fd, STDIN_FILENO);
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(err_fd, STDERR_FILENO);
+    execve(argv_data[0], argv_data, envp);
+    _exit(127);
+  }
+  return Child{pid, -1};
+}
+
+/** Waits for the child and returns its exit code; 127 is reported as
+ * "command not found" for `name`. If `usage` is set, it receives the
+ * child's resource usage (zero if unknown). */
+int wait_child(const Child &child, const std::string &name, std::ostream &err,
+               rusage *usage = nullptr) {
+  rusage ignored{};
+  if (!usage)
+    usage = &ignored;
+  *usage = rusage{};
+  int code;
+  if (child.exit_code >= 0) {
+    code = child.exit_code;
+  } else if (child.status_fd >= 0) {
+    code = Zygote::wait(child.status_fd, usage);
+    if (code < 0) {
+      err << "fork() failed\n";
+      return 1;
+    }
+  } else {
+    int status = 0;
+    if (wait4(child.pid, &status, 0, usage) == -1)
+      return 1;
+    if (!WIFEXITED(status))
+      return 1;
+    code = WEXITSTATUS(status);
+  }
+  if (code == 127)
+    err << "cli: " << name << ": command not found\n";
+  return code;
+}
 #endif
 
 } // namespace
 
+std::string ExternalCommand::resolve(const Environment &env,
+                                     const std::string &name) {
+#ifdef _WIN32
+  return resolve_executable_win32(env, name);
+#else
+  return resolve_executable(env, name);
+#endif
+}
+
 int ExternalCommand::execute(const std::vector<std::string> &args,
                              std::istream &in, std::ostream &out,
                              std::ostream &err, const Environment &env) {
   if (args.empty())
     return 127;
+  return execute_resolved(resolve(env, args[0]), args, in, out, err, env);
+}
+
+int ExternalCommand::execute_resolved(const std::string &program_path,
+                                      const std::vector<std::string> &args,
+                                      std::istream &in, std::ostream &out,
+                                      std::ostream &err,
+                                      const Environment &env,
+                                      StageStats *stats) {
+  const auto start = std::chrono::steady_clock::now();
+  StageStats measured;
+  const int code =
+      run_resolved(program_path, args, in, out, err, env, measured);
+  if (stats) {
+    *stats = std::move(measured);
+    stats->name = args.empty() ? std::string() : args[0];
+    stats->exit_code = code;
+    stats->real_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  }
+  return code;
+}
+
+int ExternalCommand::run_resolved(const std::string &program_path,
+                                  const std::vector<std::string> &args,
+                                  std::istream &in, std::ostream &out,
+                                  std::ostream &err, const Environment &env,
+                                  StageStats &stats) {
+  if (args.empty())
+    return 127;
 
 #ifdef _WIN32
-  std::string program_path = resolve_executable_win32(env, args[0]);
+  (void)stats;
   std::vector<std::string> full_args;
   full_args.push_back(program_path);
   for (std::size_t i = 1; i < args.size(); ++i)
@@ -206,7 +525,7 @@ int ExternalCommand::execute(const std::vector<std::string> &args,
     return 1;
   }
 
-  std::thread writer([&in, hStdinW]() {
+  TaskHandle writer = run_concurrently(pool_, [&in, hStdinW]() {
     std::array<char, 4096> buf;
     while (in.read(buf.data(), buf.size()) || in.gcount() > 0) {
       DWORD written = 0;
@@ -228,7 +547,7 @@ int ExternalCommand::execute(const std::vector<std::string> &args,
 
   read_handle(hStdoutR, out);
   read_handle(hStderrR, err);
-  writer.join();
+  writer.wait();
 
   WaitForSingleObject(pi.hProcess, INFINITE);
   DWORD exit_code = 0;
@@ -237,103 +556,147 @@ int ExternalCommand::execute(const std::vector<std::string> &args,
   CloseHandle(pi.hThread);
   return static_cast<int>(exit_code);
 #else
-  std::string program_path = resolve_executable(env, args[0]);
-
-  std::list<std::vector<char>> arg_storage;
-  std::vector<char *> argv_ptrs;
-  arg_storage.push_back(str_to_vec(program_path));
-  argv_ptrs.push_back(arg_storage.back().data());
-  for (std::size_t i = 1; i < args.size(); ++i) {
-    arg_storage.push_back(str_to_vec(args[i]));
-    argv_ptrs.push_back(arg_storage.back().data());
-  }
-  argv_ptrs.push_back(nullptr);
-
-  std::vector<std::vector<char>> env_storage;
-  std::vector<char *> env_ptrs;
-  for (const auto &e : env.to_env_vector()) {
-    env_storage.push_back(str_to_vec(e));
-    env_ptrs.push_back(env_storage.back().data());
-  }
-  env_ptrs.push_back(nullptr);
-
-  int stdin_pipe[2], stdout_pipe[2], stderr_pipe[2];
-  if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0 ||
-      pipe(stderr_pipe) != 0) {
+  ChildStdio stdio;
+  if (!stdio.open(in, out, err)) {
     err << "pipe() failed\n";
     return 1;
   }
-
-  pid_t pid = fork();
-  if (pid < 0) {
+  std::optional<Child> child =
+      start_child(zygote_, launcher_from_env(env), program_path, args,
+                  env.envp(), stdio.child[0], stdio.child[1], stdio.child[2]);
+  stdio.close_child_ends();
+  if (!child) {
+    stdio.close_all();
     err << "fork() failed\n";
     return 1;
   }
-  if (pid == 0) {
-    close(stdin_pipe[1]);
-    close(stdout_pipe[0]);
-    close(stderr_pipe[0]);
-    dup2(stdin_pipe[0], STDIN_FILENO);
-    dup2(stdout_pipe[1], STDOUT_FILENO);
-    dup2(stderr_pipe[1], STDERR_FILENO);
-    close(stdin_pipe[0]);
-    close(stdout_pipe[1]);
-    close(stderr_pipe[1]);
-    execve(program_path.c_str(), argv_ptrs.data(), env_ptrs.data());
-    _exit(127);
-  }
 
-  close(stdin_pipe[0]);
-  close(stdout_pipe[1]);
-  close(stderr_pipe[1]);
+  pump_child_io(pool_, in, stdio.parent[0], stdio.parent[1], out,
+                stdio.parent[2], err, stats);
 
-  std::thread writer([&in, stdin_pipe]() {
-    std::signal(SIGPIPE, SIG_IGN);
-    std::array<char, 4096> buf;
-    bool pipe_closed = false;
-    while (!pipe_closed &&
-           (in.read(buf.data(), buf.size()) || in.gcount() > 0)) {
-      ssize_t n = in.gcount();
-      if (n <= 0)
-        continue;
-      const char *p = buf.data();
-      while (n > 0) {
-        ssize_t w = write(stdin_pipe[1], p, static_cast<size_t>(n));
-        if (w == -1) {
-          if (errno == EINTR)
-            continue;
-          if (errno == EPIPE)
-            pipe_closed = true;
-          break;
-        }
-        p += w;
-        n -= w;
-      }
-    }
-    close(stdin_pipe[1]);
-  });
+  rusage usage{};
+  const int code = wait_child(*child, args[0], err, &usage);
+  set_child_usage(stats, usage);
+  return code;
+#endif
+}
 
-  auto read_pipe = [](int fd, std::ostream &o) {
-    std::array<char, 4096> buf;
-    ssize_t n;
-    while ((n = read(fd, buf.data(), buf.size())) > 0)
-      o.write(buf.data(), n);
-    close(fd);
+int ExternalCommand::execute_pipeline(
+    const std::vector<std::vector<std::string>> &stages, std::istream &in,
+    std::ostream &out, std::ostream &err, const Environment &env,
+    const std::vector<std::string> &paths, std::vector<StageStats> *stats) {
+  if (stats)
+    stats->assign(stages.size(), StageStats{});
+  if (stages.empty())
+    return 0;
+  auto path_of = [&](std::size_t i) {
+    return i < paths.size() ? paths[i] : resolve(env, stages[i][0]);
+  };
+  auto stats_of = [&](std::size_t i) {
+    return stats ? &(*stats)[i] : nullptr;
   };
-  read_pipe(stdout_pipe[0], out);
-  read_pipe(stderr_pipe[0], err);
-  writer.join();
+  if (stages.size() == 1)
+    return execute_resolved(path_of(0), stages[0], in, out, err, env,
+                            stats_of(0));
 
-  int status = 0;
-  if (waitpid(pid, &status, 0) == -1)
+#ifdef _WIN32
+  // No fork/pipe wiring here: chain the stages through memory buffers.
+  std::istream *current_in = &in;
+  std::stringstream pipe_read;
+  std::stringstream pipe_write;
+  int code = 0;
+  for (std::size_t i = 0; i < stages.size(); ++i) {
+    const bool is_last = (i == stages.size() - 1);
+    code = execute_resolved(path_of(i), stages[i], *current_in,
+                            is_last ? out : pipe_write, err, env, stats_of(i));
+    if (!is_last) {
+      pipe_read.str(pipe_write.str());
+      pipe_read.clear();
+      pipe_write.str("");
+      pipe_write.clear();
+      current_in = &pipe_read;
+    }
+  }
+  return code;
+#else
+  const std::size_t n = stages.size();
+  const Launcher launcher = launcher_from_env(env);
+
+  // The first stage reads `in` and the last one writes `out` (directly or
+  // through a pipe, see ChildStdio); links[i] connects stage i to stage
+  // i + 1. All stages share stderr.
+  ChildStdio stdio;
+  if (!stdio.open(in, out, err)) {
+    err << "pipe() failed\n";
     return 1;
-  if (WIFEXITED(status)) {
-    int code = WEXITSTATUS(status);
-    if (code == 127)
-      err << "cli: " << args[0] << ": command not found\n";
-    return code;
   }
-  return 1;
+  std::vector<std::array<int, 2>> links(n - 1);
+  std::size_t linked = 0;
+  while (linked < links.size() && make_pipe(links[linked].data()))
+    ++linked;
+  auto close_links = [&]() {
+    for (std::size_t i = 0; i < linked; ++i) {
+      close(links[i][0]);
+      close(links[i][1]);
+    }
+  };
+  if (linked < links.size()) {
+    close_links();
+    stdio.close_all();
+    err << "pipe() failed\n";
+    return 1;
+  }
+
+  std::vector<Child> children;
+  children.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const int in_fd = i == 0 ? stdio.child[0] : links[i - 1][0];
+    const int out_fd = i == n - 1 ? stdio.child[1] : links[i][1];
+    std::optional<Child> child =
+        start_child(zygote_, launcher, path_of(i), stages[i], env.envp(), in_fd,
+                    out_fd, stdio.child[2]);
+    if (!child) {
+      err << "fork() failed\n";
+      break;
+    }
+    children.push_back(*child);
+  }
+  close_links();
+  stdio.close_child_ends();
+
+  if (children.size() < n) {
+    stdio.close_all();
+    std::ostringstream ignored;
+    for (const Child &child : children)
+      wait_child(child, {}, ignored);
+    return 1;
+  }
+
+  // Only the pipeline's own ends pass through the interpreter; the links
+  // between programs are kernel pipes.
+  StageStats ends;
+  pump_child_io(pool_, in, stdio.parent[0], stdio.parent[1], out,
+                stdio.parent[2], err, ends);
+
+  int code = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    rusage usage{};
+    code = wait_child(children[i], stages[i][0], err, &usage);
+    if (StageStats *stage = stats_of(i)) {
+      if (i == 0)
+        stage->bytes_in = ends.bytes_in;
+      if (i == n - 1)
+        stage->bytes_out = ends.bytes_out;
+      stage->name = stages[i][0];
+      stage->exit_code = code;
+      set_child_usage(*stage, usage);
+      stage->real_seconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() -
+                                children[i].started)
+                                .count();
+    }
+  }
+  return code;
 #endif
 }
 
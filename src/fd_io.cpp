@@ -0,0 +1,402 @@
+#include "cli/fd_io.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace cli {
+
+namespace {
+
+/// Buffer size for FdStreamBuf and for the read/write fallback.
+constexpr std::size_t kIoBufSize = 64 * 1024;
+
+/// Buffers the runtime gave the standard streams. Once a stream's buffer
+/// has been replaced (e.g. `std::cout.rdbuf(other)`), writing to it no
+/// longer reaches fd 1, so only these count as the standard descriptors.
+std::streambuf *const g_stdin_buf = std::cin.rdbuf();
+std::streambuf *const g_stdout_buf = std::cout.rdbuf();
+std::streambuf *const g_stderr_buf = std::cerr.rdbuf();
+std::streambuf *const g_stdlog_buf = std::clog.rdbuf();
+
+#ifdef _WIN32
+long long sys_read(int fd, char *buf, std::size_t n) {
+  return _read(fd, buf, static_cast<unsigned>(n));
+}
+long long sys_write(int fd, const char *buf, std::size_t n) {
+  return _write(fd, buf, static_cast<unsigned>(n));
+}
+void sys_close(int fd) { _close(fd); }
+#else
+long long sys_read(int fd, char *buf, std::size_t n) {
+  return read(fd, buf, n);
+}
+long long sys_write(int fd, const char *buf, std::size_t n) {
+  return write(fd, buf, n);
+}
+void sys_close(int fd) { close(fd); }
+#endif
+
+/** Writes all n bytes, retrying on EINTR and short writes. */
+bool write_all(int fd, const char *p, std::size_t n) {
+  while (n > 0) {
+    long long w = sys_write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += w;
+    n -= static_cast<std::size_t>(w);
+  }
+  return true;
+}
+
+#ifdef __linux__
+/// Upper bound on bytes moved by one splice/sendfile call.
+constexpr std::size_t kKernelChunk = 1 << 20;
+
+/** Result of a kernel-side copy attempt. */
+enum class KernelCopy { Done, Error, Unsupported };
+
+/** Moves bytes with splice(2)/sendfile(2); Unsupported means "use the
+ * read/write fallback from the current offsets". */
+KernelCopy kernel_copy(int in_fd, int out_fd, std::int64_t &total) {
+  struct stat in_st = {};
+  struct stat out_st = {};
+  if (fstat(in_fd, &in_st) != 0 || fstat(out_fd, &out_st) != 0)
+    return KernelCopy::Unsupported;
+  const bool use_splice = S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode);
+  const bool use_sendfile = !use_splice && S_ISREG(in_st.st_mode);
+  if (!use_splice && !use_sendfile)
+    return KernelCopy::Unsupported;
+  while (true) {
+    ssize_t n =
+        use_splice
+            ? splice(in_fd, nullptr, out_fd, nullptr, kKernelChunk,
+                     SPLICE_F_MOVE | SPLICE_F_MORE)
+            : sendfile(out_fd, in_fd, nullptr, kKernelChunk);
+    if (n > 0) {
+      total += n;
+      continue;
+    }
+    if (n == 0)
+      return KernelCopy::Done;
+    if (errno == EINTR)
+      continue;
+    if (errno == EPIPE)
+      return KernelCopy::Done;
+    if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)
+      return KernelCopy::Unsupported;
+    return KernelCopy::Error;
+  }
+}
+#endif
+
+} // namespace
+
+FdStreamBuf::FdStreamBuf(int fd, bool owns_fd)
+    : fd_(fd), owns_fd_(owns_fd),
+      in_buf_(std::make_unique_for_overwrite<char[]>(kIoBufSize)),
+      out_buf_(std::make_unique_for_overwrite<char[]>(kIoBufSize)) {
+  setg(in_buf_.get(), in_buf_.get(), in_buf_.get());
+  setp(out_buf_.get(), out_buf_.get() + kIoBufSize);
+}
+
+FdStreamBuf::~FdStreamBuf() {
+  flush_output();
+  if (owns_fd_)
+    sys_close(fd_);
+}
+
+FdStreamBuf::int_type FdStreamBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  long long n;
+  do {
+    n = sys_read(fd_, in_buf_.get(), kIoBufSize);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return traits_type::eof();
+  setg(in_buf_.get(), in_buf_.get(),
+       in_buf_.get() + static_cast<std::size_t>(n));
+  return traits_type::to_int_type(*gptr());
+}
+
+bool FdStreamBuf::flush_output() {
+  const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+  setp(out_buf_.get(), out_buf_.get() + kIoBufSize);
+  return pending == 0 || write_all(fd_, out_buf_.get(), pending);
+}
+
+FdStreamBuf::int_type FdStreamBuf::overflow(int_type ch) {
+  if (!flush_output())
+    return traits_type::eof();
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
+
+std::streamsize FdStreamBuf::xsputn(const char *s, std::streamsize n) {
+  const std::size_t len = static_cast<std::size_t>(n);
+  if (len <= static_cast<std::size_t>(epptr() - pptr())) {
+    std::memcpy(pptr(), s, len);
+    pbump(static_cast<int>(n));
+    return n;
+  }
+  if (!flush_output() || !write_all(fd_, s, len))
+    return 0;
+  return n;
+}
+
+int FdStreamBuf::sync() { return flush_output() ? 0 : -1; }
+
+OutputSinkBuf::OutputSinkBuf(int fd, FlushPolicy policy, std::size_t capacity)
+    : fd_(fd), policy_(policy), capacity_(capacity == 0 ? 1 : capacity),
+      buffer_(std::make_unique_for_overwrite<char[]>(capacity_)) {
+  setp(nullptr, nullptr);
+}
+
+OutputSinkBuf::~OutputSinkBuf() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  flush_locked();
+}
+
+std::uint64_t OutputSinkBuf::write_calls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return write_calls_;
+}
+
+bool OutputSinkBuf::write_locked(const char *s, std::size_t n) {
+  while (n > 0 && !failed_) {
+    long long w = sys_write(fd_, s, n);
+    ++write_calls_;
+    if (w < 0) {
+      failed_ = errno != EINTR;
+      continue;
+    }
+    s += w;
+    n -= static_cast<std::size_t>(w);
+  }
+  return !failed_;
+}
+
+bool OutputSinkBuf::flush_locked() {
+  const std::size_t pending = size_;
+  size_ = 0;
+  return pending == 0 ? !failed_ : write_locked(buffer_.get(), pending);
+}
+
+bool OutputSinkBuf::append_locked(const char *s, std::size_t n) {
+  if (failed_)
+    return false;
+  if (n > capacity_ - size_) {
+    if (!flush_locked())
+      return false;
+    // Too big to be worth copying: write it as is.
+    if (n >= capacity_)
+      return write_locked(s, n);
+  }
+  std::memcpy(buffer_.get() + size_, s, n);
+  size_ += n;
+  if (policy_ == FlushPolicy::Line && std::memchr(s, '\n', n))
+    return flush_locked();
+  return true;
+}
+
+OutputSinkBuf::int_type OutputSinkBuf::overflow(int_type ch) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return flush_locked() ? traits_type::not_eof(ch) : traits_type::eof();
+  const char c = traits_type::to_char_type(ch);
+  return append_locked(&c, 1) ? ch : traits_type::eof();
+}
+
+std::streamsize OutputSinkBuf::xsputn(const char *s, std::streamsize n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return append_locked(s, static_cast<std::size_t>(n)) ? n : 0;
+}
+
+int OutputSinkBuf::sync() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return flush_locked() ? 0 : -1;
+}
+
+OutputSink::OutputSink(int fd, FlushPolicy policy, std::size_t capacity)
+    : std::ostream(nullptr), buf_(fd, policy, capacity) {
+  rdbuf(&buf_);
+}
+
+FlushPolicy OutputSink::policy_for(int fd) {
+#ifdef _WIN32
+  return _isatty(fd) ? FlushPolicy::Line : FlushPolicy::Block;
+#else
+  return isatty(fd) ? FlushPolicy::Line : FlushPolicy::Block;
+#endif
+}
+
+CountingReadBuf::int_type CountingReadBuf::underflow() {
+  return source_->sgetc();
+}
+
+CountingReadBuf::int_type CountingReadBuf::uflow() {
+  const int_type ch = source_->sbumpc();
+  if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    ++count_;
+  return ch;
+}
+
+std::streamsize CountingReadBuf::xsgetn(char *s, std::streamsize n) {
+  const std::streamsize got = source_->sgetn(s, n);
+  if (got > 0)
+    count_ += static_cast<std::uint64_t>(got);
+  return got;
+}
+
+std::streamsize CountingReadBuf::showmanyc() { return source_->in_avail(); }
+
+CountingWriteBuf::int_type CountingWriteBuf::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  const int_type put = sink_->sputc(traits_type::to_char_type(ch));
+  if (!traits_type::eq_int_type(put, traits_type::eof()))
+    ++count_;
+  return put;
+}
+
+std::streamsize CountingWriteBuf::xsputn(const char *s, std::streamsize n) {
+  const std::streamsize put = sink_->sputn(s, n);
+  if (put > 0)
+    count_ += static_cast<std::uint64_t>(put);
+  return put;
+}
+
+int CountingWriteBuf::sync() { return sink_->pubsync(); }
+
+std::streambuf *source_buf(std::istream &in) {
+  auto *counting = dynamic_cast<CountingReadBuf *>(in.rdbuf());
+  return counting ? counting->source() : in.rdbuf();
+}
+
+LockedWriteBuf::int_type LockedWriteBuf::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sink_->sputc(traits_type::to_char_type(ch));
+}
+
+std::streamsize LockedWriteBuf::xsputn(const char *s, std::streamsize n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sink_->sputn(s, n);
+}
+
+int LockedWriteBuf::sync() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sink_->pubsync();
+}
+
+std::streambuf *sink_buf(std::ostream &out) {
+  std::streambuf *buf = out.rdbuf();
+  while (true) {
+    if (auto *counting = dynamic_cast<CountingWriteBuf *>(buf))
+      buf = counting->sink();
+    else if (auto *locked = dynamic_cast<LockedWriteBuf *>(buf))
+      buf = locked->sink();
+    else
+      return buf;
+  }
+}
+
+void count_input(std::istream &in, std::uint64_t n) {
+  if (auto *counting = dynamic_cast<CountingReadBuf *>(in.rdbuf()))
+    counting->add(n);
+}
+
+void count_output(std::ostream &out, std::uint64_t n) {
+  if (auto *counting = dynamic_cast<CountingWriteBuf *>(out.rdbuf()))
+    counting->add(n);
+}
+
+int output_fd(std::ostream &out) {
+#ifdef _WIN32
+  (void)out;
+  return -1;
+#else
+  std::streambuf *const target = sink_buf(out);
+  int fd = -1;
+  if (target == g_stdout_buf)
+    fd = STDOUT_FILENO;
+  else if (target == g_stderr_buf || target == g_stdlog_buf)
+    fd = STDERR_FILENO;
+  else if (auto *buf = dynamic_cast<FdStreamBuf *>(target))
+    fd = buf->fd();
+  else if (auto *sink = dynamic_cast<OutputSinkBuf *>(target))
+    fd = sink->fd();
+  if (fd < 0)
+    return -1;
+  out.flush();
+  if (fd == STDOUT_FILENO)
+    std::fflush(stdout);
+  else if (fd == STDERR_FILENO)
+    std::fflush(stderr);
+  return fd;
+#endif
+}
+
+int input_fd(std::istream &in) {
+  std::streambuf *const source = source_buf(in);
+#ifndef _WIN32
+  if (source == g_stdin_buf) {
+    const bool unbuffered_tty =
+        isatty(STDIN_FILENO) && source->in_avail() <= 0;
+    return unbuffered_tty ? STDIN_FILENO : -1;
+  }
+#endif
+  auto *buf = dynamic_cast<FdStreamBuf *>(source);
+  if (!buf || buf->buffered_input() > 0)
+    return -1;
+  return buf->fd();
+}
+
+std::int64_t transfer_fd(int in_fd, int out_fd) {
+  std::int64_t total = 0;
+#ifdef __linux__
+  switch (kernel_copy(in_fd, out_fd, total)) {
+  case KernelCopy::Done:
+    return total;
+  case KernelCopy::Error:
+    return -1;
+  case KernelCopy::Unsupported:
+    break;
+  }
+#endif
+  std::vector<char> buf(kIoBufSize);
+  while (true) {
+    long long n = sys_read(in_fd, buf.data(), buf.size());
+    if (n == 0)
+      return total;
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (!write_all(out_fd, buf.data(), static_cast<std::size_t>(n)))
+      return errno == EPIPE ? total : -1;
+    total += n;
+  }
+}
+
+} // namespace cli
@@ -0,0 +1,148 @@
+#include "cli/io_pump.hpp"
+#include "cli/fd_io.hpp"
+#include "cli/pipe_channel.hpp"
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+#ifndef _WIN32
+void set_nonblocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL);
+  if (flags >= 0)
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/** Closes fd if it is open and marks it as closed. */
+void close_fd(int &fd) {
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+}
+
+/** Reads what is available on a ready output pipe into `o` and adds it to
+ * `drained`; closes the pipe at EOF, on error, or once the consumer of `o`
+ * has finished. */
+void drain(int &fd, std::vector<char> &buf, std::ostream &o,
+           std::uint64_t &drained) {
+  const ssize_t n = read(fd, buf.data(), buf.size());
+  if (n > 0) {
+    drained += static_cast<std::uint64_t>(n);
+    o.write(buf.data(), n);
+    if (output_closed(o))
+      close_fd(fd);
+  } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+    close_fd(fd);
+  }
+}
+#endif
+
+} // namespace
+
+IoPump::IoPump() : in_buf_(kBufferSize), out_buf_(kBufferSize) {}
+
+bool IoPump::can_pump_input(std::istream &in) {
+  return input_fd(in) >= 0 || dynamic_cast<std::stringbuf *>(in.rdbuf());
+}
+
+void IoPump::run(std::istream &in, int stdin_fd, int stdout_fd,
+                 std::ostream &out, int stderr_fd, std::ostream &err) {
+#ifdef _WIN32
+  (void)in;
+  (void)stdin_fd;
+  (void)stdout_fd;
+  (void)out;
+  (void)stderr_fd;
+  (void)err;
+#else
+  bytes_in_ = 0;
+  bytes_out_ = 0;
+  std::uint64_t stderr_bytes = 0;
+  std::signal(SIGPIPE, SIG_IGN);
+  for (int fd : {stdin_fd, stdout_fd, stderr_fd}) {
+    if (fd >= 0)
+      set_nonblocking(fd);
+  }
+  const int src_fd = stdin_fd >= 0 ? input_fd(in) : -1;
+  bool source_done = stdin_fd < 0;
+  bool child_stopped_reading = false;
+  // in_buf_[offset, offset + pending) is still to be written to the child.
+  std::size_t offset = 0;
+  std::size_t pending = 0;
+
+  while (stdin_fd >= 0 || stdout_fd >= 0 || stderr_fd >= 0) {
+    if (stdin_fd >= 0 && pending == 0 && !source_done && src_fd < 0) {
+      in.read(in_buf_.data(), static_cast<std::streamsize>(in_buf_.size()));
+      pending = static_cast<std::size_t>(in.gcount());
+      offset = 0;
+      source_done = pending == 0;
+    }
+    if (stdin_fd >= 0 && pending == 0 && source_done)
+      close_fd(stdin_fd);
+
+    pollfd fds[4];
+    nfds_t count = 0;
+    auto watch = [&](int fd, short events) {
+      if (fd < 0)
+        return -1;
+      fds[count] = {fd, events, 0};
+      return static_cast<int>(count++);
+    };
+    const bool need_input = stdin_fd >= 0 && pending == 0 && !source_done;
+    const int src_slot = watch(need_input ? src_fd : -1, POLLIN);
+    const int in_slot = watch(pending > 0 ? stdin_fd : -1, POLLOUT);
+    const int out_slot = watch(stdout_fd, POLLIN);
+    const int err_slot = watch(stderr_fd, POLLIN);
+    if (count == 0)
+      continue;
+    if (poll(fds, count, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    auto ready = [&](int slot) { return slot >= 0 && fds[slot].revents; };
+
+    if (ready(src_slot)) {
+      const ssize_t n = read(src_fd, in_buf_.data(), in_buf_.size());
+      if (n > 0) {
+        pending = static_cast<std::size_t>(n);
+        offset = 0;
+        count_input(in, pending);
+      } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+        source_done = true;
+      }
+    }
+    if (ready(in_slot)) {
+      const ssize_t n = write(stdin_fd, in_buf_.data() + offset, pending);
+      if (n > 0) {
+        offset += static_cast<std::size_t>(n);
+        pending -= static_cast<std::size_t>(n);
+        bytes_in_ += static_cast<std::uint64_t>(n);
+      } else if (n < 0 && errno != EINTR && errno != EAGAIN) {
+        child_stopped_reading = errno == EPIPE;
+        close_fd(stdin_fd);
+      }
+    }
+    if (ready(out_slot))
+      drain(stdout_fd, out_buf_, out, bytes_out_);
+    if (ready(err_slot))
+      drain(stderr_fd, out_buf_, err, stderr_bytes);
+  }
+  close_fd(stdin_fd);
+  close_fd(stdout_fd);
+  close_fd(stderr_fd);
+  if (child_stopped_reading)
+    close_input(in);
+#endif
+}
+
+} // namespace cli
@@ -0,0 +1,142 @@
+#include "cli/job_table.hpp"
+#include <charconv>
+
+namespace cli {
+
+JobTable::~JobTable() { wait_all(); }
+
+int JobTable::start(std::string command, std::function<int()> body,
+                    ThreadPool *pool) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int id = jobs_.empty() ? 1 : jobs_.rbegin()->first + 1;
+  auto job = std::make_unique<Job>();
+  job->status.id = id;
+  job->status.command = std::move(command);
+  Job *raw = job.get();
+  // Inserted before the task starts, so the task always finds its entry;
+  // the entry is only dropped once the task has marked it done.
+  jobs_.emplace(id, std::move(job));
+  try {
+    raw->task = run_concurrently(pool, [this, raw, body = std::move(body)] {
+      int code = 1;
+      try {
+        code = body();
+      } catch (...) {
+      }
+      {
+        std::lock_guard<std::mutex> done_lock(mutex_);
+        raw->status.done = true;
+        raw->status.exit_code = code;
+      }
+      finished_.notify_all();
+    });
+  } catch (...) {
+    jobs_.erase(id);
+    throw;
+  }
+  return id;
+}
+
+std::vector<JobTable::Status> JobTable::list(bool forget_finished) {
+  std::vector<Status> result;
+  std::vector<std::unique_ptr<Job>> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result.reserve(jobs_.size());
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+      result.push_back(it->second->status);
+      if (forget_finished && it->second->status.done) {
+        finished.push_back(std::move(it->second));
+        it = jobs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<JobTable::Status> JobTable::take_finished() {
+  std::vector<Status> result;
+  std::vector<std::unique_ptr<Job>> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = jobs_.begin(); it != jobs_.end();) {
+      if (it->second->status.done) {
+        result.push_back(it->second->status);
+        finished.push_back(std::move(it->second));
+        it = jobs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return result;
+}
+
+std::optional<int> JobTable::wait(int id) {
+  std::unique_ptr<Job> job;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = jobs_.end();
+    // Another thread may take the job while this one waits, so look it up
+    // again after every wake-up.
+    finished_.wait(lock, [&] {
+      it = jobs_.find(id);
+      return it == jobs_.end() || it->second->status.done;
+    });
+    if (it == jobs_.end())
+      return std::nullopt;
+    job = std::move(it->second);
+    jobs_.erase(it);
+  }
+  // Destroying the handle joins the task, which has already finished.
+  return job->status.exit_code;
+}
+
+void JobTable::wait_all() {
+  std::map<int, std::unique_ptr<Job>> jobs;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] {
+      for (const auto &entry : jobs_) {
+        if (!entry.second->status.done)
+          return false;
+      }
+      return true;
+    });
+    jobs.swap(jobs_);
+  }
+}
+
+std::optional<int> JobTable::current() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (jobs_.empty())
+    return std::nullopt;
+  return jobs_.rbegin()->first;
+}
+
+std::optional<int> JobTable::parse_spec(const std::string &spec) {
+  const char *first = spec.data();
+  const char *last = spec.data() + spec.size();
+  if (first != last && *first == '%')
+    ++first;
+  int id = 0;
+  auto [end, ec] = std::from_chars(first, last, id);
+  if (first == last || ec != std::errc{} || end != last || id <= 0)
+    return std::nullopt;
+  return id;
+}
+
+std::string JobTable::describe(const Status &status) {
+  std::string state = "Running";
+  if (status.done) {
+    state = status.exit_code == 0
+                ? "Done"
+                : "Exit " + std::to_string(status.exit_code);
+  }
+  return "[" + std::to_string(status.id) + "] " + state + "\t" +
+         status.command;
+}
+
+} // namespace cli
@@ -0,0 +1,175 @@
+#include "cli/operator_fusion.hpp"
+#include "cli/byte_stream.hpp"
+#include "cli/commands/cat_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/text_kernels.hpp"
+#include "cli/commands/wc_command.hpp"
+#include <span>
+#include <sstream>
+#include <string_view>
+
+namespace cli {
+
+namespace {
+
+/// Read size of the fused operators.
+constexpr std::size_t kReadSize = 64 * 1024;
+
+/** Built-in of `stage` if it is a `T`, otherwise null. */
+template <typename T> T *builtin_as(const BoundStage &stage) {
+  return dynamic_cast<T *>(stage.builtin);
+}
+
+/** Reads `in` to the end, passing every chunk to `on_chunk`. */
+template <typename OnChunk>
+void read_chunks(std::istream &in, std::vector<char> &buf,
+                 OnChunk &&on_chunk) {
+  while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) ||
+         in.gcount() > 0)
+    on_chunk(buf.data(), static_cast<std::size_t>(in.gcount()));
+}
+
+/** Passes every chunk of a file to `on_chunk`, in place from the mapping
+ * for a regular file. */
+template <typename OnChunk>
+void file_chunks(FileByteSource &f, OnChunk &&on_chunk) {
+  for (std::span<const char> chunk = f.next(); !chunk.empty();
+       chunk = f.next())
+    on_chunk(chunk.data(), chunk.size());
+}
+
+/** Passes what `cat args` would write to `on_chunk`; reports errors like
+ * CatCommand. Returns cat's exit code. */
+template <typename OnChunk>
+int cat_chunks(const std::vector<std::string> &args, std::istream &in,
+               std::ostream &err, OnChunk &&on_chunk) {
+  if (args.size() < 2) {
+    std::vector<char> buf(kReadSize);
+    read_chunks(in, buf, on_chunk);
+    return 0;
+  }
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    FileByteSource f(args[i]);
+    if (!f.is_open()) {
+      err << "cat: cannot open '" << args[i] << "'\n";
+      return 1;
+    }
+    file_chunks(f, on_chunk);
+    if (f.failed()) {
+      err << "cat: read error '" << args[i] << "'\n";
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Counts what grep prints for one input, without building the lines. */
+class GrepCounter {
+public:
+  GrepCounter(const GrepOptions &options, std::string_view prefix,
+              WcCounts &counts)
+      : selector_(options), prefix_(prefix), counts_(counts) {}
+
+  void feed(const char *data, std::size_t n) {
+    splitter_.feed(selector_, data, n,
+                   [this](std::string_view line) { count(line); });
+  }
+
+  void finish() {
+    splitter_.finish([this](std::string_view line) { count(line); });
+  }
+
+private:
+  void count(std::string_view line) {
+    if (!selector_.select(line))
+      return;
+    counts_.add(prefix_);
+    counts_.add(line);
+    counts_.add("\n", 1);
+  }
+
+  LineSelector selector_;
+  LineSplitter splitter_;
+  std::string_view prefix_;
+  WcCounts &counts_;
+};
+
+/** `grep ... [FILE...] | wc`: counts grep's output for its files or `in`. */
+void grep_files_into(const GrepOptions &options, std::istream &in,
+                     std::ostream &err, WcCounts &counts) {
+  if (options.files.empty()) {
+    std::vector<char> buf(kReadSize);
+    GrepCounter counter(options, {}, counts);
+    read_chunks(in, buf, [&](const char *data, std::size_t n) {
+      counter.feed(data, n);
+    });
+    counter.finish();
+    return;
+  }
+  for (const std::string &path : options.files) {
+    FileByteSource f(path);
+    if (!f.is_open()) {
+      err << "grep: cannot open '" << path << "'\n";
+      return;
+    }
+    const std::string prefix =
+        options.files.size() > 1 ? path + ":" : std::string();
+    GrepCounter counter(options, prefix, counts);
+    file_chunks(f, [&](const char *data, std::size_t n) {
+      counter.feed(data, n);
+    });
+    counter.finish();
+  }
+}
+
+/** Grep options of `stage` if they are valid; errors are left for the
+ * unfused path to report. */
+std::optional<GrepOptions> fusable_grep_options(const BoundStage &stage) {
+  if (!builtin_as<GrepCommand>(stage))
+    return std::nullopt;
+  std::ostringstream ignored;
+  return parse_grep_options(stage.args, ignored);
+}
+
+} // namespace
+
+bool fusion_enabled(const Environment &env) {
+  return env.get("CLI_FUSION") != "0" && env.get("CLI_SPILL_DEBUG").empty();
+}
+
+std::optional<int> run_fused_pipeline(const std::vector<BoundStage> &stages,
+                                      std::istream &in, std::ostream &out,
+                                      std::ostream &err) {
+  if (stages.size() < 2 || stages.size() > 3)
+    return std::nullopt;
+  const BoundStage &last = stages.back();
+  if (!builtin_as<WcCommand>(last) || last.args.size() != 1)
+    return std::nullopt;
+
+  WcCounts counts;
+  if (stages.size() == 2) {
+    if (builtin_as<CatCommand>(stages[0])) {
+      cat_chunks(stages[0].args, in, err,
+                 [&](const char *data, std::size_t n) { counts.add(data, n); });
+    } else if (std::optional<GrepOptions> options =
+                   fusable_grep_options(stages[0])) {
+      grep_files_into(*options, in, err, counts);
+    } else {
+      return std::nullopt;
+    }
+  } else {
+    if (!builtin_as<CatCommand>(stages[0]))
+      return std::nullopt;
+    std::optional<GrepOptions> options = fusable_grep_options(stages[1]);
+    if (!options || !options->files.empty())
+      return std::nullopt;
+    GrepCounter counter(*options, {}, counts);
+    cat_chunks(stages[0].args, in, err,
+               [&](const char *data, std::size_t n) { counter.feed(data, n); });
+    counter.finish();
+  }
+  out << counts.format("");
+  return 0;
+}
+
+} // namespace cli
@@ -100,6 +100,54 @@ std::vector<std::string> split_by_pipe(const std::string &line) {
   return segments;
 }
 
+/** Split line at `;`, `&&` and `||` outside quotes. The first item gets
+ * ListOperator::Sequence; each later one the operator before it. */
+std::vector<std::pair<ListOperator, std::string>>
+split_by_list_operator(const std::string &line) {
+  std::vector<std::pair<ListOperator, std::string>> items;
+  ListOperator op = ListOperator::Sequence;
+  std::size_t start = 0;
+  bool in_single = false;
+  bool in_double = false;
+  const std::size_t n = line.size();
+  auto cut = [&](std::size_t end, ListOperator next, std::size_t skip) {
+    items.emplace_back(op, line.substr(start, end - start));
+    op = next;
+    start = end + skip;
+  };
+  for (std::size_t i = 0; i < n; ++i) {
+    const char c = line[i];
+    if (in_single) {
+      if (c == '\\')
+        ++i;
+      else if (c == '\'')
+        in_single = false;
+      continue;
+    }
+    if (in_double) {
+      if (c == '"')
+        in_double = false;
+      continue;
+    }
+    const bool doubled = i + 1 < n && line[i + 1] == c;
+    if (c == '\'') {
+      in_single = true;
+    } else if (c == '"') {
+      in_double = true;
+    } else if (c == ';') {
+      cut(i, ListOperator::Sequence, 1);
+    } else if (c == '&' && doubled) {
+      cut(i, ListOperator::And, 2);
+      ++i;
+    } else if (c == '|' && doubled) {
+      cut(i, ListOperator::Or, 2);
+      ++i;
+    }
+  }
+  cut(n, ListOperator::Sequence, 0);
+  return items;
+}
+
 /** Tokenize one pipeline segment; fill tokens and substitute flags (Single=No,
  * Double/Unquoted=Yes). */
 void tokenize_segment(const std::string &segment,
@@ -168,6 +216,45 @@ void tokenize_segment(const std::string &segment,
   flush_token(Substitute::Yes);
 }
 
+/** Index of a trailing `&` outside quotes that is not part of `&&`, or npos
+ * if the line does not end with one. */
+std::size_t background_marker(const std::string &line) {
+  bool in_single = false;
+  bool in_double = false;
+  std::size_t last = std::string::npos; // last non-space character
+  bool last_quoted = false;
+  const std::size_t n = line.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    const char c = line[i];
+    if (in_single) {
+      if (c == '\\')
+        ++i;
+      else if (c == '\'')
+        in_single = false;
+      last = i;
+      last_quoted = true;
+      continue;
+    }
+    if (in_double) {
+      if (c == '"')
+        in_double = false;
+      last = i;
+      last_quoted = true;
+      continue;
+    }
+    if (is_space(c))
+      continue;
+    in_single = c == '\'';
+    in_double = c == '"';
+    last = i;
+    last_quoted = false;
+  }
+  if (in_single || in_double || last == std::string::npos || last_quoted ||
+      line[last] != '&' || (last > 0 && line[last - 1] == '&'))
+    return std::string::npos;
+  return last;
+}
+
 bool segment_empty_or_whitespace(const std::string &s) {
   return std::all_of(
       s.begin(), s.end(),
@@ -230,4 +317,31 @@ std::optional<Pipeline> Parser::parse(const std::string &line) {
   return pipeline;
 }
 
+std::optional<Pipeline> Parser::parse(const std::string &line,
+                                      bool &background) {
+  const std::size_t marker = background_marker(line);
+  background = marker != std::string::npos;
+  if (!background)
+    return parse(line);
+  return parse(line.substr(0, marker));
+}
+
+std::optional<CommandList> Parser::parse_list(const std::string &line,
+                                              bool &background) {
+  const std::size_t marker = background_marker(line);
+  background = marker != std::string::npos;
+  CommandList list;
+  for (auto &[op, text] : split_by_list_operator(
+           background ? line.substr(0, marker) : line)) {
+    ListItem item;
+    item.op = op;
+    if (std::optional<Pipeline> pipeline = parse(text))
+      item.pipeline = std::move(*pipeline);
+    list.push_back(std::move(item));
+  }
+  if (list.size() == 1 && list[0].pipeline.empty())
+    return std::nullopt;
+  return list;
+}
+
 } // namespace cli
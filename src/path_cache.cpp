@@ -0,0 +1,163 @@
+#include "cli/path_cache.hpp"
+#include "cli/external_command.hpp"
+#include <algorithm>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+/** Directories of a `PATH` value, split the way ExternalCommand::resolve()
+ * splits it. */
+std::vector<std::string> split_path(const std::string &value) {
+#ifdef _WIN32
+  const char *separators = ";";
+#else
+  const char *separators = ":;";
+#endif
+  std::vector<std::string> dirs;
+  std::size_t start = 0;
+  while (start <= value.size()) {
+    std::size_t end = value.find_first_of(separators, start);
+    if (end == std::string::npos)
+      end = value.size();
+    if (end > start)
+      dirs.push_back(value.substr(start, end - start));
+    start = end + 1;
+  }
+  return dirs;
+}
+
+#ifdef __linux__
+/// Changes of a watched directory that can change a lookup result.
+constexpr std::uint32_t kWatchEvents = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_ATTRIB |
+                                       IN_DELETE_SELF | IN_MOVE_SELF |
+                                       IN_ONLYDIR;
+#endif
+
+} // namespace
+
+PathCache::PathCache() = default;
+
+PathCache::~PathCache() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+#endif
+}
+
+std::string PathCache::resolve(const Environment &env,
+                               const std::string &name) {
+  if (name.find_first_of("/\\") != std::string::npos)
+    return ExternalCommand::resolve(env, name);
+  std::lock_guard<std::mutex> lock(mutex_);
+  validate_locked(env);
+  auto it = entries_.find(name);
+  if (it != entries_.end())
+    return it->second.empty() ? name : it->second;
+  std::string found = ExternalCommand::resolve(env, name);
+  entries_.emplace(name, found == name ? std::string() : found);
+  return found;
+}
+
+std::uint64_t PathCache::validate(const Environment &env) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  validate_locked(env);
+  return generation_;
+}
+
+void PathCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drop_entries();
+}
+
+void PathCache::set_watch(bool watch) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (watch == watch_)
+    return;
+  watch_ = watch;
+  // Set the directories up again (see validate_locked) on the next lookup.
+  initialized_ = false;
+  drop_entries();
+}
+
+bool PathCache::watch() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return watch_;
+}
+
+std::vector<std::pair<std::string, std::string>> PathCache::entries() const {
+  std::vector<std::pair<std::string, std::string>> out;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.assign(entries_.begin(), entries_.end());
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+void PathCache::validate_locked(const Environment &env) {
+  std::string value = env.get("PATH");
+  if (!initialized_ || value != path_value_) {
+    path_value_ = std::move(value);
+    initialized_ = true;
+  } else if (!dirs_changed()) {
+    return;
+  }
+  // Watches are set up again after any change, since a removed or renamed
+  // directory loses its watch.
+  watch_dirs();
+  drop_entries();
+}
+
+void PathCache::watch_dirs() {
+  polled_.clear();
+#ifdef __linux__
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+  inotify_fd_ = watch_ ? inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1;
+#endif
+  for (std::string &dir : split_path(path_value_)) {
+#ifdef __linux__
+    if (inotify_fd_ >= 0 &&
+        inotify_add_watch(inotify_fd_, dir.c_str(), kWatchEvents) >= 0)
+      continue;
+#endif
+    PolledDir polled{std::move(dir), {}, false};
+    std::error_code ec;
+    polled.mtime = std::filesystem::last_write_time(polled.path, ec);
+    polled.exists = !ec;
+    polled_.push_back(std::move(polled));
+  }
+}
+
+bool PathCache::dirs_changed() {
+  bool changed = false;
+#ifdef __linux__
+  if (inotify_fd_ >= 0) {
+    alignas(inotify_event) char buf[4096];
+    while (read(inotify_fd_, buf, sizeof(buf)) > 0)
+      changed = true;
+  }
+#endif
+  for (const PolledDir &dir : polled_) {
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(dir.path, ec);
+    if (!ec != dir.exists || (dir.exists && mtime != dir.mtime))
+      changed = true;
+  }
+  return changed;
+}
+
+void PathCache::drop_entries() {
+  entries_.clear();
+  ++generation_;
+}
+
+} // namespace cli
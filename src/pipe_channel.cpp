@@ -0,0 +1,146 @@
+#include "cli/pipe_channel.hpp"
+#include "cli/fd_io.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace cli {
+
+namespace {
+
+/// Size of the local buffer kept by each channel stream buffer.
+constexpr std::size_t kStreamBufSize = 16 * 1024;
+
+} // namespace
+
+PipeChannel::PipeChannel(std::size_t capacity)
+    : buffer_(std::max<std::size_t>(capacity, 1)) {}
+
+std::size_t PipeChannel::write(const char *data, std::size_t n) {
+  std::size_t written = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (written < n) {
+    not_full_.wait(lock,
+                   [this] { return read_closed_ || size_ < buffer_.size(); });
+    if (read_closed_)
+      break;
+    const std::size_t cap = buffer_.size();
+    const std::size_t tail = (head_ + size_) % cap;
+    const std::size_t chunk =
+        std::min({n - written, cap - size_, cap - tail});
+    std::memcpy(buffer_.data() + tail, data + written, chunk);
+    size_ += chunk;
+    written += chunk;
+    not_empty_.notify_one();
+  }
+  return written;
+}
+
+std::size_t PipeChannel::read(char *data, std::size_t n) {
+  if (n == 0)
+    return 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_empty_.wait(lock, [this] { return size_ > 0 || write_closed_; });
+  const std::size_t cap = buffer_.size();
+  std::size_t total = 0;
+  while (total < n && size_ > 0) {
+    const std::size_t chunk = std::min({n - total, size_, cap - head_});
+    std::memcpy(data + total, buffer_.data() + head_, chunk);
+    head_ = (head_ + chunk) % cap;
+    size_ -= chunk;
+    total += chunk;
+  }
+  if (total > 0)
+    not_full_.notify_one();
+  return total;
+}
+
+void PipeChannel::close_write() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  write_closed_ = true;
+  not_empty_.notify_all();
+}
+
+void PipeChannel::close_read() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  read_closed_ = true;
+  size_ = 0;
+  not_full_.notify_all();
+}
+
+ChannelReadBuf::ChannelReadBuf(PipeChannel &channel)
+    : channel_(channel), buffer_(kStreamBufSize) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+ChannelReadBuf::int_type ChannelReadBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  std::size_t n = channel_.read(buffer_.data(), buffer_.size());
+  if (n == 0)
+    return traits_type::eof();
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+ChannelWriteBuf::ChannelWriteBuf(PipeChannel &channel)
+    : channel_(channel), buffer_(kStreamBufSize) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool ChannelWriteBuf::flush_buffer() {
+  const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  if (failed_)
+    return false;
+  if (pending > 0 && channel_.write(buffer_.data(), pending) < pending)
+    failed_ = true;
+  return !failed_;
+}
+
+ChannelWriteBuf::int_type ChannelWriteBuf::overflow(int_type ch) {
+  if (!flush_buffer())
+    return traits_type::eof();
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
+
+std::streamsize ChannelWriteBuf::xsputn(const char *s, std::streamsize n) {
+  const std::size_t len = static_cast<std::size_t>(n);
+  if (len <= static_cast<std::size_t>(epptr() - pptr())) {
+    std::memcpy(pptr(), s, len);
+    pbump(static_cast<int>(n));
+    return n;
+  }
+  // Large write: hand it to the channel directly instead of chunking it
+  // through the local buffer.
+  if (!flush_buffer())
+    return 0;
+  std::size_t written = channel_.write(s, len);
+  if (written < len)
+    failed_ = true;
+  return static_cast<std::streamsize>(written);
+}
+
+int ChannelWriteBuf::sync() { return flush_buffer() ? 0 : -1; }
+
+void ChannelWriteBuf::close() {
+  flush_buffer();
+  channel_.close_write();
+}
+
+void close_input(std::istream &in) {
+  if (auto *buf = dynamic_cast<ChannelReadBuf *>(source_buf(in)))
+    buf->channel().close_read();
+}
+
+bool output_closed(std::ostream &out) {
+  if (out.bad())
+    return true;
+  auto *buf = dynamic_cast<ChannelWriteBuf *>(sink_buf(out));
+  return buf && buf->channel().read_closed();
+}
+
+} // namespace cli
@@ -0,0 +1,167 @@
+#include "cli/spill_buffer.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+/// Chunk size for writing to and reading back from the spill file.
+constexpr std::size_t kFileChunk = 64 * 1024;
+
+/// Smallest in-memory allocation made by the buffer.
+constexpr std::size_t kMinMemory = 4096;
+
+/** Opens an anonymous temporary file that disappears when closed. */
+std::FILE *open_spill_file() {
+#if defined(__linux__) && defined(O_TMPFILE)
+  const char *dir = std::getenv("TMPDIR");
+  if (!dir || !*dir)
+    dir = "/tmp";
+  int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  if (fd >= 0) {
+    if (std::FILE *f = fdopen(fd, "w+b"))
+      return f;
+    close(fd);
+  }
+#endif
+  return std::tmpfile();
+}
+
+} // namespace
+
+SpillBuffer::SpillBuffer(std::size_t memory_limit, FileOpener open_file)
+    : limit_(memory_limit),
+      open_file_(open_file ? open_file : &open_spill_file) {}
+
+SpillBuffer::~SpillBuffer() {
+  if (file_)
+    std::fclose(file_);
+}
+
+void SpillBuffer::set_put_area(char *begin, std::size_t used, char *end) {
+  setp(begin, end);
+  while (used > static_cast<std::size_t>(INT_MAX)) {
+    pbump(INT_MAX);
+    used -= static_cast<std::size_t>(INT_MAX);
+  }
+  pbump(static_cast<int>(used));
+}
+
+bool SpillBuffer::spill() {
+  std::FILE *file = open_file_();
+  if (!file) {
+    failed_ = true;
+    return false;
+  }
+  // Writes are already chunked here, and unbuffered writes report a full
+  // disk at the call that hit it rather than at some later flush.
+  std::setvbuf(file, nullptr, _IONBF, 0);
+  const std::size_t used = static_cast<std::size_t>(pptr() - pbase());
+  if (used > 0 && std::fwrite(memory_.data(), 1, used, file) != used) {
+    // Keep the data in memory, where it is still readable.
+    std::fclose(file);
+    failed_ = true;
+    return false;
+  }
+  file_ = file;
+  spilled_bytes_ += used;
+  memory_.clear();
+  memory_.shrink_to_fit();
+  io_buf_.resize(kFileChunk);
+  setp(io_buf_.data(), io_buf_.data() + io_buf_.size());
+  return true;
+}
+
+bool SpillBuffer::flush_to_file() {
+  const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+  setp(io_buf_.data(), io_buf_.data() + io_buf_.size());
+  if (pending > 0 &&
+      std::fwrite(io_buf_.data(), 1, pending, file_) != pending) {
+    failed_ = true;
+    return false;
+  }
+  spilled_bytes_ += pending;
+  return true;
+}
+
+SpillBuffer::int_type SpillBuffer::overflow(int_type ch) {
+  if (reading_ || failed_)
+    return traits_type::eof();
+  if (!file_) {
+    const std::size_t used = static_cast<std::size_t>(pptr() - pbase());
+    if (used < limit_) {
+      const std::size_t grown =
+          std::min(limit_, std::max(used * 2, kMinMemory));
+      memory_.resize(grown);
+      set_put_area(memory_.data(), used, memory_.data() + memory_.size());
+    } else if (!spill()) {
+      return traits_type::eof();
+    }
+  } else if (!flush_to_file()) {
+    return traits_type::eof();
+  }
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
+
+int SpillBuffer::sync() {
+  if (failed_)
+    return -1;
+  if (!reading_ && file_ && !flush_to_file())
+    return -1;
+  return 0;
+}
+
+bool SpillBuffer::start_reading() {
+  if (file_) {
+    if (failed_ || (!reading_ && !flush_to_file()))
+      return false;
+    std::rewind(file_);
+    setg(io_buf_.data(), io_buf_.data(), io_buf_.data());
+  } else {
+    const std::size_t used =
+        reading_ ? static_cast<std::size_t>(egptr() - eback())
+                 : static_cast<std::size_t>(pptr() - pbase());
+    setg(memory_.data(), memory_.data(), memory_.data() + used);
+  }
+  setp(nullptr, nullptr);
+  reading_ = true;
+  return true;
+}
+
+SpillBuffer::int_type SpillBuffer::underflow() {
+  if (!reading_)
+    return traits_type::eof();
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (!file_)
+    return traits_type::eof();
+  const std::size_t n = std::fread(io_buf_.data(), 1, io_buf_.size(), file_);
+  if (n == 0)
+    return traits_type::eof();
+  setg(io_buf_.data(), io_buf_.data(), io_buf_.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+void SpillBuffer::clear() {
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  reading_ = false;
+  failed_ = false;
+  setg(nullptr, nullptr, nullptr);
+  set_put_area(memory_.data(), 0, memory_.data() + memory_.size());
+}
+
+} // namespace cli
@@ -0,0 +1,141 @@
+#include "cli/stage_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace cli {
+
+namespace {
+
+/// Unit of `ru_inblock` and `ru_oublock`.
+constexpr std::uint64_t kBlockSize = 512;
+
+#ifndef _WIN32
+double seconds(const timeval &tv) { return tv.tv_sec + tv.tv_usec / 1e6; }
+
+long rss_kib(const rusage &usage) {
+#ifdef __APPLE__
+  return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+  return static_cast<long>(usage.ru_maxrss);
+#endif
+}
+
+/** Usage of the calling thread where the platform reports it, otherwise of
+ * the whole process. */
+bool thread_usage(rusage &usage) {
+#ifdef RUSAGE_THREAD
+  return getrusage(RUSAGE_THREAD, &usage) == 0;
+#else
+  return getrusage(RUSAGE_SELF, &usage) == 0;
+#endif
+}
+#endif
+
+/** A byte count as printed in the report; "-" if unknown. */
+std::string byte_count(const std::optional<std::uint64_t> &bytes) {
+  return bytes ? std::to_string(*bytes) : "-";
+}
+
+void print_row(std::ostream &out, const StageStats &stats,
+               const std::string &name) {
+  char line[200];
+  std::snprintf(line, sizeof(line),
+                "%8.3f %8.3f %8.3f %10ld %6ld %6ld %12s %12s %12llu %12llu  ",
+                stats.real_seconds, stats.user_seconds, stats.system_seconds,
+                stats.max_rss_kib, stats.voluntary_switches,
+                stats.involuntary_switches, byte_count(stats.bytes_in).c_str(),
+                byte_count(stats.bytes_out).c_str(),
+                static_cast<unsigned long long>(stats.block_bytes_read),
+                static_cast<unsigned long long>(stats.block_bytes_written));
+  out << line << name << '\n';
+}
+
+} // namespace
+
+ThreadUsageMeter::ThreadUsageMeter()
+    : start_(std::chrono::steady_clock::now()) {
+#ifndef _WIN32
+  rusage usage{};
+  if (!thread_usage(usage))
+    return;
+  user_ = seconds(usage.ru_utime);
+  system_ = seconds(usage.ru_stime);
+  voluntary_ = usage.ru_nvcsw;
+  involuntary_ = usage.ru_nivcsw;
+  in_blocks_ = usage.ru_inblock;
+  out_blocks_ = usage.ru_oublock;
+#endif
+}
+
+void ThreadUsageMeter::stop(StageStats &stats) const {
+  stats.real_seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count();
+#ifndef _WIN32
+  rusage usage{};
+  if (!thread_usage(usage))
+    return;
+  stats.user_seconds = seconds(usage.ru_utime) - user_;
+  stats.system_seconds = seconds(usage.ru_stime) - system_;
+  stats.voluntary_switches = usage.ru_nvcsw - voluntary_;
+  stats.involuntary_switches = usage.ru_nivcsw - involuntary_;
+  stats.block_bytes_read =
+      static_cast<std::uint64_t>(usage.ru_inblock - in_blocks_) * kBlockSize;
+  stats.block_bytes_written =
+      static_cast<std::uint64_t>(usage.ru_oublock - out_blocks_) * kBlockSize;
+  // Linux reports the peak of the whole process for RUSAGE_THREAD too.
+  stats.max_rss_kib = rss_kib(usage);
+#endif
+}
+
+void set_child_usage(StageStats &stats, const struct rusage &usage) {
+#ifdef _WIN32
+  (void)stats;
+  (void)usage;
+#else
+  stats.user_seconds = seconds(usage.ru_utime);
+  stats.system_seconds = seconds(usage.ru_stime);
+  stats.max_rss_kib = rss_kib(usage);
+  stats.voluntary_switches = usage.ru_nvcsw;
+  stats.involuntary_switches = usage.ru_nivcsw;
+  stats.block_bytes_read =
+      static_cast<std::uint64_t>(usage.ru_inblock) * kBlockSize;
+  stats.block_bytes_written =
+      static_cast<std::uint64_t>(usage.ru_oublock) * kBlockSize;
+#endif
+}
+
+void print_stage_stats(std::ostream &out,
+                       const std::vector<StageStats> &stages,
+                       double real_seconds) {
+  char header[200];
+  std::snprintf(header, sizeof(header),
+                "%8s %8s %8s %10s %6s %6s %12s %12s %12s %12s  %s\n", "real",
+                "user", "sys", "maxrss KiB", "vcsw", "ivcsw", "in B", "out B",
+                "blk read B", "blk write B", "command");
+  out << header;
+  StageStats total;
+  total.real_seconds = real_seconds;
+  for (const StageStats &stage : stages) {
+    print_row(out, stage, stage.name);
+    total.user_seconds += stage.user_seconds;
+    total.system_seconds += stage.system_seconds;
+    total.max_rss_kib = std::max(total.max_rss_kib, stage.max_rss_kib);
+    total.voluntary_switches += stage.voluntary_switches;
+    total.involuntary_switches += stage.involuntary_switches;
+    total.block_bytes_read += stage.block_bytes_read;
+    total.block_bytes_written += stage.block_bytes_written;
+  }
+  if (!stages.empty()) {
+    total.bytes_in = stages.front().bytes_in;
+    total.bytes_out = stages.back().bytes_out;
+  }
+  print_row(out, total, "total");
+}
+
+} // namespace cli
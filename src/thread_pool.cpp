@@ -0,0 +1,258 @@
+#include "cli/thread_pool.hpp"
+#include <chrono>
+
+namespace cli {
+
+namespace {
+
+/// Pool and deque index of the calling worker thread (null outside pools).
+thread_local ThreadPool *current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+/// How long a worker waiting for a task sleeps between attempts to help.
+constexpr std::chrono::milliseconds kHelpInterval{1};
+
+} // namespace
+
+void TaskHandle::State::run(const std::function<void()> &fn) {
+  try {
+    fn();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  cv.notify_all();
+}
+
+TaskHandle &TaskHandle::operator=(TaskHandle &&other) noexcept {
+  if (this != &other) {
+    try {
+      wait();
+    } catch (...) {
+    }
+    state_ = std::move(other.state_);
+  }
+  return *this;
+}
+
+TaskHandle::~TaskHandle() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void TaskHandle::wait() {
+  if (!state_)
+    return;
+  std::shared_ptr<State> state = std::move(state_);
+  if (state->pool) {
+    state->pool->help_until_done(*state);
+  } else {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->done; });
+  }
+  if (state->thread.joinable())
+    state->thread.join();
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0)
+    threads = 1;
+  for (std::size_t i = 0; i < threads; ++i)
+    queues_.push_back(std::make_unique<WorkerQueue>());
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void ThreadPool::start_workers() {
+  // Called with mutex_ held. A worker counts as idle from the moment it is
+  // created, so the spawn() that starts the pool can hand its task to one.
+  if (started_)
+    return;
+  started_ = true;
+  workers_.reserve(queues_.size());
+  for (std::size_t i = 0; i < queues_.size(); ++i) {
+    workers_.emplace_back([this, i] { worker_loop(i); });
+    ++idle_;
+  }
+}
+
+std::shared_ptr<TaskHandle::State> ThreadPool::make_state() {
+  auto state = std::make_shared<TaskHandle::State>();
+  state->pool = this;
+  return state;
+}
+
+TaskHandle ThreadPool::submit(std::function<void()> fn) {
+  auto state = make_state();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    start_workers();
+    const std::size_t index = (current_pool == this)
+                                  ? current_index
+                                  : next_queue_++ % queues_.size();
+    WorkerQueue &queue = *queues_[index];
+    std::lock_guard<std::mutex> queue_lock(queue.mutex);
+    queue.tasks.push_back(Task{std::move(fn), state});
+    ++pending_;
+  }
+  wake_.notify_one();
+  return TaskHandle(state);
+}
+
+TaskHandle ThreadPool::spawn(std::function<void()> fn) {
+  auto state = make_state();
+  bool queued = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopping_)
+      start_workers();
+    if (!stopping_ && idle_ > reserved_) {
+      ++reserved_;
+      ++pending_;
+      spawned_.push_back(Task{std::move(fn), state});
+      queued = true;
+    } else {
+      ++overflow_threads_;
+    }
+  }
+  if (queued) {
+    wake_.notify_all();
+  } else {
+    state->thread = std::thread(
+        [fn = std::move(fn), raw = state.get()] { raw->run(fn); });
+  }
+  return TaskHandle(state);
+}
+
+std::size_t ThreadPool::overflow_threads() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return overflow_threads_;
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+  current_pool = this;
+  current_index = index;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --idle_;
+  }
+  for (;;) {
+    Task task;
+    if (pop_spawned(task) || pop_local(index, task) || steal(index, task)) {
+      task.state->run(task.fn);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pending_ == 0 && stopping_)
+      return;
+    ++idle_;
+    wake_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+    --idle_;
+  }
+}
+
+bool ThreadPool::pop_spawned(Task &task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (spawned_.empty())
+    return false;
+  task = std::move(spawned_.front());
+  spawned_.pop_front();
+  --reserved_;
+  --pending_;
+  return true;
+}
+
+bool ThreadPool::pop_local(std::size_t index, Task &task) {
+  WorkerQueue &queue = *queues_[index];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  --pending_;
+  return true;
+}
+
+bool ThreadPool::steal(std::size_t thief, Task &task) {
+  const std::size_t n = queues_.size();
+  for (std::size_t k = 1; k <= n; ++k) {
+    const std::size_t victim = (thief + k) % n;
+    if (victim == thief)
+      continue;
+    WorkerQueue &queue = *queues_[victim];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty())
+        continue;
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    --pending_;
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::run_pending_task() {
+  Task task;
+  const bool worker = (current_pool == this);
+  const std::size_t self = worker ? current_index : queues_.size();
+  if ((worker && pop_local(self, task)) || steal(self, task)) {
+    task.state->run(task.fn);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::help_until_done(TaskHandle::State &state) {
+  const bool worker = (current_pool == this);
+  auto done = [&state] { return state.done; };
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (state.done)
+        return;
+    }
+    if (run_pending_task())
+      continue;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (!worker) {
+      // Workers will get to the remaining tasks; nothing to help with.
+      state.cv.wait(lock, done);
+      return;
+    }
+    // A worker may be the only one able to run the task it waits for, so
+    // it keeps looking for queued work.
+    state.cv.wait_for(lock, kHelpInterval, done);
+  }
+}
+
+TaskHandle run_concurrently(ThreadPool *pool, std::function<void()> fn) {
+  if (pool)
+    return pool->spawn(std::move(fn));
+  auto state = std::make_shared<TaskHandle::State>();
+  state->thread = std::thread(
+      [fn = std::move(fn), raw = state.get()] { raw->run(fn); });
+  return TaskHandle(state);
+}
+
+} // namespace cli
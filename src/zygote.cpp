@@ -0,0 +1,319 @@
+#include "cli/zygote.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace cli {
+
+namespace {
+
+#ifdef __linux__
+/// Descriptors sent with a request: stdin, stdout, stderr, working
+/// directory, status pipe.
+constexpr std::size_t kRequestFds = 5;
+
+/// Write end of the zygote's self-pipe, written by the SIGCHLD handler.
+int g_child_exit_fd = -1;
+
+void on_child_exit(int) {
+  const int saved_errno = errno;
+  const char c = 0;
+  [[maybe_unused]] ssize_t n = write(g_child_exit_fd, &c, 1);
+  errno = saved_errno;
+}
+
+/// What the zygote writes to a status pipe.
+struct StatusMessage {
+  /// Exit code, or -1 for a failed launch.
+  int code;
+  rusage usage;
+};
+
+/** Writes the exit code and resource usage of a child to a status pipe and
+ * closes it. */
+void report_status(int status_fd, int code, const rusage &usage) {
+  const StatusMessage message{code, usage};
+  [[maybe_unused]] ssize_t n = write(status_fd, &message, sizeof(message));
+  close(status_fd);
+}
+
+/** Reaps every finished child and reports its exit code to the waiting
+ * interpreter. */
+void reap_children(std::unordered_map<pid_t, int> &waiting) {
+  int status = 0;
+  rusage usage{};
+  pid_t pid;
+  while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+    auto it = waiting.find(pid);
+    if (it == waiting.end())
+      continue;
+    report_status(it->second, WIFEXITED(status) ? WEXITSTATUS(status) : 1,
+                  usage);
+    waiting.erase(it);
+  }
+}
+
+/** Splits a request body into argv and envp (null-terminated arrays that
+ * point into `data`). Returns false if the request is malformed. */
+bool parse_request(char *data, std::size_t size, std::vector<char *> &argv,
+                   std::vector<char *> &envp) {
+  std::uint32_t counts[2];
+  if (size < sizeof(counts) || data[size - 1] != '\0')
+    return false;
+  std::memcpy(counts, data, sizeof(counts));
+  char *p = data + sizeof(counts);
+  char *end = data + size;
+  for (std::uint32_t i = 0; i < counts[0] + counts[1]; ++i) {
+    if (p >= end)
+      return false;
+    (i < counts[0] ? argv : envp).push_back(p);
+    p += std::strlen(p) + 1;
+  }
+  if (argv.empty())
+    return false;
+  argv.push_back(nullptr);
+  envp.push_back(nullptr);
+  return true;
+}
+
+/** Receives and runs one launch request. Returns false once the interpreter
+ * has closed its end of the socket. */
+bool serve_request(int sock, std::vector<char> &buf,
+                   std::unordered_map<pid_t, int> &waiting) {
+  iovec iov{buf.data(), buf.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(kRequestFds * sizeof(int))];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (n < 0)
+    return errno == EINTR;
+  if (n == 0)
+    return false;
+
+  // Keeps the first kRequestFds descriptors received; any beyond that would
+  // otherwise stay open in the zygote for good.
+  int fds[kRequestFds];
+  std::size_t nfds = 0;
+  for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+    if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+      continue;
+    const std::size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (std::size_t i = 0; i < count; ++i, ++nfds) {
+      int fd;
+      std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+      if (nfds < kRequestFds)
+        fds[nfds] = fd;
+      else
+        close(fd);
+    }
+  }
+  std::vector<char *> argv;
+  std::vector<char *> envp;
+  const bool valid =
+      nfds == kRequestFds && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) &&
+      parse_request(buf.data(), static_cast<std::size_t>(n), argv, envp);
+  pid_t pid = valid ? fork() : -1;
+  if (pid == 0) {
+    // The zygote ignores these; the program gets the usual dispositions.
+    std::signal(SIGPIPE, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGQUIT, SIG_DFL);
+    dup2(fds[0], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[2], STDERR_FILENO);
+    if (fchdir(fds[3]) != 0)
+      _exit(127);
+    execve(argv[0], argv.data(), envp.data());
+    _exit(127);
+  }
+  for (std::size_t i = 0; i < std::min(nfds, kRequestFds - 1); ++i)
+    close(fds[i]);
+  if (nfds < kRequestFds)
+    return true;
+  if (pid < 0)
+    report_status(fds[kRequestFds - 1], -1, rusage{});
+  else
+    waiting[pid] = fds[kRequestFds - 1];
+  return true;
+}
+
+/** Body of the zygote process: serves launch requests until the
+ * interpreter goes away. */
+[[noreturn]] void zygote_main(int sock) {
+  int wake[2];
+  if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0)
+    _exit(1);
+  g_child_exit_fd = wake[1];
+  struct sigaction sa {};
+  sa.sa_handler = on_child_exit;
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGCHLD, &sa, nullptr);
+  // Status pipes may outlive their readers, and Ctrl-C is meant for the
+  // programs in the foreground, not for the launcher.
+  std::signal(SIGPIPE, SIG_IGN);
+  std::signal(SIGINT, SIG_IGN);
+  std::signal(SIGQUIT, SIG_IGN);
+
+  std::vector<char> buf(Zygote::kMaxRequest);
+  std::unordered_map<pid_t, int> waiting;
+  for (;;) {
+    pollfd fds[2] = {{sock, POLLIN, 0}, {wake[0], POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents) {
+      char drain[64];
+      while (read(wake[0], drain, sizeof(drain)) > 0) {
+      }
+      reap_children(waiting);
+    }
+    if (fds[0].revents && !serve_request(sock, buf, waiting))
+      break;
+  }
+  _exit(0);
+}
+#endif
+
+} // namespace
+
+std::unique_ptr<Zygote> Zygote::start() {
+#ifdef __linux__
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0)
+    return nullptr;
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(sv[0]);
+    close(sv[1]);
+    return nullptr;
+  }
+  if (pid == 0) {
+    close(sv[0]);
+    zygote_main(sv[1]);
+  }
+  close(sv[1]);
+  return std::unique_ptr<Zygote>(new Zygote(pid, sv[0]));
+#else
+  return nullptr;
+#endif
+}
+
+Zygote::~Zygote() {
+#ifdef __linux__
+  close(socket_);
+  waitpid(pid_, nullptr, 0);
+#endif
+}
+
+int Zygote::launch(const std::string &program_path,
+                   const std::vector<std::string> &args, char *const *envp,
+                   int stdin_fd, int stdout_fd, int stderr_fd) {
+#ifdef __linux__
+  std::size_t env_count = 0;
+  while (envp[env_count])
+    ++env_count;
+  const std::uint32_t counts[2] = {
+      static_cast<std::uint32_t>(args.empty() ? 1 : args.size()),
+      static_cast<std::uint32_t>(env_count)};
+  std::string request(reinterpret_cast<const char *>(counts), sizeof(counts));
+  request.append(program_path).push_back('\0');
+  for (std::size_t i = 1; i < args.size(); ++i)
+    request.append(args[i]).push_back('\0');
+  for (std::size_t i = 0; i < env_count; ++i)
+    request.append(envp[i]).push_back('\0');
+  if (request.size() > kMaxRequest)
+    return -1;
+
+  // The zygote keeps the directory it was forked in; the child changes to
+  // the caller's current one.
+  const int cwd_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (cwd_fd < 0)
+    return -1;
+  int status[2];
+  if (pipe2(status, O_CLOEXEC) != 0) {
+    close(cwd_fd);
+    return -1;
+  }
+  const int fds[kRequestFds] = {stdin_fd, stdout_fd, stderr_fd, cwd_fd,
+                                status[1]};
+  iovec iov{request.data(), request.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr *c = CMSG_FIRSTHDR(&msg);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type = SCM_RIGHTS;
+  c->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+  ssize_t n;
+  do {
+    n = sendmsg(socket_, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  close(cwd_fd);
+  close(status[1]);
+  if (n != static_cast<ssize_t>(request.size())) {
+    close(status[0]);
+    return -1;
+  }
+  return status[0];
+#else
+  (void)program_path;
+  (void)args;
+  (void)envp;
+  (void)stdin_fd;
+  (void)stdout_fd;
+  (void)stderr_fd;
+  return -1;
+#endif
+}
+
+int Zygote::wait(int status_fd, struct rusage *usage) {
+#ifdef __linux__
+  StatusMessage message{};
+  std::size_t got = 0;
+  while (got < sizeof(message)) {
+    ssize_t n = read(status_fd, reinterpret_cast<char *>(&message) + got,
+                     sizeof(message) - got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    got += static_cast<std::size_t>(n);
+  }
+  close(status_fd);
+  if (got != sizeof(message) || message.code < 0)
+    return -1;
+  if (usage)
+    *usage = message.usage;
+  return message.code;
+#else
+  (void)status_fd;
+  (void)usage;
+  return -1;
+#endif
+}
+
+} // namespace cli
@@ -0,0 +1,236 @@
+#include "cli/byte_stream.hpp"
+#include "cli/chunked_command.hpp"
+#include "cli/commands/echo_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <doctest/doctest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace cli;
+
+namespace {
+
+/// Hands out `text` in chunks of at most `size` bytes.
+class TinyChunks : public ByteSource {
+public:
+  TinyChunks(std::string text, std::size_t size)
+      : text_(std::move(text)), size_(size) {}
+
+  std::span<const char> next() override {
+    const std::size_t n = std::min(size_, text_.size() - offset_);
+    std::span<const char> chunk(text_.data() + offset_, n);
+    offset_ += n;
+    return chunk;
+  }
+
+private:
+  std::string text_;
+  std::size_t size_;
+  std::size_t offset_{0};
+};
+
+/// Collects what is written; refuses every write after the first `limit`.
+class StringSink : public ByteSink {
+public:
+  explicit StringSink(std::size_t limit = SIZE_MAX) : limit_(limit) {}
+
+  bool write(std::span<const char> data) override {
+    if (chunks == limit_)
+      return false;
+    ++chunks;
+    text.append(data.data(), data.size());
+    return true;
+  }
+
+  std::string text;
+  std::size_t chunks{0};
+
+private:
+  std::size_t limit_;
+};
+
+} // namespace
+
+TEST_CASE("StreamByteSource and StreamByteSink move whole chunks") {
+  std::string payload(StreamByteSource::kChunkSize + 10, 'x');
+  std::istringstream in(payload);
+  StreamByteSource source(in);
+  std::ostringstream out;
+  StreamByteSink sink(out);
+  CHECK(source.next().size() == StreamByteSource::kChunkSize);
+  CHECK(copy_bytes(source, sink));
+  CHECK(out.str() == std::string(10, 'x'));
+  CHECK(source.next().empty());
+  CHECK_FALSE(source.failed());
+}
+
+TEST_CASE("ByteSourceBuf and ByteSinkBuf give streams over chunks") {
+  TinyChunks source("first line\nsecond\nlast", 4);
+  ByteSourceBuf in_buf(source);
+  std::istream in(&in_buf);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line))
+    lines.push_back(line);
+  CHECK(lines == std::vector<std::string>{"first line", "second", "last"});
+
+  StringSink sink(1);
+  {
+    ByteSinkBuf out_buf(sink);
+    std::ostream out(&out_buf);
+    out << "a" << 1 << '\n';
+    CHECK(sink.text.empty());
+    out.flush();
+    CHECK(sink.text == "a1\n");
+    out << "refused";
+    out.flush();
+    CHECK(out.bad());
+  }
+  CHECK(sink.text == "a1\n");
+}
+
+TEST_CASE("run_chunked runs stream-only and chunked commands alike") {
+  Environment env;
+  std::ostringstream err;
+  EchoCommand echo;
+  TinyChunks no_input("", 1);
+  StringSink echoed;
+  CHECK(run_chunked(echo, {"echo", "hi", "there"}, no_input, echoed, err,
+                    env) == 0);
+  CHECK(echoed.text == "hi there\n");
+
+  WcCommand wc;
+  TinyChunks words("one two\nthree", 3);
+  StringSink counted;
+  CHECK(run_chunked(wc, {"wc"}, words, counted, err, env) == 0);
+  CHECK(counted.text == " 1 3 13\n");
+  CHECK(err.str().empty());
+}
+
+TEST_CASE("Chunked grep matches stream grep across chunk boundaries") {
+  std::string text;
+  for (int i = 0; i < 200; ++i)
+    text += (i % 7 == 0 ? "ERROR " : "info ") + std::to_string(i) + "\n";
+  text += "ERROR without newline";
+  Environment env;
+  GrepCommand grep;
+  for (const std::vector<std::string> &args :
+       {std::vector<std::string>{"grep", "ERROR"},
+        std::vector<std::string>{"grep", "-A", "2", "ERROR"},
+        std::vector<std::string>{"grep", "-w", "1[0-9]"},
+        std::vector<std::string>{"grep", "o 1"},
+        std::vector<std::string>{"grep", "without"}}) {
+    CAPTURE(args[1]);
+    std::istringstream in(text);
+    std::ostringstream out, err;
+    const int expected_code = grep.execute(args, in, out, err, env);
+    for (std::size_t size : {1, 5, 64}) {
+      TinyChunks chunks(text, size);
+      StringSink sink;
+      CHECK(grep.execute_chunks(args, chunks, sink, err, env) ==
+            expected_code);
+      CHECK(sink.text == out.str());
+    }
+  }
+}
+
+TEST_CASE("Chunked grep stops once the sink refuses output") {
+  const std::string path = "cli_test_byte_stream.txt";
+  {
+    std::ofstream f(path);
+    for (int i = 0; i < 400000; ++i)
+      f << "match " << i << "\n";
+  }
+  Environment env;
+  GrepCommand grep;
+  TinyChunks no_input("", 1);
+  StringSink sink(1);
+  std::ostringstream err;
+  CHECK(grep.execute_chunks({"grep", "match", path}, no_input, sink, err,
+                            env) == 0);
+  CHECK(sink.chunks == 1);
+  // The file is about 5 MiB; grep must not have scanned all of it.
+  CHECK(sink.text.size() <= FileByteSource::kMappedChunkSize);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Chunked wc stops and fails once the sink refuses output") {
+  const std::string first = "cli_test_byte_stream_1.txt";
+  const std::string second = "cli_test_byte_stream_2.txt";
+  std::ofstream(first) << "one\n";
+  std::ofstream(second) << "two\n";
+  Environment env;
+  WcCommand wc;
+  TinyChunks no_input("", 1);
+  StringSink sink(1);
+  std::ostringstream err;
+  CHECK(wc.execute_chunks({"wc", first, second, "missing"}, no_input, sink,
+                          err, env) == 1);
+  CHECK(sink.chunks == 1);
+  // Stopped at the refused write, before trying to open "missing".
+  CHECK(err.str().empty());
+
+  TinyChunks words("a b", 1);
+  StringSink closed(0);
+  CHECK(wc.execute_chunks({"wc"}, words, closed, err, env) == 1);
+  std::remove(first.c_str());
+  std::remove(second.c_str());
+}
+
+TEST_CASE("FileByteSource maps regular files and reads everything else") {
+  const std::string path = "cli_test_mapped.txt";
+  std::string text;
+  for (int i = 0; text.size() < FileByteSource::kMappedChunkSize + 100; ++i)
+    text += "line " + std::to_string(i) + "\n";
+  std::ofstream(path, std::ios::binary) << text;
+
+  auto read_all = [](FileByteSource &source) {
+    std::string got;
+    for (std::span<const char> chunk = source.next(); !chunk.empty();
+         chunk = source.next())
+      got.append(chunk.data(), chunk.size());
+    return got;
+  };
+  FileByteSource mapped(path);
+  REQUIRE(mapped.is_open());
+#ifndef _WIN32
+  CHECK(mapped.mapped());
+#endif
+  CHECK(mapped.next().size() == FileByteSource::kMappedChunkSize);
+  CHECK(read_all(mapped) == text.substr(FileByteSource::kMappedChunkSize));
+  CHECK_FALSE(mapped.failed());
+  std::remove(path.c_str());
+
+  std::ofstream(path, std::ios::binary).flush();
+  FileByteSource empty(path);
+  REQUIRE(empty.is_open());
+  CHECK_FALSE(empty.mapped());
+  CHECK(empty.next().empty());
+  std::remove(path.c_str());
+
+  FileByteSource missing("cli_test_no_such_file.txt");
+  CHECK_FALSE(missing.is_open());
+  CHECK(missing.next().empty());
+
+#ifdef __linux__
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  REQUIRE(write(fds[1], "piped\n", 6) == 6);
+  close(fds[1]);
+  FileByteSource piped("/dev/fd/" + std::to_string(fds[0]));
+  REQUIRE(piped.is_open());
+  CHECK_FALSE(piped.mapped());
+  CHECK(read_all(piped) == "piped\n");
+  close(fds[0]);
+#endif
+}
@@ -1,5 +1,7 @@
 #include "cli/command_line_interpreter.hpp"
+#include <cstdio>
 #include <doctest/doctest.h>
+#include <fstream>
 #include <sstream>
 #include <string>
 
@@ -156,3 +158,60 @@ TEST_CASE("CommandLineInterpreter three-way pipe") {
   CHECK(err.str().empty());
   CHECK(out.str().find("1") != std::string::npos);
 }
+
+TEST_CASE("CommandLineInterpreter runs command lists") {
+  CommandLineInterpreter cli;
+  std::stringstream in("X=1; echo a$X; echo b\n"
+                       "cat /nonexistent/file && echo no || echo yes\n"
+                       "echo c || echo no && echo d\n"
+                       "Y=2 && echo $Y\n"
+                       "&& echo no\n"
+                       "echo e; exit 3; echo no\n"
+                       "echo no\n");
+  std::stringstream out, err;
+  CHECK(cli.run(in, out, err) == 3);
+  CHECK(out.str() == "a1\nb\nyes\nc\nd\n2\ne\n");
+  CHECK(err.str().find("cli: syntax error near `&&'") != std::string::npos);
+}
+
+TEST_CASE("CommandLineInterpreter run_script runs every line") {
+  CommandLineInterpreter cli;
+  std::istringstream in;
+  std::stringstream out, err;
+  CHECK(cli.run_script("#!/usr/bin/env cli\nX=1\necho a$X\n\n"
+                       "echo b | wc &\ncat /nonexistent/file\n\n",
+                       in, out, err) == 1);
+  CHECK(out.str() == "a1\n 1 1 2\n");
+  CHECK(err.str() == "cat: cannot open '/nonexistent/file'\n");
+
+  std::stringstream exit_out, exit_err;
+  CHECK(cli.run_script("echo c; exit 4\necho no", in, exit_out, exit_err) ==
+        4);
+  CHECK(exit_out.str() == "c\n");
+  CHECK(cli.run_script("", in, exit_out, exit_err) == 0);
+}
+
+TEST_CASE("CommandLineInterpreter run_script checks syntax before running") {
+  CommandLineInterpreter cli;
+  std::istringstream in;
+  std::stringstream out, err;
+  CHECK(cli.run_script("echo a\necho b &&\necho c\n; echo d", in, out,
+                       err) == 2);
+  CHECK(out.str().empty());
+  CHECK(err.str() == "cli: line 2: syntax error: nothing after `&&'\n"
+                     "cli: line 4: syntax error near `;'\n");
+}
+
+TEST_CASE("CommandLineInterpreter run_file reads the script file") {
+  const std::string path = "cli_test_script.cli";
+  std::ofstream(path) << "echo from file\n";
+  CommandLineInterpreter cli;
+  std::istringstream in;
+  std::stringstream out, err;
+  CHECK(cli.run_file(path, in, out, err) == 0);
+  CHECK(out.str() == "from file\n");
+  std::remove(path.c_str());
+
+  CHECK(cli.run_file(path, in, out, err) == 127);
+  CHECK(err.str() == "cli: cannot open 'cli_test_script.cli'\n");
+}
@@ -64,3 +64,18 @@ TEST_CASE("CommandRegistry multiple commands") {
   CHECK(reg.has("cmd2"));
   CHECK(reg.find("cmd1") != reg.find("cmd2"));
 }
+
+TEST_CASE("CommandRegistry factory runs once on first find") {
+  CommandRegistry reg;
+  int made = 0;
+  reg.register_factory("lazy", [&made] {
+    ++made;
+    return std::make_unique<DummyCommand>();
+  });
+  CHECK(reg.has("lazy"));
+  CHECK(made == 0);
+  Command *first = reg.find("lazy");
+  REQUIRE(first != nullptr);
+  CHECK(reg.find("lazy") == first);
+  CHECK(made == 1);
+}
@@ -0,0 +1,248 @@
+#include "cli/command_line_interpreter.hpp"
+#include "cli/command_server.hpp"
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace cli;
+
+namespace {
+
+std::string socket_path() {
+  return "/tmp/cli_test_server_" + std::to_string(getpid()) + ".sock";
+}
+
+/** Everything written to the read end of a pipe so far. Called once the
+ * server has answered, when the worker has flushed its output; EOF may
+ * never come, since the next worker, forked from this process, holds on to
+ * the write ends of the pipes open at the time. */
+std::string drain(int fd) {
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  std::string text;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    text.append(buf, static_cast<std::size_t>(n));
+  close(fd);
+  return text;
+}
+
+/** Runs `script` through the server with stdout and stderr captured. */
+struct Call {
+  int code;
+  std::string out;
+  std::string err;
+};
+
+Call call(const std::string &path, bool is_file, const std::string &script,
+          char *const *envp) {
+  int in[2], out[2], err[2];
+  REQUIRE(pipe(in) == 0);
+  REQUIRE(pipe(out) == 0);
+  REQUIRE(pipe(err) == 0);
+  close(in[1]);
+  Call result;
+  result.code =
+      CommandServer::call(path, is_file, script, envp, in[0], out[1], err[1]);
+  close(in[0]);
+  close(out[1]);
+  close(err[1]);
+  result.out = drain(out[0]);
+  result.err = drain(err[0]);
+  return result;
+}
+
+} // namespace
+
+TEST_CASE("CommandServer runs scripts with the client's stdio and env") {
+  const std::string path = socket_path();
+  std::ostringstream listen_err;
+  std::unique_ptr<CommandServer> server =
+      CommandServer::listen(path, listen_err);
+  REQUIRE(server);
+  CHECK(listen_err.str().empty());
+  struct stat st = {};
+  REQUIRE(stat(path.c_str(), &st) == 0);
+  CHECK((st.st_mode & 0777) == 0600);
+  CommandLineInterpreter interpreter;
+  std::thread serving([&] { CHECK(server->serve(interpreter) == 0); });
+
+  char greeting[] = "GREETING=hi";
+  char *env_one[] = {greeting, nullptr};
+  Call first = call(path, false, "X=1; echo $GREETING $X\ncat /nope", env_one);
+  CHECK(first.code == 1);
+  CHECK(first.out == "hi 1\n");
+  CHECK(first.err == "cat: cannot open '/nope'\n");
+
+  // Variables of one request do not carry over to the next.
+  char *env_none[] = {nullptr};
+  Call second = call(path, false, "echo [$GREETING$X] && exit 7", env_none);
+  CHECK(second.code == 7);
+  CHECK(second.out == "[]\n");
+
+  const std::string script = "cli_test_server_script.cli";
+  std::ofstream(script) << "echo from file\n";
+  Call third = call(path, true, script, env_none);
+  CHECK(third.code == 0);
+  CHECK(third.out == "from file\n");
+  std::remove(script.c_str());
+
+  Call syntax = call(path, false, "echo a &&", env_none);
+  CHECK(syntax.code == 2);
+  CHECK(syntax.out.empty());
+
+  // A second server may not take over the socket of a running one.
+  std::ostringstream busy_err;
+  CHECK_FALSE(CommandServer::listen(path, busy_err));
+  CHECK_FALSE(busy_err.str().empty());
+
+  server->stop();
+  serving.join();
+  server.reset();
+  CHECK(call(path, false, "echo a", env_none).code == -1);
+}
+
+TEST_CASE("CommandServer runs zygote-launched programs in the client's "
+          "directory") {
+  const std::string path = socket_path();
+  const std::string start_dir = std::filesystem::current_path().string();
+  const std::filesystem::path client_dir =
+      std::filesystem::temp_directory_path() /
+      ("cli_test_server_cwd_" + std::to_string(getpid()));
+  std::filesystem::create_directory(client_dir);
+  std::ofstream(client_dir / "only_here") << "";
+
+  std::ostringstream listen_err;
+  std::unique_ptr<CommandServer> server =
+      CommandServer::listen(path, listen_err);
+  REQUIRE(server);
+  // The zygote is forked here, in the server's starting directory.
+  setenv("CLI_ZYGOTE", "1", 1);
+  CommandLineInterpreter interpreter;
+  unsetenv("CLI_ZYGOTE");
+  std::thread serving([&] { CHECK(server->serve(interpreter) == 0); });
+
+  std::filesystem::current_path(client_dir);
+  char *env_none[] = {nullptr};
+  Call listing = call(path, false, "/bin/ls", env_none);
+  std::filesystem::current_path(start_dir);
+  CHECK(listing.code == 0);
+  CHECK(listing.out == "only_here\n");
+
+  server->stop();
+  serving.join();
+  std::filesystem::remove_all(client_dir);
+}
+
+TEST_CASE("CommandServer refuses callers of another user") {
+  // Needs a second user: the server drops to "nobody" and the test, still
+  // root, connects (root may open the 0600 socket file, but is a different
+  // user to the server).
+  if (geteuid() != 0)
+    return;
+  const std::string path = socket_path();
+  int ready[2];
+  REQUIRE(pipe(ready) == 0);
+  const pid_t pid = fork();
+  REQUIRE(pid >= 0);
+  if (pid == 0) {
+    close(ready[0]);
+    if (setgid(65534) != 0 || setuid(65534) != 0)
+      _exit(1);
+    std::ostringstream err;
+    std::unique_ptr<CommandServer> server = CommandServer::listen(path, err);
+    if (!server)
+      _exit(1);
+    CommandLineInterpreter interpreter;
+    [[maybe_unused]] ssize_t n = write(ready[1], "x", 1);
+    close(ready[1]);
+    _exit(server->serve(interpreter));
+  }
+  close(ready[1]);
+  char c;
+  const bool started = read(ready[0], &c, 1) == 1;
+  close(ready[0]);
+  if (started) {
+    char *env_none[] = {nullptr};
+    Call refused = call(path, false, "echo ran", env_none);
+    CHECK(refused.code == -2);
+    CHECK(refused.out.empty());
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  unlink(path.c_str());
+  CHECK(started);
+}
+
+TEST_CASE("CommandServer runs each request in a worker of its own") {
+  const std::string path = socket_path();
+  std::ostringstream listen_err;
+  std::unique_ptr<CommandServer> server =
+      CommandServer::listen(path, listen_err);
+  REQUIRE(server);
+  CommandLineInterpreter interpreter;
+  std::thread serving([&] { CHECK(server->serve(interpreter) == 0); });
+  char path_var[] = "PATH=/usr/bin:/bin";
+  char *envp[] = {path_var, nullptr};
+
+  // While one request sleeps, another one is answered.
+  std::future<Call> slow = std::async(std::launch::async, [&] {
+    return call(path, false, "sleep 2; echo slow", envp);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  const auto start = std::chrono::steady_clock::now();
+  Call fast = call(path, false, "echo fast", envp);
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  CHECK(fast.out == "fast\n");
+  CHECK(slow.wait_for(std::chrono::seconds(0)) ==
+        std::future_status::timeout);
+  CHECK(slow.get().out == "slow\n");
+
+  // A request whose worker dies (say, of SIGBUS on a truncated mapped
+  // file) leaves the server serving. SIGKILL, since the worker is a copy
+  // of this test process, whose other signals the test framework handles.
+  Call crashed = call(path, false, "sh -c 'kill -KILL $PPID'", envp);
+  CHECK(crashed.code == -2);
+  CHECK(call(path, false, "echo still", envp).out == "still\n");
+
+  server->stop();
+  serving.join();
+}
+
+TEST_CASE("CommandServer replaces a stale socket file") {
+  const std::string path = socket_path();
+  // A bound socket that nobody listens on, like one left by a crash.
+  const int stale = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  REQUIRE(stale >= 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+  REQUIRE(bind(stale, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+          0);
+  close(stale);
+
+  std::ostringstream err;
+  CHECK(CommandServer::listen(path, err));
+  CHECK(err.str().empty());
+
+  // Other files are left alone.
+  std::ofstream(path) << "not a socket";
+  CHECK_FALSE(CommandServer::listen(path, err));
+  std::remove(path.c_str());
+}
+#endif
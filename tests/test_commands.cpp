@@ -2,6 +2,7 @@
 #include "cli/commands/echo_command.hpp"
 #include "cli/commands/exit_command.hpp"
 #include "cli/commands/grep_command.hpp"
+#include "cli/commands/head_command.hpp"
 #include "cli/commands/pwd_command.hpp"
 #include "cli/commands/wc_command.hpp"
 #include "cli/environment.hpp"
@@ -312,3 +313,86 @@ TEST_CASE("GrepCommand reads from stdin when no file") {
   CHECK(code == 0);
   CHECK(out.str() == "alpha\nalpha\n");
 }
+
+// --- HeadCommand tests ---
+
+TEST_CASE("HeadCommand prints first 10 lines of stdin by default") {
+  HeadCommand cmd;
+  Environment env;
+  std::string data;
+  for (int i = 0; i < 20; ++i)
+    data += std::to_string(i) + "\n";
+  std::stringstream in(data), out, err;
+  int code = cmd.execute({"head"}, in, out, err, env);
+  CHECK(code == 0);
+  CHECK(out.str() == "0\n1\n2\n3\n4\n5\n6\n7\n8\n9\n");
+}
+
+TEST_CASE("HeadCommand -n N and missing trailing newline") {
+  HeadCommand cmd;
+  Environment env;
+  std::stringstream in("a\nb\nc"), out, err;
+  CHECK(cmd.execute({"head", "-n", "2"}, in, out, err, env) == 0);
+  CHECK(out.str() == "a\nb\n");
+
+  std::stringstream in2("a\nb\nc"), out2;
+  CHECK(cmd.execute({"head", "-n", "5"}, in2, out2, err, env) == 0);
+  CHECK(out2.str() == "a\nb\nc");
+}
+
+TEST_CASE("HeadCommand -N, -c N and counts of all but the last N") {
+  HeadCommand cmd;
+  Environment env;
+  std::stringstream err;
+  auto head = [&](std::vector<std::string> args, const std::string &input) {
+    args.insert(args.begin(), "head");
+    std::stringstream in(input), out;
+    CHECK(cmd.execute(args, in, out, err, env) == 0);
+    return out.str();
+  };
+  CHECK(head({"-1"}, "1\n2\n3\n") == "1\n");
+  CHECK(head({"-2"}, "1\n2\n3\n") == "1\n2\n");
+  CHECK(head({"-c", "3"}, "abcdef") == "abc");
+  CHECK(head({"-c3"}, "abcdef") == "abc");
+  CHECK(head({"--bytes=10"}, "abcdef") == "abcdef");
+  CHECK(head({"-n", "-1"}, "1\n2\n3\n") == "1\n2\n");
+  CHECK(head({"-n", "-1"}, "1\n2\n3") == "1\n2\n");
+  CHECK(head({"--lines=-5"}, "1\n2\n3\n").empty());
+  CHECK(head({"-c", "-2"}, "abcdef") == "abcd");
+  CHECK(head({"-n", "0"}, "1\n").empty());
+  CHECK(head({"-n", "1", "-"}, "1\n2\n") == "1\n");
+  CHECK(err.str().empty());
+}
+
+TEST_CASE("HeadCommand multiple files get headers") {
+  std::string p1 = "cli_test_head_1.txt";
+  std::string p2 = "cli_test_head_2.txt";
+  {
+    std::ofstream f1(p1);
+    f1 << "one\ntwo\n";
+    std::ofstream f2(p2);
+    f2 << "three\n";
+  }
+  HeadCommand cmd;
+  Environment env;
+  std::stringstream in, out, err;
+  int code = cmd.execute({"head", "-n", "1", p1, p2}, in, out, err, env);
+  std::remove(p1.c_str());
+  std::remove(p2.c_str());
+  CHECK(code == 0);
+  CHECK(out.str() == "==> " + p1 + " <==\none\n\n==> " + p2 +
+                         " <==\nthree\n");
+}
+
+TEST_CASE("HeadCommand cannot open file and invalid count") {
+  HeadCommand cmd;
+  Environment env;
+  std::stringstream in, out, err;
+  CHECK(cmd.execute({"head", "/nonexistent/xyz123"}, in, out, err, env) == 1);
+  CHECK(err.str().find("cannot open") != std::string::npos);
+  CHECK(cmd.execute({"head", "-n", "x"}, in, out, err, env) == 2);
+  CHECK(cmd.execute({"head", "-c", "--"}, in, out, err, env) == 2);
+  CHECK(cmd.execute({"head", "-q"}, in, out, err, env) == 2);
+  CHECK(cmd.execute({"head", "-n"}, in, out, err, env) == 2);
+  CHECK(err.str().find("usage: head") != std::string::npos);
+}
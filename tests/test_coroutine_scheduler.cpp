@@ -0,0 +1,100 @@
+#include "cli/coroutine_scheduler.hpp"
+#include <doctest/doctest.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cli;
+
+namespace {
+
+StageTask produce(ChunkPipe &pipe, int count, std::vector<std::string> &log) {
+  for (int i = 0; i < count; ++i) {
+    log.push_back("push " + std::to_string(i));
+    if (!co_await pipe.push(std::to_string(i)))
+      break;
+  }
+  pipe.close_write();
+}
+
+StageTask consume(ChunkPipe &pipe, std::string &received, int limit) {
+  int taken = 0;
+  while (auto chunk = co_await pipe.pop()) {
+    received += *chunk + ",";
+    if (++taken == limit)
+      break;
+  }
+  pipe.close_read();
+}
+
+StageTask wait_forever(ChunkPipe &pipe) { co_await pipe.pop(); }
+
+StageTask fail() {
+  throw std::runtime_error("boom");
+  co_return;
+}
+
+} // namespace
+
+TEST_CASE("ChunkPipe passes chunks in order between two coroutines") {
+  CoroutineScheduler scheduler;
+  ChunkPipe pipe(scheduler, 2);
+  std::vector<std::string> log;
+  std::string received;
+  scheduler.spawn(produce(pipe, 100, log));
+  scheduler.spawn(consume(pipe, received, -1));
+  CHECK(scheduler.run());
+
+  std::string expected;
+  for (int i = 0; i < 100; ++i)
+    expected += std::to_string(i) + ",";
+  CHECK(received == expected);
+  CHECK(scheduler.switches() > 100 / 2);
+}
+
+TEST_CASE("ChunkPipe close_read stops a writer on a full pipe") {
+  CoroutineScheduler scheduler;
+  ChunkPipe pipe(scheduler, 1);
+  std::vector<std::string> log;
+  std::string received;
+  scheduler.spawn(produce(pipe, 1000, log));
+  scheduler.spawn(consume(pipe, received, 3));
+  CHECK(scheduler.run());
+  CHECK(received == "0,1,2,");
+  CHECK(log.size() < 10);
+}
+
+TEST_CASE("CoroutineScheduler reports a stage that can never be woken") {
+  CoroutineScheduler scheduler;
+  ChunkPipe pipe(scheduler);
+  scheduler.spawn(wait_forever(pipe));
+  CHECK_FALSE(scheduler.run());
+}
+
+TEST_CASE("CoroutineScheduler rethrows an exception from a task") {
+  CoroutineScheduler scheduler;
+  scheduler.spawn(fail());
+  CHECK_THROWS_AS(scheduler.run(), std::runtime_error);
+}
+
+TEST_CASE("StageInput and StageOutput wrap plain streams") {
+  std::istringstream in(std::string(StageInput::kChunkSize + 10, 'a'));
+  std::ostringstream out;
+  StageInput input(in);
+  StageOutput output(out);
+  CoroutineScheduler scheduler;
+  std::size_t chunks = 0;
+  auto copy = [](StageInput &i, StageOutput &o,
+                 std::size_t &count) -> StageTask {
+    while (auto chunk = co_await i.next()) {
+      ++count;
+      co_await o.write(std::move(*chunk));
+    }
+    o.close();
+  };
+  scheduler.spawn(copy(input, output, chunks));
+  CHECK(scheduler.run());
+  CHECK(chunks == 2);
+  CHECK(out.str() == in.str());
+}
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <doctest/doctest.h>
 #include <string>
+#include <vector>
 
 using namespace cli;
 
@@ -58,6 +59,38 @@ TEST_CASE("Environment to_env_vector empty when no vars") {
   CHECK(vec.empty());
 }
 
+TEST_CASE("Environment envp follows set and unset") {
+  Environment env;
+  auto entries = [&env]() {
+    std::vector<std::string> out;
+    for (char *const *p = env.envp(); *p; ++p)
+      out.push_back(*p);
+    std::sort(out.begin(), out.end());
+    return out;
+  };
+  CHECK(entries().empty());
+  env.set("A", "1");
+  env.set("B", "2");
+  env.set("C", "3");
+  CHECK(entries() == std::vector<std::string>{"A=1", "B=2", "C=3"});
+  env.set("A", "one");
+  env.unset("B"); // an entry from the middle
+  CHECK(entries() == std::vector<std::string>{"A=one", "C=3"});
+  env.unset("C"); // the last entry
+  env.set("D", "");
+  CHECK(entries() == std::vector<std::string>{"A=one", "D="});
+  CHECK(env.size() == 2);
+
+  Environment copy = env;
+  env.set("A", "changed");
+  CHECK(copy.get("A") == "one");
+  std::vector<std::string> copied;
+  for (char *const *p = copy.envp(); *p; ++p)
+    copied.push_back(*p);
+  std::sort(copied.begin(), copied.end());
+  CHECK(copied == std::vector<std::string>{"A=one", "D="});
+}
+
 TEST_CASE("Environment init_from_current yields non-empty or empty") {
   Environment env;
   env.init_from_current();
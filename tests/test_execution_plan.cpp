@@ -0,0 +1,181 @@
+#include "cli/command.hpp"
+#include "cli/command_registry.hpp"
+#include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
+#include <doctest/doctest.h>
+#include <memory>
+#include <string>
+
+using namespace cli;
+
+namespace {
+
+class DummyCommand : public Command {
+public:
+  int execute(const std::vector<std::string> & /*args*/, std::istream & /*in*/,
+              std::ostream & /*out*/, std::ostream & /*err*/,
+              const Environment & /*env*/) override {
+    return 0;
+  }
+};
+
+} // namespace
+
+TEST_CASE("SubstitutionTemplate expands like Environment::substitute") {
+  Environment env;
+  env.set("A", "1");
+  env.set("LONG_NAME", "value");
+  for (const std::string text :
+       {"plain", "$A", "x${A}y", "$LONG_NAME-$A", "$$", "$", "a$", "${A",
+        "${}", "$MISSING.", "${LONG_NAME}${A}"}) {
+    CAPTURE(text);
+    CHECK(SubstitutionTemplate(text).expand(env) == env.substitute(text));
+  }
+}
+
+TEST_CASE("SubstitutionTemplate literal words") {
+  CHECK(SubstitutionTemplate("abc").is_literal());
+  CHECK(SubstitutionTemplate("abc").literal() == "abc");
+  CHECK_FALSE(SubstitutionTemplate("$A").is_literal());
+  SubstitutionTemplate quoted("$A", false);
+  CHECK(quoted.is_literal());
+  Environment env;
+  env.set("A", "1");
+  CHECK(quoted.expand(env) == "$A");
+}
+
+TEST_CASE("ExecutionPlan compile extracts leading assignments") {
+  ExecutionPlan plan = ExecutionPlan::compile("X=1 Y=$X echo $Y | wc");
+  REQUIRE(plan.assignments().size() == 2);
+  CHECK(plan.assignments()[0].name == "X");
+  CHECK(plan.assignments()[1].name == "Y");
+  REQUIRE(plan.stages().size() == 2);
+  CHECK(plan.stages()[0].name.literal() == "echo");
+  CHECK(plan.stages()[1].name.literal() == "wc");
+
+  Environment env;
+  plan.apply_assignments(env);
+  CHECK(env.get("X") == "1");
+  CHECK(env.get("Y") == "1");
+}
+
+TEST_CASE("ExecutionPlan compile of assignments only has no stages") {
+  CHECK(ExecutionPlan::compile("").stages().empty());
+  ExecutionPlan plan = ExecutionPlan::compile("A=1 B=2");
+  CHECK(plan.assignments().size() == 2);
+  CHECK(plan.stages().empty());
+}
+
+TEST_CASE("ExecutionPlan compile of a command list") {
+  ExecutionPlan plan =
+      ExecutionPlan::compile("X=1; time echo $X && Y=2 wc || echo no;");
+  CHECK(plan.syntax_error().empty());
+  CHECK(plan.assignments().size() == 1);
+  CHECK(plan.stages().empty());
+  REQUIRE(plan.rest().size() == 3);
+  CHECK(plan.rest()[0].op == ListOperator::Sequence);
+  CHECK(plan.rest()[0].plan.timed());
+  CHECK(plan.rest()[0].plan.stages()[0].name.literal() == "echo");
+  CHECK(plan.rest()[1].op == ListOperator::And);
+  CHECK(plan.rest()[1].plan.assignments().size() == 1);
+  CHECK(plan.rest()[1].plan.stages()[0].name.literal() == "wc");
+  CHECK(plan.rest()[2].op == ListOperator::Or);
+  CHECK_FALSE(plan.timed());
+
+  CHECK(ExecutionPlan::compile("echo a").rest().empty());
+}
+
+TEST_CASE("ExecutionPlan compile reports empty pipelines in a list") {
+  CHECK(ExecutionPlan::compile("; echo a").syntax_error() ==
+        "syntax error near `;'");
+  CHECK(ExecutionPlan::compile("echo a && || echo b").syntax_error() ==
+        "syntax error near `||'");
+  CHECK(ExecutionPlan::compile("echo a &&").syntax_error() ==
+        "syntax error: nothing after `&&'");
+  ExecutionPlan plan = ExecutionPlan::compile("&& echo a &");
+  CHECK_FALSE(plan.syntax_error().empty());
+  CHECK_FALSE(plan.background());
+  CHECK(plan.rest().empty());
+}
+
+TEST_CASE("ExecutionPlan bind expands arguments on every run") {
+  CommandRegistry registry;
+  registry.register_command("dummy", std::make_unique<DummyCommand>());
+  Environment env;
+  ExecutionPlan plan = ExecutionPlan::compile("dummy $V '$V'");
+
+  env.set("V", "first");
+  auto bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  REQUIRE(bound->size() == 1);
+  CHECK((*bound)[0].builtin == registry.find("dummy"));
+  CHECK((*bound)[0].args == std::vector<std::string>{"dummy", "first", "$V"});
+
+  env.set("V", "second");
+  bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  CHECK((*bound)[0].args[1] == "second");
+}
+
+TEST_CASE("ExecutionPlan bind fails for an empty command name") {
+  CommandRegistry registry;
+  Environment env;
+  ExecutionPlan plan = ExecutionPlan::compile("$EMPTY x");
+  CHECK_FALSE(plan.bind(registry, env));
+}
+
+TEST_CASE("ExecutionPlan rebinds after the registry changes") {
+  CommandRegistry registry;
+  Environment env;
+  ExecutionPlan plan = ExecutionPlan::compile("late_builtin");
+  auto bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  CHECK((*bound)[0].builtin == nullptr);
+
+  registry.register_command("late_builtin", std::make_unique<DummyCommand>());
+  bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  CHECK((*bound)[0].builtin == registry.find("late_builtin"));
+}
+
+#ifndef _WIN32
+TEST_CASE("ExecutionPlan re-resolves external programs when PATH changes") {
+  CommandRegistry registry;
+  Environment env;
+  ExecutionPlan plan = ExecutionPlan::compile("sh -c true");
+
+  env.set("PATH", "/usr/bin:/bin");
+  auto bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  CHECK((*bound)[0].executable != "sh");
+
+  env.set("PATH", "/nonexistent-dir");
+  bound = plan.bind(registry, env);
+  REQUIRE(bound);
+  CHECK((*bound)[0].executable == "sh");
+}
+#endif
+
+TEST_CASE("PlanCache reuses plans and evicts the least recently used") {
+  PlanCache cache(2);
+  const ExecutionPlan *a = &cache.get("echo a");
+  cache.get("echo b");
+  CHECK(&cache.get("echo a") == a);
+  CHECK(cache.hits() == 1);
+  cache.get("echo c"); // evicts "echo b"
+  CHECK(cache.size() == 2);
+  CHECK(&cache.get("echo a") == a);
+  cache.get("echo b");
+  CHECK(cache.hits() == 2);
+
+  cache.clear();
+  CHECK(cache.size() == 0);
+}
+
+TEST_CASE("PlanCache with zero capacity compiles every line") {
+  PlanCache cache(0);
+  CHECK(cache.get("echo a").stages().size() == 1);
+  CHECK(cache.get("echo a").stages().size() == 1);
+  CHECK(cache.hits() == 0);
+  CHECK(cache.size() == 0);
+}
@@ -1,14 +1,42 @@
 #include "cli/command_registry.hpp"
+#include "cli/commands/cat_command.hpp"
 #include "cli/commands/echo_command.hpp"
 #include "cli/commands/exit_command.hpp"
+#include "cli/commands/grep_command.hpp"
+#include "cli/commands/head_command.hpp"
 #include "cli/commands/wc_command.hpp"
 #include "cli/executor.hpp"
+#include "cli/operator_fusion.hpp"
+#include <cstdio>
 #include <doctest/doctest.h>
+#include <fstream>
 #include <memory>
 #include <sstream>
 
 using namespace cli;
 
+namespace {
+
+/// Input stream buffer that never reaches EOF: endless "yes\n" lines.
+class EndlessBuf : public std::streambuf {
+public:
+  EndlessBuf() {
+    for (std::size_t i = 0; i < sizeof(buf_); ++i)
+      buf_[i] = (i % 4 == 3) ? '\n' : "yes"[i % 4];
+  }
+
+protected:
+  int_type underflow() override {
+    setg(buf_, buf_, buf_ + sizeof(buf_));
+    return traits_type::to_int_type(buf_[0]);
+  }
+
+private:
+  char buf_[4096];
+};
+
+} // namespace
+
 TEST_CASE("Executor runs registered built-in command") {
   CommandRegistry registry;
   registry.register_command("echo", std::make_unique<EchoCommand>());
@@ -213,3 +241,327 @@ TEST_CASE("Executor pipeline exit code is last command exit code") {
   ExecutorResult result = exec.execute(pl, in, out, err, env);
   CHECK(result.exit_code == 127);
 }
+
+TEST_CASE("Executor streaming mode matches sequential output") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor exec(registry);
+  Environment env;
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"echo", {"one", "two", "three"}});
+  pl.push_back(CommandNode{"wc", {}});
+
+  std::stringstream in, seq_out, err;
+  exec.execute(pl, in, seq_out, err, env);
+  env.set("CLI_PIPELINE", "streaming");
+  std::stringstream stream_out;
+  ExecutorResult result = exec.execute(pl, in, stream_out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(stream_out.str() == seq_out.str());
+}
+
+TEST_CASE("Executor streaming mode moves more data than channel capacity") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_PIPELINE", "streaming");
+  env.set("CLI_PIPE_CAPACITY", "16");
+
+  std::string data;
+  for (int i = 0; i < 10000; ++i)
+    data += "word\n";
+  Pipeline pl;
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"wc", {}});
+
+  std::stringstream in(data), out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == " 10000 10000 50000\n");
+}
+
+TEST_CASE("Executor streaming mode does not block when consumer ignores "
+          "input") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_PIPELINE", "streaming");
+  env.set("CLI_PIPE_CAPACITY", "8");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"echo", {"done"}});
+
+  std::stringstream in(std::string(100000, 'z')), out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == "done\n");
+}
+
+#ifndef _WIN32
+TEST_CASE("Executor connects external-only pipeline with kernel pipes") {
+  CommandRegistry registry;
+  Executor exec(registry);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"printf", {"b\\na\\nc\\n"}});
+  pl.push_back(CommandNode{"sort", {}});
+  pl.push_back(CommandNode{"head", {"-n", "2"}});
+
+  std::stringstream in, out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == "a\nb\n");
+}
+
+TEST_CASE("Executor external-only pipeline feeds stdin to first stage and "
+          "reports missing programs") {
+  CommandRegistry registry;
+  Executor exec(registry);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"tr", {"a-z", "A-Z"}});
+  pl.push_back(CommandNode{"nonexistent_xyz_999", {}});
+
+  std::stringstream in("abc\n"), out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 127);
+  CHECK(err.str().find("nonexistent_xyz_999") != std::string::npos);
+
+  Pipeline upper;
+  upper.push_back(CommandNode{"tr", {"a-z", "A-Z"}});
+  upper.push_back(CommandNode{"cat", {}});
+  std::stringstream in2("abc\n"), out2, err2;
+  result = exec.execute(upper, in2, out2, err2, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out2.str() == "ABC\n");
+}
+#endif
+
+TEST_CASE("Executor sequential stage buffers spill past the memory limit") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_STAGE_BUFFER_LIMIT", "1000");
+  env.set("CLI_SPILL_DEBUG", "1");
+
+  std::string data;
+  for (int i = 0; i < 10000; ++i)
+    data += "word\n";
+  Pipeline pl;
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"wc", {}});
+
+  std::stringstream in(data), out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == " 10000 10000 50000\n");
+  CHECK(err.str().find("spilled 100000 bytes") != std::string::npos);
+  CHECK(err.str().find("peak RSS") != std::string::npos);
+}
+
+TEST_CASE("Executor streaming mode stops producers once head is done") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("grep", std::make_unique<GrepCommand>());
+  registry.register_command("head", std::make_unique<HeadCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_PIPELINE", "streaming");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"grep", {"y"}});
+  pl.push_back(CommandNode{"head", {"-n", "3"}});
+
+  EndlessBuf endless;
+  std::istream in(&endless);
+  std::stringstream out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == "yes\nyes\nyes\n");
+}
+
+TEST_CASE("Executor cooperative mode matches sequential output") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("grep", std::make_unique<GrepCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor exec(registry);
+  Environment env;
+
+  std::string data;
+  for (int i = 0; i < 20000; ++i)
+    data += (i % 3 == 0 ? "match " : "other ") + std::to_string(i) + "\n";
+  data += "match without newline";
+  Pipeline pl;
+  pl.push_back(CommandNode{"cat", {}});
+  pl.push_back(CommandNode{"grep", {"-A", "1", "match"}});
+  pl.push_back(CommandNode{"cat", {}});
+
+  std::stringstream seq_in(data), seq_out, err;
+  exec.execute(pl, seq_in, seq_out, err, env);
+  env.set("CLI_PIPELINE", "cooperative");
+  std::stringstream coop_in(data), coop_out;
+  ExecutorResult result = exec.execute(pl, coop_in, coop_out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(coop_out.str() == seq_out.str());
+  CHECK(err.str().empty());
+
+  pl.push_back(CommandNode{"wc", {}});
+  std::stringstream wc_in(data), wc_out;
+  exec.execute(pl, wc_in, wc_out, err, env);
+  CHECK(wc_out.str() == " 13335 26671 " +
+                            std::to_string(seq_out.str().size()) + "\n");
+}
+
+TEST_CASE("Executor cooperative mode reports grep exit code and errors") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("grep", std::make_unique<GrepCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_PIPELINE", "cooperative");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"echo", {"hello"}});
+  pl.push_back(CommandNode{"grep", {"bye"}});
+  std::stringstream in, out, err;
+  CHECK(exec.execute(pl, in, out, err, env).exit_code == 1);
+  CHECK(out.str().empty());
+
+  pl[1] = CommandNode{"grep", {"("}};
+  CHECK(exec.execute(pl, in, out, err, env).exit_code == 2);
+  CHECK(err.str().find("grep: invalid regular expression") !=
+        std::string::npos);
+}
+
+TEST_CASE("Executor cooperative mode falls back for other commands") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("head", std::make_unique<HeadCommand>());
+  Executor exec(registry);
+  Environment env;
+  env.set("CLI_PIPELINE", "cooperative");
+
+  Pipeline pl;
+  pl.push_back(CommandNode{"echo", {"a"}});
+  pl.push_back(CommandNode{"head", {"-n", "1"}});
+  std::stringstream in, out, err;
+  ExecutorResult result = exec.execute(pl, in, out, err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == "a\n");
+}
+
+TEST_CASE("Executor fused pipelines match unfused output") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("grep", std::make_unique<GrepCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor exec(registry);
+
+  const std::string a = "cli_test_fusion_a.txt";
+  const std::string b = "cli_test_fusion_b.txt";
+  const std::string empty = "cli_test_fusion_empty.txt";
+  {
+    std::ofstream fa(a, std::ios::binary);
+    for (int i = 0; i < 5000; ++i)
+      fa << (i % 7 == 0 ? "Error  in " : "ok ") << i << "\n";
+    fa << "error without newline";
+    std::ofstream fb(b, std::ios::binary);
+    fb << "tail error\n\n  \n";
+    std::ofstream fe(empty, std::ios::binary);
+  }
+  const std::string stdin_data = "x error\ny\nerror z";
+  const std::vector<std::string> lines = {
+      "cat " + a + " | wc",
+      "cat " + empty + " " + a + " " + b + " | wc",
+      "cat | wc",
+      "grep -i error " + a + " | wc",
+      "grep -A 2 error " + a + " " + b + " | wc",
+      "grep error | wc",
+      "cat " + a + " " + b + " | grep -w -i error | wc",
+      "cat | grep error | wc",
+      "cat " + a + " missing.txt " + b + " | wc",
+      "grep error " + a + " missing.txt | wc",
+      "cat missing.txt | grep error | wc",
+  };
+  for (const std::string &line : lines) {
+    CAPTURE(line);
+    ExecutionPlan plan = ExecutionPlan::compile(line);
+    Environment env;
+    std::stringstream fused_in(stdin_data), fused_out, fused_err;
+    ExecutorResult fused =
+        exec.execute(plan, fused_in, fused_out, fused_err, env);
+    env.set("CLI_FUSION", "0");
+    std::stringstream in(stdin_data), out, err;
+    ExecutorResult plain = exec.execute(plan, in, out, err, env);
+    CHECK(fused_out.str() == out.str());
+    CHECK(fused_err.str() == err.str());
+    CHECK(fused.exit_code == plain.exit_code);
+  }
+  std::remove(a.c_str());
+  std::remove(b.c_str());
+  std::remove(empty.c_str());
+}
+
+TEST_CASE("Executor cat keeps writing to a stage buffer after an empty file") {
+  // An empty file used to set failbit on the stage buffer, which dropped
+  // every later file.
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  Executor exec(registry);
+  const std::string empty = "cli_test_cat_empty.txt";
+  const std::string full = "cli_test_cat_full.txt";
+  std::ofstream(empty, std::ios::binary).flush();
+  std::ofstream(full, std::ios::binary) << "after\n";
+  Environment env;
+  std::stringstream in, out, err;
+  ExecutorResult result = exec.execute(
+      ExecutionPlan::compile("cat " + empty + " " + full + " | cat"), in, out,
+      err, env);
+  CHECK(result.exit_code == 0);
+  CHECK(out.str() == "after\n");
+  std::remove(empty.c_str());
+  std::remove(full.c_str());
+}
+
+TEST_CASE("run_fused_pipeline recognises only known shapes") {
+  CommandRegistry registry;
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("grep", std::make_unique<GrepCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  registry.register_command("head", std::make_unique<HeadCommand>());
+  Environment env;
+  auto fused = [&](const std::string &line) {
+    auto stages = ExecutionPlan::compile(line).bind(registry, env);
+    REQUIRE(stages);
+    std::stringstream in("a\nb\na\n"), out, err;
+    return run_fused_pipeline(*stages, in, out, err).has_value();
+  };
+  CHECK(fused("cat | wc"));
+  CHECK(fused("grep a | wc"));
+  CHECK(fused("cat | grep a | wc"));
+  CHECK_FALSE(fused("cat | head"));
+  CHECK_FALSE(fused("cat | wc file.txt"));
+  CHECK_FALSE(fused("grep ( | wc"));
+  CHECK_FALSE(fused("cat | grep a file.txt | wc"));
+  CHECK_FALSE(fused("cat | cat | wc"));
+  CHECK(fusion_enabled(env));
+  env.set("CLI_FUSION", "0");
+  CHECK_FALSE(fusion_enabled(env));
+}
@@ -0,0 +1,257 @@
+#include "cli/command_line_interpreter.hpp"
+#include "cli/commands/cat_command.hpp"
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/fd_io.hpp"
+#include <cstdio>
+#include <doctest/doctest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace cli;
+
+namespace {
+
+std::string read_file(const std::string &path) {
+  std::ifstream f(path, std::ios::binary);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+} // namespace
+
+TEST_CASE("output_fd and input_fd ignore in-memory streams") {
+  std::stringstream ss;
+  CHECK(output_fd(ss) == -1);
+  CHECK(input_fd(ss) == -1);
+}
+
+TEST_CASE("output_fd does not take a redirected std::cout for fd 1") {
+  std::ostream stdout_alias(std::cout.rdbuf());
+  CHECK(output_fd(stdout_alias) == STDOUT_FILENO);
+
+  const std::string src = "cli_test_fd_redirect_src.txt";
+  std::ofstream(src, std::ios::binary) << "to the stringstream\n";
+  std::stringstream captured;
+  std::streambuf *original = std::cout.rdbuf(captured.rdbuf());
+  const int fd = output_fd(std::cout);
+  CatCommand cmd;
+  Environment env;
+  std::stringstream in, err;
+  const int code = cmd.execute({"cat", src}, in, std::cout, err, env);
+  std::cout.rdbuf(original);
+  CHECK(fd == -1);
+  CHECK(code == 0);
+  CHECK(captured.str() == "to the stringstream\n");
+  std::remove(src.c_str());
+}
+
+TEST_CASE("FdStreamBuf reads and writes through a descriptor") {
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  {
+    FdStreamBuf wbuf(fds[1], true);
+    std::ostream out(&wbuf);
+    CHECK(output_fd(out) == fds[1]);
+    out << "hello " << 42 << "\n";
+  }
+  FdStreamBuf rbuf(fds[0], true);
+  std::istream in(&rbuf);
+  CHECK(input_fd(in) == fds[0]);
+  std::string line;
+  std::getline(in, line);
+  CHECK(line == "hello 42");
+}
+
+TEST_CASE("OutputSink writes by block or by line depending on its policy") {
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  {
+    OutputSink out(fds[1], FlushPolicy::Block, 64);
+    CHECK(output_fd(out) == fds[1]);
+    for (int i = 0; i < 10; ++i)
+      out << "line " << i << "\n";
+    // 70 bytes through a 64-byte buffer: one write when it filled up.
+    CHECK(out.sink().write_calls() == 1);
+    out.flush();
+    CHECK(out.sink().write_calls() == 2);
+    out.flush();
+    CHECK(out.sink().write_calls() == 2);
+
+    OutputSink lines(fds[1], FlushPolicy::Line, 64);
+    lines << "a" << "b" << "\n";
+    CHECK(lines.sink().write_calls() == 1);
+    lines << "c\nd";
+    CHECK(lines.sink().write_calls() == 2);
+    lines << std::string(100, 'x');
+    CHECK(lines.sink().write_calls() == 3);
+  }
+  close(fds[1]);
+  std::string got;
+  char buf[512];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+    got.append(buf, static_cast<std::size_t>(n));
+  close(fds[0]);
+  std::string expected;
+  for (int i = 0; i < 10; ++i)
+    expected += "line " + std::to_string(i) + "\n";
+  CHECK(got == expected + "ab\nc\nd" + std::string(100, 'x'));
+}
+
+TEST_CASE("Interpreter output through a sink keeps order with programs") {
+  const std::string path = "cli_test_sink_out.txt";
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(fd >= 0);
+  {
+    FdStreamBuf buf(fd, true);
+    std::ostream out(&buf);
+    // The program reads from echo, not from the rest of the script.
+    std::istringstream in("echo one\necho | sh -c 'echo two'\necho three\n"
+                          "cat cli_test_sink_missing.txt | echo four\n");
+    std::stringstream err;
+    CommandLineInterpreter interpreter;
+    CHECK(interpreter.run(in, out, err) == 0);
+  }
+  CHECK(read_file(path) == "one\ntwo\nthree\nfour\n");
+  std::remove(path.c_str());
+}
+
+TEST_CASE("transfer_fd copies a file into a pipe and a pipe into a file") {
+  std::string src = "cli_test_fd_src.txt";
+  std::string dst = "cli_test_fd_dst.txt";
+  std::string payload;
+  for (int i = 0; i < 20000; ++i)
+    payload += "row " + std::to_string(i) + "\n";
+  {
+    std::ofstream f(src, std::ios::binary);
+    f << payload;
+  }
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  int dst_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(dst_fd >= 0);
+
+  // The pipe is smaller than the payload, so drain it concurrently.
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[1]);
+    _exit(transfer_fd(fds[0], dst_fd) < 0 ? 1 : 0);
+  }
+  close(fds[0]);
+  close(dst_fd);
+  int src_fd = open(src.c_str(), O_RDONLY);
+  CHECK(transfer_fd(src_fd, fds[1]) ==
+        static_cast<std::int64_t>(payload.size()));
+  close(src_fd);
+  close(fds[1]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  CHECK(read_file(dst) == payload);
+  std::remove(src.c_str());
+  std::remove(dst.c_str());
+}
+
+TEST_CASE("CatCommand writes files straight to an fd-backed output") {
+  std::string src = "cli_test_fd_cat_src.txt";
+  std::string dst = "cli_test_fd_cat_dst.txt";
+  {
+    std::ofstream f(src, std::ios::binary);
+    f << "first\nsecond\n";
+  }
+  {
+    int fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    FdStreamBuf buf(fd, true);
+    std::ostream out(&buf);
+    out << "before\n";
+    CatCommand cmd;
+    Environment env;
+    std::stringstream in, err;
+    CHECK(cmd.execute({"cat", src, src}, in, out, err, env) == 0);
+    CHECK(cmd.execute({"cat", "/nonexistent/xyz123"}, in, out, err, env) ==
+          1);
+    CHECK(err.str().find("cannot open") != std::string::npos);
+  }
+  CHECK(read_file(dst) == "before\nfirst\nsecond\nfirst\nsecond\n");
+  std::remove(src.c_str());
+  std::remove(dst.c_str());
+}
+
+TEST_CASE("CatCommand leaves an fd-backed output usable after empty stdin") {
+  std::string dst = "cli_test_fd_cat_empty_dst.txt";
+  {
+    int fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    FdStreamBuf buf(fd, true);
+    std::ostream out(&buf);
+    CatCommand cmd;
+    Environment env;
+    std::stringstream in, err;
+    CHECK(cmd.execute({"cat"}, in, out, err, env) == 0);
+    out << "still written\n";
+    CHECK(out.good());
+  }
+  CHECK(read_file(dst) == "still written\n");
+  std::remove(dst.c_str());
+}
+
+TEST_CASE("ExternalCommand moves child output to an fd-backed stream") {
+  std::string dst = "cli_test_fd_ext_dst.txt";
+  {
+    int fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    FdStreamBuf buf(fd, true);
+    std::ostream out(&buf);
+    ExternalCommand cmd;
+    Environment env;
+    env.set("PATH", "/usr/bin:/bin");
+    std::stringstream in("piped input\n"), err;
+    CHECK(cmd.execute({"cat"}, in, out, err, env) == 0);
+  }
+  CHECK(read_file(dst) == "piped input\n");
+  std::remove(dst.c_str());
+}
+
+#ifdef __linux__
+TEST_CASE("ExternalCommand hands fd-backed streams to the child directly") {
+  std::string src = "cli_test_fd_direct_src.txt";
+  std::string dst = "cli_test_fd_direct_dst.txt";
+  std::ofstream(src) << "input\n";
+  {
+    int in_fd = open(src.c_str(), O_RDONLY);
+    int out_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(in_fd >= 0);
+    REQUIRE(out_fd >= 0);
+    FdStreamBuf in_buf(in_fd, true);
+    FdStreamBuf out_buf(out_fd, true);
+    std::istream in(&in_buf);
+    std::ostream out(&out_buf);
+    out << "before\n";
+    ExternalCommand cmd;
+    Environment env;
+    env.set("PATH", "/usr/bin:/bin");
+    std::stringstream err;
+    // Without pipes in between, the child's stdin and stdout are the files.
+    CHECK(cmd.execute_pipeline(
+              {{"sh", "-c", "readlink /proc/$$/fd/0 | sed 's|.*/||'; cat"},
+               {"sh", "-c", "cat; readlink /proc/$$/fd/1 | sed 's|.*/||'"}},
+              in, out, err, env) == 0);
+    CHECK(cmd.execute({"sh", "-c", "readlink /proc/$$/fd/1 | sed 's|.*/||'"},
+                      in, out, err, env) == 0);
+    CHECK(err.str().empty());
+  }
+  CHECK(read_file(dst) ==
+        "before\n" + src + "\ninput\n" + dst + "\n" + dst + "\n");
+  std::remove(src.c_str());
+  std::remove(dst.c_str());
+}
+#endif
+#endif
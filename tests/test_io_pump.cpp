@@ -0,0 +1,97 @@
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/fd_io.hpp"
+#include "cli/io_pump.hpp"
+#include "cli/pipe_channel.hpp"
+#include <doctest/doctest.h>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+
+using namespace cli;
+
+namespace {
+
+Environment test_env() {
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  return env;
+}
+
+} // namespace
+
+TEST_CASE("ExternalCommand collects interleaved multi-MB stdout and stderr") {
+  // Each burst is far larger than a pipe buffer: draining stdout before
+  // stderr would leave the child blocked on its first stderr write.
+  ExternalCommand cmd;
+  Environment env = test_env();
+  std::stringstream in, out, err;
+  CHECK(cmd.execute({"sh", "-c",
+                     "for i in 1 2 3 4; do "
+                     "head -c 1000000 /dev/zero | tr '\\0' o; "
+                     "head -c 1000000 /dev/zero | tr '\\0' e >&2; "
+                     "done"},
+                    in, out, err, env) == 0);
+  CHECK(out.str() == std::string(4000000, 'o'));
+  CHECK(err.str() == std::string(4000000, 'e'));
+}
+
+TEST_CASE("ExternalCommand feeds stdin while draining both outputs") {
+  ExternalCommand cmd;
+  Environment env = test_env();
+  const std::string data(3 * 1024 * 1024, 'x');
+  std::stringstream in(data), out, err;
+  CHECK(cmd.execute({"sh", "-c", "tee /dev/stderr"}, in, out, err, env) == 0);
+  CHECK(out.str() == data);
+  CHECK(err.str() == data);
+}
+
+TEST_CASE("External pipeline shares one pump for input, output and errors") {
+  ExternalCommand cmd;
+  Environment env = test_env();
+  const std::string data(2 * 1024 * 1024, 'y');
+  std::stringstream in(data), out, err;
+  CHECK(cmd.execute_pipeline({{"sh", "-c", "tee /dev/stderr"}, {"cat"}}, in,
+                             out, err, env) == 0);
+  CHECK(out.str() == data);
+  CHECK(err.str() == data);
+}
+
+TEST_CASE("IoPump reads input from a descriptor and closes every pipe") {
+  int source[2], child_in[2], child_out[2];
+  REQUIRE(pipe(source) == 0);
+  REQUIRE(pipe(child_in) == 0);
+  REQUIRE(pipe(child_out) == 0);
+  REQUIRE(write(source[1], "abc", 3) == 3);
+  close(source[1]);
+  // Stand-in for the child: whatever reaches its stdin is its output.
+  REQUIRE(write(child_out[1], "out", 3) == 3);
+  close(child_out[1]);
+
+  FdStreamBuf source_buf(source[0], true);
+  std::istream in(&source_buf);
+  CHECK(IoPump::can_pump_input(in));
+  std::stringstream out, err;
+  IoPump pump;
+  pump.run(in, child_in[1], child_out[0], out, -1, err);
+  CHECK(out.str() == "out");
+
+  char buf[8] = {};
+  CHECK(read(child_in[0], buf, sizeof(buf)) == 3);
+  CHECK(std::string(buf, 3) == "abc");
+  // The pump closed its end of the child's stdin.
+  CHECK(read(child_in[0], buf, sizeof(buf)) == 0);
+  close(child_in[0]);
+}
+
+TEST_CASE("IoPump leaves streams it could block on to a helper") {
+  std::stringstream memory("data");
+  CHECK(IoPump::can_pump_input(memory));
+  PipeChannel channel;
+  ChannelReadBuf channel_buf(channel);
+  std::istream from_stage(&channel_buf);
+  CHECK_FALSE(IoPump::can_pump_input(from_stage));
+}
+#endif
@@ -0,0 +1,180 @@
+#include "cli/command_line_interpreter.hpp"
+#include "cli/commands/fg_command.hpp"
+#include "cli/commands/jobs_command.hpp"
+#include "cli/commands/wait_command.hpp"
+#include "cli/job_table.hpp"
+#include "cli/thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace cli;
+
+namespace {
+
+/** Spins until `flag` is set; false after a few seconds. */
+bool wait_for(const std::atomic<bool> &flag) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!flag.load()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+/** Polls until job `id` is listed as done (without taking it). */
+void wait_until_done(JobTable &jobs, int id) {
+  for (int i = 0; i < 5000; ++i) {
+    for (const JobTable::Status &status : jobs.list()) {
+      if (status.id == id && status.done)
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+} // namespace
+
+TEST_CASE("JobTable runs jobs at the same time and returns their codes") {
+  ThreadPool pool(2);
+  JobTable jobs;
+  std::atomic<bool> first_started{false};
+  std::atomic<bool> second_started{false};
+  // Each job only finishes once the other one is running.
+  const int first = jobs.start(
+      "first &",
+      [&] {
+        first_started = true;
+        return wait_for(second_started) ? 3 : 9;
+      },
+      &pool);
+  const int second = jobs.start(
+      "second &",
+      [&] {
+        second_started = true;
+        return wait_for(first_started) ? 0 : 9;
+      },
+      &pool);
+  CHECK(first == 1);
+  CHECK(second == 2);
+  CHECK(jobs.current() == 2);
+  CHECK(jobs.wait(first) == 3);
+  CHECK(jobs.wait(second) == 0);
+  CHECK(jobs.wait(first) == std::nullopt);
+  CHECK(jobs.current() == std::nullopt);
+
+  // Numbers start over once the table is empty; exceptions end a job with 1.
+  CHECK(jobs.start("boom", []() -> int { throw std::runtime_error("x"); },
+                   nullptr) == 1);
+  CHECK(jobs.wait(1) == 1);
+}
+
+TEST_CASE("JobTable lists running and finished jobs") {
+  JobTable jobs;
+  std::atomic<bool> release{false};
+  jobs.start("sleepy &", [&] { return wait_for(release) ? 0 : 9; }, nullptr);
+  wait_until_done(jobs, jobs.start("quick &", [] { return 2; }, nullptr));
+
+  auto all = jobs.list();
+  REQUIRE(all.size() == 2);
+  CHECK(JobTable::describe(all[0]) == "[1] Running\tsleepy &");
+  CHECK(JobTable::describe(all[1]) == "[2] Exit 2\tquick &");
+
+  auto finished = jobs.take_finished();
+  REQUIRE(finished.size() == 1);
+  CHECK(finished[0].id == 2);
+  CHECK(jobs.list().size() == 1);
+
+  release = true;
+  jobs.wait_all();
+  CHECK(jobs.list().empty());
+}
+
+TEST_CASE("JobTable parses job references") {
+  CHECK(JobTable::parse_spec("%3") == 3);
+  CHECK(JobTable::parse_spec("12") == 12);
+  CHECK(JobTable::parse_spec("%") == std::nullopt);
+  CHECK(JobTable::parse_spec("%0") == std::nullopt);
+  CHECK(JobTable::parse_spec("%1x") == std::nullopt);
+  CHECK(JobTable::parse_spec("-1") == std::nullopt);
+}
+
+TEST_CASE("jobs, wait and fg builtins") {
+  JobTable jobs;
+  Environment env;
+  JobsCommand jobs_cmd(jobs);
+  WaitCommand wait_cmd(jobs);
+  FgCommand fg_cmd(jobs);
+  std::stringstream in, out, err;
+
+  jobs.start("a &", [] { return 0; }, nullptr);
+  jobs.start("b &", [] { return 4; }, nullptr);
+  CHECK(wait_cmd.execute({"wait", "%2"}, in, out, err, env) == 4);
+  CHECK(wait_cmd.execute({"wait", "%2"}, in, out, err, env) == 127);
+  CHECK(err.str() == "wait: %2: no such job\n");
+
+  jobs.wait(1);
+  jobs.start("c &", [] { return 5; }, nullptr);
+  CHECK(fg_cmd.execute({"fg"}, in, out, err, env) == 5);
+  CHECK(out.str() == "c &\n");
+  err.str("");
+  CHECK(fg_cmd.execute({"fg"}, in, out, err, env) == 1);
+  CHECK(err.str() == "fg: no current job\n");
+
+  out.str("");
+  jobs.start("d &", [] { return 0; }, nullptr);
+  jobs.wait_all();
+  wait_until_done(jobs, jobs.start("e &", [] { return 0; }, nullptr));
+  CHECK(jobs_cmd.execute({"jobs"}, in, out, err, env) == 0);
+  CHECK(out.str() == "[1] Done\te &\n");
+  out.str("");
+  CHECK(jobs_cmd.execute({"jobs"}, in, out, err, env) == 0);
+  CHECK(out.str().empty());
+  CHECK(wait_cmd.execute({"wait"}, in, out, err, env) == 0);
+}
+
+TEST_CASE("CommandLineInterpreter runs lines ending with & in the background") {
+  CommandLineInterpreter cli;
+  std::stringstream in("X=outer\n"
+                       "X=inner echo $X from job &\n"
+                       "wait %1\n"
+                       "echo $X after\n"
+                       "sh -c 'exit 3' &\n"
+                       "wait\n"
+                       "jobs\n");
+  std::stringstream out, err;
+  CHECK(cli.run(in, out, err) == 0);
+  CHECK(out.str() == "inner from job\nouter after\n");
+  CHECK(err.str().empty());
+}
+
+TEST_CASE("Background jobs and the foreground share stdout and stderr") {
+  // Built with -fsanitize=thread, this reports a data race unless every
+  // write to the shared streams is locked.
+  CommandLineInterpreter cli;
+  std::string script;
+  for (int i = 0; i < 10; ++i)
+    script += "parallel -j 4 cat ::: /nonexistent/a /nonexistent/b "
+              "/nonexistent/c /nonexistent/d &\n"
+              "parallel -j 4 cat ::: /nonexistent/a /nonexistent/b "
+              "/nonexistent/c /nonexistent/d\n"
+              "echo job &\n"
+              "echo foreground\n";
+  std::stringstream in;
+  std::ostringstream out, err;
+  cli.run_script(script, in, out, err);
+  auto count = [](const std::string &text, const std::string &what) {
+    std::size_t n = 0;
+    for (std::size_t pos = 0; (pos = text.find(what, pos)) != std::string::npos;
+         pos += what.size())
+      ++n;
+    return n;
+  };
+  CHECK(count(err.str(), "cat: cannot open '") == 80);
+  CHECK(count(out.str(), "job\n") == 10);
+  CHECK(count(out.str(), "foreground\n") == 10);
+}
@@ -0,0 +1,128 @@
+#include "cli/command_line_interpreter.hpp"
+#include "cli/command_registry.hpp"
+#include "cli/commands/echo_command.hpp"
+#include "cli/commands/parallel_command.hpp"
+#include "cli/environment.hpp"
+#include "cli/executor.hpp"
+#include "cli/thread_pool.hpp"
+#include <doctest/doctest.h>
+#include <sstream>
+#include <string>
+
+using namespace cli;
+
+TEST_CASE("parallel fills the template with items after :::") {
+  ThreadPool pool(4);
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  Executor executor(registry);
+  executor.set_thread_pool(&pool);
+  ParallelCommand parallel(executor, &pool);
+  Environment env;
+  std::stringstream in, out, err;
+
+  CHECK(parallel.execute({"parallel", "-j", "3", "echo", "[{}]", "{}.log",
+                          ":::", "a", "$b", "c", "d"},
+                         in, out, err, env) == 0);
+  CHECK(out.str() == "[a] a.log\n[$b] $b.log\n[c] c.log\n[d] d.log\n");
+  CHECK(err.str().empty());
+}
+
+#ifndef _WIN32
+TEST_CASE("parallel runs external commands for the lines of stdin") {
+  ThreadPool pool(4);
+  CommandRegistry registry;
+  Executor executor(registry);
+  executor.set_thread_pool(&pool);
+  ParallelCommand parallel(executor, &pool);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+
+  // The item is appended as $1; "b" and "d" fail.
+  std::stringstream in("a\nb\nc\nd\n"), out, err;
+  CHECK(parallel.execute({"parallel", "-j2", "sh", "-c",
+                          "echo out-$1; echo err-$1 >&2; [ $1 = a ] || "
+                          "[ $1 = c ]",
+                          "sh"},
+                         in, out, err, env) == 2);
+  CHECK(out.str() == "out-a\nout-b\nout-c\nout-d\n");
+  CHECK(err.str() == "err-a\nerr-b\nerr-c\nerr-d\n");
+}
+
+TEST_CASE("parallel keeps input order unless -u is given") {
+  ThreadPool pool(3);
+  CommandRegistry registry;
+  Executor executor(registry);
+  executor.set_thread_pool(&pool);
+  ParallelCommand parallel(executor, &pool);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  const std::vector<std::string> command = {
+      "sh", "-c", "sleep $1; echo $1", "sh", ":::", "0.4", "0", "0.2"};
+
+  std::vector<std::string> args = {"parallel", "-j", "3"};
+  args.insert(args.end(), command.begin(), command.end());
+  std::stringstream in, out, err;
+  CHECK(parallel.execute(args, in, out, err, env) == 0);
+  CHECK(out.str() == "0.4\n0\n0.2\n");
+
+  args = {"parallel", "-u", "-j", "3"};
+  args.insert(args.end(), command.begin(), command.end());
+  std::stringstream out_u;
+  CHECK(parallel.execute(args, in, out_u, err, env) == 0);
+  CHECK(out_u.str() == "0\n0.2\n0.4\n");
+}
+#endif
+
+namespace {
+
+/// Throws something that is not a std::exception.
+class ThrowingCommand : public Command {
+public:
+  int execute(const std::vector<std::string> &, std::istream &,
+              std::ostream &, std::ostream &, const Environment &) override {
+    throw 42;
+  }
+};
+
+} // namespace
+
+TEST_CASE("parallel reports commands that throw anything as failed") {
+  ThreadPool pool(2);
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("throw", std::make_unique<ThrowingCommand>());
+  Executor executor(registry);
+  executor.set_thread_pool(&pool);
+  ParallelCommand parallel(executor, &pool);
+  Environment env;
+  std::stringstream in, out, err;
+  CHECK(parallel.execute({"parallel", "{}", ":::", "echo", "throw", "echo"},
+                         in, out, err, env) == 1);
+  CHECK(out.str() == "\n\n");
+  CHECK(err.str() == "parallel: unknown error\n");
+}
+
+TEST_CASE("parallel rejects invalid usage") {
+  CommandRegistry registry;
+  Executor executor(registry);
+  ParallelCommand parallel(executor, nullptr);
+  Environment env;
+  std::stringstream in, out, err;
+  CHECK(parallel.execute({"parallel"}, in, out, err, env) == 255);
+  CHECK(parallel.execute({"parallel", "-j", "0", "echo"}, in, out, err,
+                         env) == 255);
+  CHECK(parallel.execute({"parallel", "-x", "echo"}, in, out, err, env) == 255);
+  CHECK(parallel.execute({"parallel", ":::", "a"}, in, out, err, env) == 255);
+  CHECK(err.str().find("usage: parallel") != std::string::npos);
+  CHECK(out.str().empty());
+}
+
+TEST_CASE("CommandLineInterpreter has a parallel builtin") {
+  CommandLineInterpreter cli;
+  std::stringstream in("X=1\nparallel echo $X- ::: a b\n");
+  std::stringstream out, err;
+  cli.run(in, out, err);
+  CHECK(out.str() == "1- a\n1- b\n");
+  CHECK(err.str().empty());
+}
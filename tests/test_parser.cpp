@@ -250,3 +250,65 @@ TEST_CASE("Parser substitute flag double-quoted is Yes") {
   REQUIRE(node.substitute_arg.size() == 1);
   CHECK(node.substitute_arg[0] == Substitute::Yes);
 }
+
+TEST_CASE("Parser splits off a trailing & outside quotes") {
+  bool background = false;
+  auto pl = Parser::parse("grep x log | wc -l &  ", background);
+  CHECK(background);
+  REQUIRE(pl.has_value());
+  REQUIRE(pl->size() == 2);
+  CHECK((*pl)[1].name == "wc");
+  CHECK((*pl)[1].args == std::vector<std::string>{"-l"});
+
+  pl = Parser::parse("echo a&", background);
+  CHECK(background);
+  CHECK(first_command(pl).args == std::vector<std::string>{"a"});
+
+  pl = Parser::parse("echo 'a &'", background);
+  CHECK_FALSE(background);
+  CHECK(first_command(pl).args == std::vector<std::string>{"a &"});
+
+  pl = Parser::parse("echo \"&\"", background);
+  CHECK_FALSE(background);
+  pl = Parser::parse("echo a &&", background);
+  CHECK_FALSE(background);
+  pl = Parser::parse("echo a & b", background);
+  CHECK_FALSE(background);
+
+  CHECK(Parser::parse(" & ", background) == std::nullopt);
+  CHECK(background);
+}
+
+TEST_CASE("Parser splits command lists at ;, && and ||") {
+  bool background = true;
+  auto list = Parser::parse_list(
+      "X=1; echo 'a;b' | wc && echo \"c||d\" || echo e;", background);
+  CHECK_FALSE(background);
+  REQUIRE(list.has_value());
+  REQUIRE(list->size() == 5);
+  CHECK((*list)[0].op == ListOperator::Sequence);
+  CHECK((*list)[0].pipeline[0].name == "X=1");
+  CHECK((*list)[1].op == ListOperator::Sequence);
+  REQUIRE((*list)[1].pipeline.size() == 2);
+  CHECK((*list)[1].pipeline[0].args == std::vector<std::string>{"a;b"});
+  CHECK((*list)[2].op == ListOperator::And);
+  CHECK((*list)[2].pipeline[0].args == std::vector<std::string>{"c||d"});
+  CHECK((*list)[3].op == ListOperator::Or);
+  CHECK((*list)[4].op == ListOperator::Sequence);
+  CHECK((*list)[4].pipeline.empty());
+
+  list = Parser::parse_list("echo a&&echo b &", background);
+  CHECK(background);
+  REQUIRE(list->size() == 2);
+  CHECK((*list)[1].op == ListOperator::And);
+  CHECK((*list)[1].pipeline[0].args == std::vector<std::string>{"b"});
+
+  list = Parser::parse_list("echo a | wc", background);
+  REQUIRE(list->size() == 1);
+  CHECK((*list)[0].pipeline.size() == 2);
+
+  CHECK(Parser::parse_list("  ", background) == std::nullopt);
+  list = Parser::parse_list(" && ", background);
+  REQUIRE(list->size() == 2);
+  CHECK((*list)[0].pipeline.empty());
+}
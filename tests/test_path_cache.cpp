@@ -0,0 +1,181 @@
+#include "cli/command_registry.hpp"
+#include "cli/commands/hash_command.hpp"
+#include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
+#include "cli/path_cache.hpp"
+#include <doctest/doctest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using namespace cli;
+
+namespace {
+
+/** Two empty directories under the temp directory, removed at the end. */
+struct TempDirs {
+  fs::path root = fs::temp_directory_path() /
+                  ("cli_test_path_cache_" + std::to_string(getpid()));
+  fs::path first = root / "first";
+  fs::path second = root / "second";
+
+  TempDirs() {
+    fs::create_directories(first);
+    fs::create_directories(second);
+  }
+  ~TempDirs() {
+    std::error_code ec;
+    fs::remove_all(root, ec);
+  }
+
+  std::string path_value() const {
+    return first.string() + ":" + second.string();
+  }
+};
+
+void make_program(const fs::path &path) {
+  std::ofstream(path) << "#!/bin/sh\n";
+  fs::permissions(path, fs::perms::owner_all);
+}
+
+} // namespace
+
+TEST_CASE("PathCache remembers found and missing commands") {
+  TempDirs dirs;
+  make_program(dirs.second / "tool");
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  PathCache cache;
+
+  CHECK(cache.resolve(env, "tool") == (dirs.second / "tool").string());
+  CHECK(cache.resolve(env, "missing") == "missing");
+  CHECK(cache.resolve(env, "./local") == "./local");
+  auto entries = cache.entries();
+  REQUIRE(entries.size() == 2);
+  CHECK(entries[0].first == "missing");
+  CHECK(entries[0].second.empty());
+  CHECK(entries[1].first == "tool");
+  CHECK(entries[1].second == (dirs.second / "tool").string());
+
+  const std::uint64_t generation = cache.validate(env);
+  CHECK(cache.resolve(env, "tool") == (dirs.second / "tool").string());
+  CHECK(cache.validate(env) == generation);
+
+  cache.clear();
+  CHECK(cache.entries().empty());
+  CHECK(cache.validate(env) != generation);
+}
+
+TEST_CASE("PathCache forgets results when PATH directories change") {
+  TempDirs dirs;
+  make_program(dirs.second / "tool");
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  PathCache cache;
+  CHECK(cache.resolve(env, "tool") == (dirs.second / "tool").string());
+  CHECK(cache.resolve(env, "fresh") == "fresh");
+
+  // A program appears in an earlier directory; a missing one appears.
+  make_program(dirs.first / "tool");
+  make_program(dirs.first / "fresh");
+  CHECK(cache.resolve(env, "tool") == (dirs.first / "tool").string());
+  CHECK(cache.resolve(env, "fresh") == (dirs.first / "fresh").string());
+
+  // A program is removed.
+  fs::remove(dirs.first / "fresh");
+  CHECK(cache.resolve(env, "fresh") == "fresh");
+}
+
+TEST_CASE("PathCache without watches compares modification times") {
+  TempDirs dirs;
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  PathCache cache;
+  CHECK(cache.watch());
+  cache.set_watch(false);
+  CHECK_FALSE(cache.watch());
+  CHECK(cache.resolve(env, "tool") == "tool");
+  // Asking for the same mode again keeps what is cached.
+  cache.set_watch(false);
+  CHECK(cache.entries().size() == 1);
+
+  make_program(dirs.first / "tool");
+  // File times are coarse; make sure the directory looks changed.
+  fs::last_write_time(dirs.first, fs::last_write_time(dirs.first) +
+                                      std::chrono::seconds(1));
+  CHECK(cache.resolve(env, "tool") == (dirs.first / "tool").string());
+}
+
+TEST_CASE("PathCache forgets results when PATH is set") {
+  TempDirs dirs;
+  make_program(dirs.second / "tool");
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  PathCache cache;
+  CHECK(cache.resolve(env, "tool") == (dirs.second / "tool").string());
+  env.set("PATH", dirs.first.string());
+  CHECK(cache.resolve(env, "tool") == "tool");
+
+  // A PATH directory that does not exist yet is created later.
+  env.set("PATH", (dirs.root / "later").string());
+  CHECK(cache.resolve(env, "tool") == "tool");
+  fs::create_directories(dirs.root / "later");
+  make_program(dirs.root / "later" / "tool");
+  CHECK(cache.resolve(env, "tool") == (dirs.root / "later" / "tool").string());
+}
+
+TEST_CASE("ExecutionPlan looks commands up again when the PathCache drops") {
+  TempDirs dirs;
+  make_program(dirs.second / "tool");
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  CommandRegistry registry;
+  PathCache cache;
+  ExecutionPlan plan = ExecutionPlan::compile("tool arg");
+
+  auto bound = plan.bind(registry, env, &cache);
+  REQUIRE(bound);
+  CHECK((*bound)[0].executable == (dirs.second / "tool").string());
+  make_program(dirs.first / "tool");
+  bound = plan.bind(registry, env, &cache);
+  REQUIRE(bound);
+  CHECK((*bound)[0].executable == (dirs.first / "tool").string());
+}
+
+TEST_CASE("HashCommand lists, fills and clears the cache") {
+  TempDirs dirs;
+  make_program(dirs.first / "tool");
+  Environment env;
+  env.set("PATH", dirs.path_value());
+  PathCache cache;
+  HashCommand hash(cache);
+  std::stringstream in;
+
+  std::stringstream out, err;
+  CHECK(hash.execute({"hash"}, in, out, err, env) == 0);
+  CHECK(out.str() == "hash: hash table empty\n");
+
+  std::stringstream out2, err2;
+  CHECK(hash.execute({"hash", "tool", "nope"}, in, out2, err2, env) == 1);
+  CHECK(err2.str() == "hash: nope: not found\n");
+
+  std::stringstream out3, err3;
+  CHECK(hash.execute({"hash"}, in, out3, err3, env) == 0);
+  CHECK(out3.str() == "nope\t(not found)\ntool\t" +
+                          (dirs.first / "tool").string() + "\n");
+
+  std::stringstream out4, err4;
+  CHECK(hash.execute({"hash", "-r"}, in, out4, err4, env) == 0);
+  CHECK(cache.entries().empty());
+
+  std::stringstream out5, err5;
+  CHECK(hash.execute({"hash", "-x"}, in, out5, err5, env) == 2);
+  CHECK(err5.str().find("usage") != std::string::npos);
+}
+#endif
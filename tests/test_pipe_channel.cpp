@@ -0,0 +1,77 @@
+#include "cli/pipe_channel.hpp"
+#include <doctest/doctest.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <thread>
+
+using namespace cli;
+
+TEST_CASE("PipeChannel passes bytes in order through a small buffer") {
+  PipeChannel ch(7);
+  std::string data;
+  for (int i = 0; i < 1000; ++i)
+    data += std::to_string(i) + ",";
+
+  std::thread producer([&] {
+    CHECK(ch.write(data.data(), data.size()) == data.size());
+    ch.close_write();
+  });
+  std::string received;
+  char buf[5];
+  std::size_t n;
+  while ((n = ch.read(buf, sizeof(buf))) > 0)
+    received.append(buf, n);
+  producer.join();
+  CHECK(received == data);
+}
+
+TEST_CASE("PipeChannel read returns 0 after writer closes an empty channel") {
+  PipeChannel ch;
+  ch.close_write();
+  char buf[4];
+  CHECK(ch.read(buf, sizeof(buf)) == 0);
+}
+
+TEST_CASE("PipeChannel close_read unblocks a writer on a full channel") {
+  PipeChannel ch(4);
+  std::string data(100, 'x');
+  std::size_t written = 0;
+  std::thread producer([&] { written = ch.write(data.data(), data.size()); });
+  char buf[2];
+  CHECK(ch.read(buf, sizeof(buf)) == 2);
+  ch.close_read();
+  producer.join();
+  CHECK(written < data.size());
+}
+
+TEST_CASE("ChannelWriteBuf and ChannelReadBuf connect two streams") {
+  PipeChannel ch(16);
+  std::thread producer([&] {
+    ChannelWriteBuf wbuf(ch);
+    std::ostream out(&wbuf);
+    for (int i = 0; i < 100; ++i)
+      out << "line " << i << "\n";
+    wbuf.close();
+  });
+  ChannelReadBuf rbuf(ch);
+  std::istream in(&rbuf);
+  std::string line;
+  int count = 0;
+  while (std::getline(in, line)) {
+    CHECK(line == "line " + std::to_string(count));
+    ++count;
+  }
+  producer.join();
+  CHECK(count == 100);
+}
+
+TEST_CASE("ChannelWriteBuf fails the stream once the reader is gone") {
+  PipeChannel ch(8);
+  ch.close_read();
+  ChannelWriteBuf wbuf(ch);
+  std::ostream out(&wbuf);
+  out << std::string(64, 'y');
+  out.flush();
+  CHECK(out.bad());
+}
@@ -0,0 +1,96 @@
+#include "cli/spill_buffer.hpp"
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+using namespace cli;
+
+namespace {
+
+std::string read_all(SpillBuffer &buf) {
+  std::istream in(&buf);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+} // namespace
+
+TEST_CASE("SpillBuffer keeps small contents in memory") {
+  SpillBuffer buf(1024);
+  std::ostream out(&buf);
+  out << "hello " << 123 << "\n";
+  out.flush();
+  REQUIRE(buf.start_reading());
+  CHECK_FALSE(buf.spilled());
+  CHECK(buf.spilled_bytes() == 0);
+  CHECK(read_all(buf) == "hello 123\n");
+}
+
+TEST_CASE("SpillBuffer spills past the memory budget and reads back") {
+  SpillBuffer buf(100);
+  std::ostream out(&buf);
+  std::string expected;
+  for (int i = 0; i < 50000; ++i) {
+    std::string line = "line " + std::to_string(i) + "\n";
+    out << line;
+    expected += line;
+  }
+  out.flush();
+  REQUIRE(buf.start_reading());
+  CHECK(buf.spilled());
+  CHECK(buf.spilled_bytes() == expected.size());
+  CHECK(read_all(buf) == expected);
+}
+
+TEST_CASE("SpillBuffer can be cleared and reused") {
+  SpillBuffer buf(16);
+  std::ostream out(&buf);
+  out << std::string(100, 'a');
+  out.flush();
+  REQUIRE(buf.start_reading());
+  CHECK(read_all(buf) == std::string(100, 'a'));
+
+  buf.clear();
+  CHECK_FALSE(buf.spilled());
+  out.clear();
+  out << "short";
+  out.flush();
+  REQUIRE(buf.start_reading());
+  CHECK(read_all(buf) == "short");
+}
+
+TEST_CASE("SpillBuffer start_reading rewinds an already read buffer") {
+  SpillBuffer buf(8);
+  std::ostream out(&buf);
+  out << "0123456789abcdef";
+  out.flush();
+  REQUIRE(buf.start_reading());
+  CHECK(read_all(buf) == "0123456789abcdef");
+  REQUIRE(buf.start_reading());
+  CHECK(read_all(buf) == "0123456789abcdef");
+}
+
+TEST_CASE("SpillBuffer keeps its data in memory when the spill write fails") {
+  // Every write to /dev/full fails with ENOSPC.
+  SpillBuffer buf(16, [] { return std::fopen("/dev/full", "w+b"); });
+  std::ostream out(&buf);
+  out << std::string(16, 'a');
+  out << std::string(100, 'b');
+  CHECK(out.bad());
+  CHECK(buf.failed());
+  CHECK_FALSE(buf.spilled());
+
+  out.clear();
+  out << "more";
+  CHECK(out.bad());
+
+  REQUIRE(buf.start_reading());
+  CHECK(read_all(buf) == std::string(16, 'a'));
+
+  buf.clear();
+  CHECK_FALSE(buf.failed());
+}
@@ -0,0 +1,210 @@
+#include "cli/command_line_interpreter.hpp"
+#include "cli/command_registry.hpp"
+#include "cli/commands/cat_command.hpp"
+#include "cli/commands/echo_command.hpp"
+#include "cli/commands/wc_command.hpp"
+#include "cli/environment.hpp"
+#include "cli/execution_plan.hpp"
+#include "cli/executor.hpp"
+#include "cli/stage_stats.hpp"
+#include "cli/zygote.hpp"
+#include <doctest/doctest.h>
+#include <sstream>
+#include <string>
+
+using namespace cli;
+
+namespace {
+
+/// Keeps a shell busy for a few tens of milliseconds.
+const std::string kBusyLoop =
+    "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done; echo $i";
+
+} // namespace
+
+TEST_CASE("print_stage_stats writes a row per stage and a total") {
+  StageStats grep;
+  grep.name = "grep";
+  grep.real_seconds = 0.5;
+  grep.user_seconds = 0.25;
+  grep.max_rss_kib = 1000;
+  grep.bytes_in = 4096;
+  grep.block_bytes_read = 512;
+  StageStats wc;
+  wc.name = "wc";
+  wc.user_seconds = 0.125;
+  wc.max_rss_kib = 3000;
+  wc.voluntary_switches = 7;
+  wc.bytes_out = 10;
+  std::ostringstream out;
+  print_stage_stats(out, {grep, wc}, 0.75);
+
+  std::istringstream lines(out.str());
+  std::string header, first, second, total, extra;
+  std::getline(lines, header);
+  std::getline(lines, first);
+  std::getline(lines, second);
+  std::getline(lines, total);
+  CHECK_FALSE(std::getline(lines, extra));
+  CHECK(header.find("real") != std::string::npos);
+  CHECK(header.find("command") != std::string::npos);
+  CHECK(first ==
+        "   0.500    0.250    0.000       1000      0      0         4096"
+        "            -          512            0  grep");
+  CHECK(second.substr(second.size() - 4) == "  wc");
+  // In and out of the whole pipeline: grep's input and wc's output.
+  CHECK(total ==
+        "   0.750    0.375    0.000       3000      7      0         4096"
+        "           10          512            0  total");
+}
+
+TEST_CASE("ExecutionPlan takes a leading time word") {
+  ExecutionPlan plan = ExecutionPlan::compile("time X=1 echo $X | wc");
+  CHECK(plan.timed());
+  REQUIRE(plan.stages().size() == 2);
+  REQUIRE(plan.assignments().size() == 1);
+  CHECK(plan.assignments()[0].name == "X");
+
+  CHECK_FALSE(ExecutionPlan::compile("time").timed());
+  CHECK_FALSE(ExecutionPlan::compile("'time' echo").timed());
+  CHECK_FALSE(ExecutionPlan::compile("echo time").timed());
+}
+
+#ifndef _WIN32
+TEST_CASE("ExecutorResult has the stats of built-in and external stages") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor executor(registry);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  env.set("CLI_FUSION", "0");
+  std::stringstream in, out, err;
+
+  ExecutorResult result = executor.execute(
+      ExecutionPlan::compile("sh -c '" + kBusyLoop + "; exit 3'"), in, out,
+      err, env);
+  CHECK(result.exit_code == 3);
+  REQUIRE(result.stages.size() == 1);
+  const StageStats &sh = result.stages[0];
+  CHECK(sh.name == "sh");
+  CHECK_FALSE(sh.builtin);
+  CHECK(sh.exit_code == 3);
+  CHECK(sh.user_seconds + sh.system_seconds > 0);
+  CHECK(sh.real_seconds >= sh.user_seconds);
+  CHECK(sh.max_rss_kib > 0);
+
+  result = executor.execute(
+      ExecutionPlan::compile("echo a b | sh -c 'cat; " + kBusyLoop +
+                             "' | wc"),
+      in, out, err, env);
+  REQUIRE(result.stages.size() == 3);
+  CHECK(result.stages[0].name == "echo");
+  CHECK(result.stages[0].builtin);
+  CHECK(result.stages[1].name == "sh");
+  CHECK(result.stages[1].user_seconds + result.stages[1].system_seconds > 0);
+  CHECK(result.stages[2].name == "wc");
+  CHECK(result.stages[2].builtin);
+  CHECK(result.stages[2].max_rss_kib > 0);
+
+  result = executor.execute(ExecutionPlan::compile("sh -c 'echo x' | cat"),
+                            in, out, err, env);
+  REQUIRE(result.stages.size() == 2);
+  CHECK(result.stages[0].name == "sh");
+  CHECK(result.stages[1].name == "cat");
+  CHECK_FALSE(result.stages[1].builtin);
+}
+
+TEST_CASE("StageStats counts the bytes across each stage's stdin and stdout") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor executor(registry);
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  env.set("CLI_FUSION", "0");
+
+  for (const char *mode : {"", "streaming"}) {
+    CAPTURE(mode);
+    env.set("CLI_PIPELINE", mode);
+    std::stringstream in, out, err;
+    ExecutorResult result = executor.execute(
+        ExecutionPlan::compile("echo hello | sh -c 'cat; echo more' | wc"), in,
+        out, err, env);
+    REQUIRE(result.stages.size() == 3);
+    CHECK(result.stages[0].bytes_in == 0u);
+    CHECK(result.stages[0].bytes_out == 6u);
+    CHECK(result.stages[1].bytes_in == 6u);
+    CHECK(result.stages[1].bytes_out == 11u);
+    CHECK(result.stages[2].bytes_in == 11u);
+    CHECK(result.stages[2].bytes_out == out.str().size());
+  }
+  env.set("CLI_PIPELINE", "");
+
+  // Between two programs the data goes through a kernel pipe the
+  // interpreter never sees.
+  std::stringstream in("abc\n"), out, err;
+  ExecutorResult result = executor.execute(
+      ExecutionPlan::compile("sh -c cat | sh -c 'cat; echo d'"), in, out, err,
+      env);
+  REQUIRE(result.stages.size() == 2);
+  CHECK(result.stages[0].bytes_in == 4u);
+  CHECK_FALSE(result.stages[0].bytes_out);
+  CHECK_FALSE(result.stages[1].bytes_in);
+  CHECK(result.stages[1].bytes_out == 6u);
+}
+
+TEST_CASE("Fused stages share one StageStats entry") {
+  CommandRegistry registry;
+  registry.register_command("echo", std::make_unique<EchoCommand>());
+  registry.register_command("cat", std::make_unique<CatCommand>());
+  registry.register_command("wc", std::make_unique<WcCommand>());
+  Executor executor(registry);
+  Environment env;
+  std::stringstream in, out, err;
+  ExecutorResult result = executor.execute(
+      ExecutionPlan::compile("cat CMakeLists.txt | wc"), in, out, err, env);
+  REQUIRE(result.stages.size() == 1);
+  CHECK(result.stages[0].name == "cat | wc");
+  CHECK(result.stages[0].builtin);
+  CHECK(result.stages[0].bytes_in == 0u);
+  CHECK(result.stages[0].bytes_out == out.str().size());
+}
+
+#ifdef __linux__
+TEST_CASE("Programs launched by the zygote report their usage") {
+  std::unique_ptr<Zygote> zygote = Zygote::start();
+  REQUIRE(zygote);
+  CommandRegistry registry;
+  Executor executor(registry);
+  executor.set_zygote(zygote.get());
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  std::stringstream in, out, err;
+  ExecutorResult result = executor.execute(
+      ExecutionPlan::compile("sh -c '" + kBusyLoop + "'"), in, out, err, env);
+  CHECK(out.str() == "20000\n");
+  REQUIRE(result.stages.size() == 1);
+  CHECK(result.stages[0].user_seconds + result.stages[0].system_seconds > 0);
+  CHECK(result.stages[0].max_rss_kib > 0);
+}
+#endif
+
+TEST_CASE("time prints a breakdown of the pipeline to stderr") {
+  CommandLineInterpreter cli;
+  std::stringstream in("time echo hi | sh -c 'cat'\n");
+  std::stringstream out, err;
+  cli.run(in, out, err);
+  CHECK(out.str() == "hi\n");
+  std::istringstream lines(err.str());
+  std::string header, echo, sh, total;
+  std::getline(lines, header);
+  std::getline(lines, echo);
+  std::getline(lines, sh);
+  std::getline(lines, total);
+  CHECK(header.find("maxrss") != std::string::npos);
+  CHECK(echo.substr(echo.size() - 6) == "  echo");
+  CHECK(sh.substr(sh.size() - 4) == "  sh");
+  CHECK(total.substr(total.size() - 7) == "  total");
+}
+#endif
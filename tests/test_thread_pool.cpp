@@ -0,0 +1,102 @@
+#include "cli/thread_pool.hpp"
+#include <doctest/doctest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace cli;
+
+TEST_CASE("ThreadPool runs every submitted task") {
+  ThreadPool pool(3);
+  std::atomic<int> sum{0};
+  std::vector<TaskHandle> handles;
+  for (int i = 1; i <= 100; ++i)
+    handles.push_back(pool.submit([&sum, i] { sum += i; }));
+  for (auto &h : handles)
+    h.wait();
+  CHECK(sum == 5050);
+}
+
+TEST_CASE("TaskHandle wait rethrows the task's exception") {
+  ThreadPool pool(1);
+  TaskHandle h = pool.submit([] { throw std::runtime_error("boom"); });
+  CHECK_THROWS_AS(h.wait(), std::runtime_error);
+  CHECK_FALSE(h.valid());
+}
+
+TEST_CASE("ThreadPool nested tasks finish on a single worker") {
+  ThreadPool pool(1);
+  std::atomic<int> leaves{0};
+  TaskHandle root = pool.submit([&] {
+    std::vector<TaskHandle> children;
+    for (int i = 0; i < 8; ++i)
+      children.push_back(pool.submit([&leaves] { ++leaves; }));
+    for (auto &c : children)
+      c.wait();
+  });
+  root.wait();
+  CHECK(leaves == 8);
+}
+
+TEST_CASE("ThreadPool idle workers steal queued tasks") {
+  ThreadPool pool(4);
+  std::mutex mutex;
+  std::set<std::thread::id> ids;
+  TaskHandle root = pool.submit([&] {
+    std::vector<TaskHandle> children;
+    for (int i = 0; i < 64; ++i) {
+      children.push_back(pool.submit([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(mutex);
+        ids.insert(std::this_thread::get_id());
+      }));
+    }
+    for (auto &c : children)
+      c.wait();
+  });
+  root.wait();
+  CHECK(ids.size() > 1);
+}
+
+TEST_CASE("ThreadPool spawn runs blocking tasks concurrently") {
+  ThreadPool pool(1);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int arrived = 0;
+  auto rendezvous = [&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    ++arrived;
+    cv.notify_all();
+    cv.wait(lock, [&] { return arrived == 3; });
+  };
+  TaskHandle a = pool.spawn(rendezvous);
+  TaskHandle b = pool.spawn(rendezvous);
+  rendezvous();
+  a.wait();
+  b.wait();
+  CHECK(arrived == 3);
+  CHECK(pool.overflow_threads() >= 1);
+}
+
+TEST_CASE("ThreadPool starts its workers with the first task") {
+  ThreadPool pool(2);
+  CHECK(pool.size() == 2);
+  // The workers just started are idle, so the task needs no extra thread.
+  std::atomic<bool> ran{false};
+  TaskHandle h = pool.spawn([&ran] { ran = true; });
+  h.wait();
+  CHECK(ran);
+  CHECK(pool.overflow_threads() == 0);
+}
+
+TEST_CASE("run_concurrently without a pool uses a thread") {
+  std::atomic<bool> ran{false};
+  TaskHandle h = run_concurrently(nullptr, [&ran] { ran = true; });
+  h.wait();
+  CHECK(ran);
+}
@@ -0,0 +1,104 @@
+#include "cli/environment.hpp"
+#include "cli/external_command.hpp"
+#include "cli/zygote.hpp"
+#include <doctest/doctest.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace cli;
+
+TEST_CASE("Zygote runs programs with the given stdio and reports exit code") {
+  std::unique_ptr<Zygote> zygote = Zygote::start();
+  REQUIRE(zygote);
+  ExternalCommand cmd;
+  cmd.set_zygote(zygote.get());
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  env.set("GREETING", "hi");
+
+  std::stringstream in("from stdin\n"), out, err;
+  CHECK(cmd.execute({"sh", "-c",
+                     "cat; echo $GREETING; echo oops >&2; "
+                     "[ \"$PPID\" != \"" +
+                         std::to_string(getpid()) + "\" ] && exit 3"},
+                    in, out, err, env) == 3);
+  CHECK(out.str() == "from stdin\nhi\n");
+  CHECK(err.str() == "oops\n");
+
+  std::stringstream in2, out2, err2;
+  CHECK(cmd.execute({"no_such_program_xyz"}, in2, out2, err2, env) == 127);
+  CHECK(err2.str().find("command not found") != std::string::npos);
+}
+
+TEST_CASE("Zygote launches every stage of an external pipeline") {
+  std::unique_ptr<Zygote> zygote = Zygote::start();
+  REQUIRE(zygote);
+  ExternalCommand cmd;
+  cmd.set_zygote(zygote.get());
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+
+  std::stringstream in("b\na\nc\n"), out, err;
+  CHECK(cmd.execute_pipeline({{"sort"}, {"head", "-n", "2"}}, in, out, err,
+                             env) == 0);
+  CHECK(out.str() == "a\nb\n");
+  CHECK(err.str().empty());
+}
+
+TEST_CASE("ExternalCommand forks itself once the zygote is gone") {
+  std::unique_ptr<Zygote> zygote = Zygote::start();
+  REQUIRE(zygote);
+  kill(zygote->pid(), SIGKILL);
+  waitpid(zygote->pid(), nullptr, 0);
+
+  ExternalCommand cmd;
+  cmd.set_zygote(zygote.get());
+  Environment env;
+  env.set("PATH", "/usr/bin:/bin");
+  std::stringstream in, out, err;
+  CHECK(cmd.execute({"echo", "still works"}, in, out, err, env) == 0);
+  CHECK(out.str() == "still works\n");
+}
+
+TEST_CASE("Children get only their own stdio with either launcher") {
+  for (const char *launcher : {"spawn", "fork"}) {
+    CAPTURE(launcher);
+    ExternalCommand cmd;
+    Environment env;
+    env.set("PATH", "/usr/bin:/bin");
+    env.set("CLI_LAUNCHER", launcher);
+    std::stringstream in, out, err;
+    CHECK(cmd.execute_pipeline(
+              {{"sh", "-c", "ls /proc/$$/fd"}, {"sort", "-n"}}, in, out, err,
+              env) == 0);
+    CHECK(err.str().empty());
+    std::string fd;
+    std::vector<int> fds;
+    while (out >> fd)
+      fds.push_back(std::stoi(fd));
+    REQUIRE(fds.size() >= 3);
+    CHECK(fds[0] == 0);
+    CHECK(fds[1] == 1);
+    CHECK(fds[2] == 2);
+    // Anything else must be a descriptor the test process itself lets
+    // children inherit, never one of the interpreter's pipes.
+    for (std::size_t i = 3; i < fds.size(); ++i) {
+      CAPTURE(fds[i]);
+      const int flags = fcntl(fds[i], F_GETFD);
+      CHECK(flags >= 0);
+      CHECK((flags & FD_CLOEXEC) == 0);
+    }
+
+    std::stringstream in2, out2, err2;
+    CHECK(cmd.execute({"no_such_program_xyz"}, in2, out2, err2, env) == 127);
+    CHECK(err2.str().find("command not found") != std::string::npos);
+  }
+}
+#endif